@@ -0,0 +1,238 @@
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Common.h"
+
+/*
+ * Tile cache:
+ * the plane is cut into a global pixel grid for every quantized scale (Level),
+ * pixel (gx, gy) of a level sits at (gx*Delta, -gy*Delta),
+ * and the grid is cut into TILE_SIZE x TILE_SIZE tiles.
+ * A view that is snapped onto that grid can be assembled from tiles rendered by earlier frames.
+ * Entries live in a hash table (chained through Next) and in a doubly linked list
+ * ordered from the most to the least recently used one, the tail gets evicted first.
+ */
+
+#define TILE_CACHE_NONE (-1)
+
+u32 HashTileKey(const tile_key *Key)
+{
+    /* FNV-1a over the fields, the struct can have padding so don't hash it as bytes */
+    u64 Fields[7] = {
+        (u64)Key->Level,
+        (u64)Key->TileX,
+        (u64)Key->TileY,
+        (u64)Key->IterationCount,
+        (u64)Key->Mode,
+        (u64)Key->Method,
+        (u64)Key->Formula,
+    };
+    u64 Hash = 14695981039346656037ull;
+    for (int i = 0; i < (int)STATIC_ARRAY_SIZE(Fields); i++)
+    {
+        Hash ^= Fields[i];
+        Hash *= 1099511628211ull;
+    }
+    return (u32)(Hash ^ (Hash >> 32));
+}
+
+Bool8 TileKeyEqual(const tile_key *A, const tile_key *B)
+{
+    return A->Level == B->Level
+        && A->TileX == B->TileX
+        && A->TileY == B->TileY
+        && A->IterationCount == B->IterationCount
+        && A->Mode == B->Mode
+        && A->Method == B->Method
+        && A->Formula == B->Formula;
+}
+
+Bool8 TileCacheInit(tile_cache *Cache, int Capacity)
+{
+    memset(Cache, 0, sizeof *Cache);
+    if (Capacity <= 0)
+        return false;
+
+    Cache->Capacity = Capacity;
+    Cache->BucketCount = 1;
+    while (Cache->BucketCount < 2*Capacity)
+        Cache->BucketCount *= 2;
+
+    Cache->Entries = calloc((size_t)Capacity, sizeof *Cache->Entries);
+    Cache->Buckets = malloc((size_t)Cache->BucketCount * sizeof *Cache->Buckets);
+    if (NULL == Cache->Entries || NULL == Cache->Buckets)
+    {
+        TileCacheDestroy(Cache);
+        return false;
+    }
+
+    for (int i = 0; i < Cache->BucketCount; i++)
+        Cache->Buckets[i] = TILE_CACHE_NONE;
+    Cache->MostRecent = TILE_CACHE_NONE;
+    Cache->LeastRecent = TILE_CACHE_NONE;
+    return true;
+}
+
+void TileCacheDestroy(tile_cache *Cache)
+{
+    free(Cache->Entries);
+    free(Cache->Buckets);
+    memset(Cache, 0, sizeof *Cache);
+}
+
+static void TileCacheUnlinkRecent(tile_cache *Cache, int Index)
+{
+    tile_cache_entry *Entry = &Cache->Entries[Index];
+    if (TILE_CACHE_NONE != Entry->MoreRecent)
+        Cache->Entries[Entry->MoreRecent].LessRecent = Entry->LessRecent;
+    else Cache->MostRecent = Entry->LessRecent;
+
+    if (TILE_CACHE_NONE != Entry->LessRecent)
+        Cache->Entries[Entry->LessRecent].MoreRecent = Entry->MoreRecent;
+    else Cache->LeastRecent = Entry->MoreRecent;
+}
+
+static void TileCacheMakeMostRecent(tile_cache *Cache, int Index)
+{
+    tile_cache_entry *Entry = &Cache->Entries[Index];
+    Entry->MoreRecent = TILE_CACHE_NONE;
+    Entry->LessRecent = Cache->MostRecent;
+    if (TILE_CACHE_NONE != Cache->MostRecent)
+        Cache->Entries[Cache->MostRecent].MoreRecent = Index;
+    Cache->MostRecent = Index;
+    if (TILE_CACHE_NONE == Cache->LeastRecent)
+        Cache->LeastRecent = Index;
+}
+
+static void TileCacheUnlinkBucket(tile_cache *Cache, int Index)
+{
+    tile_cache_entry *Entry = &Cache->Entries[Index];
+    int *Link = &Cache->Buckets[Entry->Hash & (Cache->BucketCount - 1)];
+    while (*Link != Index)
+        Link = &Cache->Entries[*Link].Next;
+    *Link = Entry->Next;
+}
+
+tile_cache_entry *TileCacheLookup(tile_cache *Cache, const tile_key *Key)
+{
+    u32 Hash = HashTileKey(Key);
+    int Index = Cache->Buckets[Hash & (Cache->BucketCount - 1)];
+    while (TILE_CACHE_NONE != Index)
+    {
+        tile_cache_entry *Entry = &Cache->Entries[Index];
+        if (Entry->Hash == Hash && TileKeyEqual(&Entry->Key, Key))
+        {
+            TileCacheUnlinkRecent(Cache, Index);
+            TileCacheMakeMostRecent(Cache, Index);
+            Cache->Hits++;
+            return Entry;
+        }
+        Index = Entry->Next;
+    }
+    Cache->Misses++;
+    return NULL;
+}
+
+tile_cache_entry *TileCacheInsert(tile_cache *Cache, const tile_key *Key)
+{
+    int Index;
+    if (Cache->Count < Cache->Capacity)
+    {
+        Index = Cache->Count++;
+    }
+    else
+    {
+        /* full, reuse the least recently used entry */
+        Index = Cache->LeastRecent;
+        TileCacheUnlinkRecent(Cache, Index);
+        TileCacheUnlinkBucket(Cache, Index);
+    }
+
+    tile_cache_entry *Entry = &Cache->Entries[Index];
+    Entry->Key = *Key;
+    Entry->Hash = HashTileKey(Key);
+
+    int *Bucket = &Cache->Buckets[Entry->Hash & (Cache->BucketCount - 1)];
+    Entry->Next = *Bucket;
+    *Bucket = Index;
+    TileCacheMakeMostRecent(Cache, Index);
+    return Entry;
+}
+
+void SnapViewToTileGrid(coordmap *Map, int Width, int Height, tile_grid *Grid)
+{
+    /* TILE_CACHE_LEVELS_PER_OCTAVE scales for every factor of 2,
+     * keep the center where it was */
+    double CenterX = -Map->Left + 0.5*Width*Map->Delta;
+    double CenterY = Map->Top - 0.5*Height*Map->Delta;
+    Grid->Level = (int)floor(log2(Map->Delta) * TILE_CACHE_LEVELS_PER_OCTAVE + 0.5);
+    Grid->Delta = exp2((double)Grid->Level / TILE_CACHE_LEVELS_PER_OCTAVE);
+
+    Grid->OriginX = (i64)floor(CenterX / Grid->Delta - 0.5*Width + 0.5);
+    Grid->OriginY = (i64)floor(-CenterY / Grid->Delta - 0.5*Height + 0.5);
+    Grid->Width = Width;
+    Grid->Height = Height;
+
+    Map->Delta = Grid->Delta;
+    Map->Left = -(double)Grid->OriginX * Grid->Delta;
+    Map->Top = -(double)Grid->OriginY * Grid->Delta;
+    Map->Width = Width * Grid->Delta;
+    Map->Height = Height * Grid->Delta;
+}
+
+static i64 FloorDiv(i64 a, i64 b)
+{
+    i64 q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0))? q - 1 : q;
+}
+
+int GetTileGridTiles(const tile_grid *Grid, i64 *FirstTileX, i64 *FirstTileY, int *TileCountX, int *TileCountY)
+{
+    *FirstTileX = FloorDiv(Grid->OriginX, TILE_SIZE);
+    *FirstTileY = FloorDiv(Grid->OriginY, TILE_SIZE);
+    i64 LastTileX = FloorDiv(Grid->OriginX + Grid->Width - 1, TILE_SIZE);
+    i64 LastTileY = FloorDiv(Grid->OriginY + Grid->Height - 1, TILE_SIZE);
+    *TileCountX = (int)(LastTileX - *FirstTileX + 1);
+    *TileCountY = (int)(LastTileY - *FirstTileY + 1);
+    return *TileCountX * *TileCountY;
+}
+
+coordmap GetTileGridMap(const tile_grid *Grid, i64 TileX, i64 TileY)
+{
+    coordmap Map = {
+        .Left = -(double)(TileX * TILE_SIZE) * Grid->Delta,
+        .Top = -(double)(TileY * TILE_SIZE) * Grid->Delta,
+        .Width = TILE_SIZE * Grid->Delta,
+        .Height = TILE_SIZE * Grid->Delta,
+        .Delta = Grid->Delta,
+    };
+    return Map;
+}
+
+void CopyTileToBuffer(
+    color_buffer *Buffer,
+    const tile_grid *Grid,
+    i64 TileX, i64 TileY,
+    const u32 *Pixels
+)
+{
+    /* where the tile lands in the buffer, then clip it */
+    i64 x0 = TileX * TILE_SIZE - Grid->OriginX;
+    i64 y0 = TileY * TILE_SIZE - Grid->OriginY;
+    int SrcX = (int)MAX(0, -x0);
+    int SrcY = (int)MAX(0, -y0);
+    int DstX = (int)MAX(0, x0);
+    int DstY = (int)MAX(0, y0);
+    int w = MIN(TILE_SIZE - SrcX, Buffer->Width - DstX);
+    int h = MIN(TILE_SIZE - SrcY, Buffer->Height - DstY);
+    for (int y = 0; y < h; y++)
+    {
+        memcpy(
+            Buffer->Ptr + (DstY + y)*Buffer->Stride + DstX,
+            Pixels + (SrcY + y)*TILE_SIZE + SrcX,
+            w * sizeof *Pixels
+        );
+    }
+}
+
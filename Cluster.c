@@ -0,0 +1,840 @@
+#include <stdlib.h>
+#include <string.h>
+#include "Common.h"
+
+#ifndef _WIN32
+#  include <netdb.h>
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <pthread.h>
+#  include <sys/socket.h>
+#  include <sys/time.h>
+#  include <sys/un.h>
+#  include <time.h>
+#  include <unistd.h>
+#endif /* _WIN32 */
+
+/*
+ * Distributed rendering:
+ * a worker is simdbrot --worker ADDRESS, it listens on a tcp port or a unix socket and renders
+ * whatever tiles it's sent, on every thread it has, and sends their pixels back.
+ * The coordinator renders the image a band at a time like EngineRenderBands, but every band is split into tiles
+ * that go to the workers, each worker has a couple of connections so that it renders a tile while
+ * the one before it is being sent. A connection is only given a tile once it's connected,
+ * a tile whose worker fails or goes quiet goes back to the others,
+ * the worker gets reconnected to after a pause, and is given up on after too many failures in a row.
+ * The requests carry everything a tile needs, so a worker keeps nothing between them and any one of them will do.
+ * Every number on the wire is little endian.
+ * Only posix sockets for now.
+ */
+
+#define CLUSTER_TILE_WIDTH 1024
+#define CLUSTER_TILE_HEIGHT 256
+
+/* the workers are on another box, there's no reason for anything bigger */
+#define CLUSTER_MAX_TILE_SIZE 4096
+
+#define CLUSTER_CONNECTIONS_PER_WORKER 2
+
+/* a connection that failed this many times in a row is given up on, 
+ * a tile that failed on this many different workers fails the render, a worker that went away only counts once */
+#define CLUSTER_MAX_FAILURES 5
+#define CLUSTER_MAX_TILE_FAILURES 4
+
+/* between reconnects, doubled after every failure */
+#define CLUSTER_RETRY_DELAY 100 /* milliseconds */
+#define CLUSTER_MAX_RETRY_DELAY 5000
+
+/* a deep tile can take a while, a worker that is quiet for longer than that is taken as lost */
+#define CLUSTER_TIMEOUT 120 /* seconds */
+
+#define CLUSTER_REQUEST_SIZE 152
+#define CLUSTER_RESPONSE_SIZE 16
+
+typedef enum cluster_status
+{
+    CLUSTER_STATUS_OK = 0,
+    CLUSTER_STATUS_BAD_REQUEST,
+    CLUSTER_STATUS_UNSUPPORTED_MODE,
+    CLUSTER_STATUS_OUT_OF_MEMORY,
+} cluster_status;
+
+/* what a worker renders, a rectangle of the image, of which it only sends the inner part back,
+ * the rest is context for supersampling. 
+ * Left, Top and Delta are the whole image's map and OffsetX, OffsetY the rectangle's first pixel in the image, 
+ * so the worker puts every pixel at the point it has here */
+typedef struct cluster_request
+{
+    int Width, Height;
+    int InnerX, InnerY;
+    int InnerWidth, InnerHeight;
+    pixel_format Format;
+    int Mode;
+    render_method Method;
+    int IterationCount;
+    Bool8 Supersample;
+    int OffsetX, OffsetY;
+    double Left, Top, Delta;
+    double MaxValue;
+    u32 Palette[16];
+} cluster_request;
+
+#ifndef _WIN32
+
+static void Cluster_Put32(u8 **Ptr, u32 Value)
+{
+    for (int i = 0; i < 4; i++)
+        *(*Ptr)++ = (u8)(Value >> 8*i);
+}
+
+static void Cluster_Put64(u8 **Ptr, u64 Value)
+{
+    for (int i = 0; i < 8; i++)
+        *(*Ptr)++ = (u8)(Value >> 8*i);
+}
+
+static void Cluster_PutDouble(u8 **Ptr, double Value)
+{
+    u64 Bits;
+    memcpy(&Bits, &Value, sizeof Bits);
+    Cluster_Put64(Ptr, Bits);
+}
+
+static u32 Cluster_Get32(const u8 **Ptr)
+{
+    u32 Value = 0;
+    for (int i = 0; i < 4; i++)
+        Value |= (u32)*(*Ptr)++ << 8*i;
+    return Value;
+}
+
+static u64 Cluster_Get64(const u8 **Ptr)
+{
+    u64 Value = 0;
+    for (int i = 0; i < 8; i++)
+        Value |= (u64)*(*Ptr)++ << 8*i;
+    return Value;
+}
+
+static double Cluster_GetDouble(const u8 **Ptr)
+{
+    u64 Bits = Cluster_Get64(Ptr);
+    double Value;
+    memcpy(&Value, &Bits, sizeof Value);
+    return Value;
+}
+
+static void Cluster_PackRequest(const cluster_request *Request, u8 Data[CLUSTER_REQUEST_SIZE])
+{
+    u8 *Ptr = Data;
+    memcpy(Ptr, "SBT2", 4);
+    Ptr += 4;
+    Cluster_Put32(&Ptr, Request->Width);
+    Cluster_Put32(&Ptr, Request->Height);
+    Cluster_Put32(&Ptr, Request->InnerX);
+    Cluster_Put32(&Ptr, Request->InnerY);
+    Cluster_Put32(&Ptr, Request->InnerWidth);
+    Cluster_Put32(&Ptr, Request->InnerHeight);
+    Cluster_Put32(&Ptr, Request->Format);
+    Cluster_Put32(&Ptr, Request->Mode);
+    Cluster_Put32(&Ptr, Request->Method);
+    Cluster_Put32(&Ptr, Request->IterationCount);
+    Cluster_Put32(&Ptr, Request->Supersample);
+    Cluster_Put32(&Ptr, Request->OffsetX);
+    Cluster_Put32(&Ptr, Request->OffsetY);
+    Cluster_PutDouble(&Ptr, Request->Left);
+    Cluster_PutDouble(&Ptr, Request->Top);
+    Cluster_PutDouble(&Ptr, Request->Delta);
+    Cluster_PutDouble(&Ptr, Request->MaxValue);
+    for (int i = 0; i < 16; i++)
+        Cluster_Put32(&Ptr, Request->Palette[i]);
+}
+
+static Bool8 Cluster_UnpackRequest(const u8 Data[CLUSTER_REQUEST_SIZE], cluster_request *Request)
+{
+    const u8 *Ptr = Data + 4;
+    if (0 != memcmp(Data, "SBT2", 4))
+        return false;
+    Request->Width = (int)Cluster_Get32(&Ptr);
+    Request->Height = (int)Cluster_Get32(&Ptr);
+    Request->InnerX = (int)Cluster_Get32(&Ptr);
+    Request->InnerY = (int)Cluster_Get32(&Ptr);
+    Request->InnerWidth = (int)Cluster_Get32(&Ptr);
+    Request->InnerHeight = (int)Cluster_Get32(&Ptr);
+    Request->Format = (pixel_format)Cluster_Get32(&Ptr);
+    Request->Mode = (int)Cluster_Get32(&Ptr);
+    Request->Method = (render_method)Cluster_Get32(&Ptr);
+    Request->IterationCount = (int)Cluster_Get32(&Ptr);
+    Request->Supersample = 0 != Cluster_Get32(&Ptr);
+    Request->OffsetX = (int)Cluster_Get32(&Ptr);
+    Request->OffsetY = (int)Cluster_Get32(&Ptr);
+    Request->Left = Cluster_GetDouble(&Ptr);
+    Request->Top = Cluster_GetDouble(&Ptr);
+    Request->Delta = Cluster_GetDouble(&Ptr);
+    Request->MaxValue = Cluster_GetDouble(&Ptr);
+    for (int i = 0; i < 16; i++)
+        Request->Palette[i] = Cluster_Get32(&Ptr);
+
+    /* unsigned, so anything negative is out of range too */
+    return (unsigned)Request->Width - 1 < CLUSTER_MAX_TILE_SIZE
+        && (unsigned)Request->Height - 1 < CLUSTER_MAX_TILE_SIZE
+        && (unsigned)Request->InnerWidth - 1 < CLUSTER_MAX_TILE_SIZE
+        && (unsigned)Request->InnerHeight - 1 < CLUSTER_MAX_TILE_SIZE
+        && (unsigned)Request->InnerX <= (unsigned)(Request->Width - Request->InnerWidth)
+        && (unsigned)Request->InnerY <= (unsigned)(Request->Height - Request->InnerHeight)
+        && (unsigned)Request->Format < PIXEL_FORMAT_COUNT
+        && (unsigned)Request->Method < RENDER_METHOD_COUNT
+        && Request->IterationCount >= 1 && Request->IterationCount <= ITERATION_COUNT_MAX
+        && Request->Delta > 0 && Request->MaxValue > 0;
+}
+
+static void Cluster_PackResponse(cluster_status Status, u64 Size, u8 Data[CLUSTER_RESPONSE_SIZE])
+{
+    u8 *Ptr = Data;
+    memcpy(Ptr, "SBR1", 4);
+    Ptr += 4;
+    Cluster_Put32(&Ptr, Status);
+    Cluster_Put64(&Ptr, Size);
+}
+
+static Bool8 Cluster_Send(int Socket, const void *Data, size_t Size)
+{
+    const char *Ptr = Data;
+    while (Size > 0)
+    {
+        ssize_t Sent = send(Socket, Ptr, Size, MSG_NOSIGNAL);
+        if (Sent <= 0)
+            return false;
+        Ptr += Sent;
+        Size -= (size_t)Sent;
+    }
+    return true;
+}
+
+static Bool8 Cluster_Receive(int Socket, void *Data, size_t Size)
+{
+    char *Ptr = Data;
+    while (Size > 0)
+    {
+        ssize_t Received = recv(Socket, Ptr, Size, 0);
+        if (Received <= 0)
+            return false;
+        Ptr += Received;
+        Size -= (size_t)Received;
+    }
+    return true;
+}
+
+/* unix:PATH, or HOST:PORT where HOST can be left out, it's every address to listen on and localhost to connect to,
+ * -1 when the address is no good or the socket can't be made */
+static int Cluster_OpenSocket(const char *Address, Bool8 Listen)
+{
+    int Socket = -1;
+    if (0 == strncmp(Address, "unix:", 5))
+    {
+        struct sockaddr_un UnixAddress = { .sun_family = AF_UNIX };
+        if (strlen(Address + 5) >= sizeof UnixAddress.sun_path)
+            return -1;
+        strcpy(UnixAddress.sun_path, Address + 5);
+        Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (Socket < 0)
+            return -1;
+        if (Listen)
+            unlink(UnixAddress.sun_path);
+        if (0 != (Listen
+            ? bind(Socket, (struct sockaddr *)&UnixAddress, sizeof UnixAddress)
+            : connect(Socket, (struct sockaddr *)&UnixAddress, sizeof UnixAddress)))
+        {
+            close(Socket);
+            return -1;
+        }
+    }
+    else
+    {
+        const char *Colon = strrchr(Address, ':');
+        char Host[256];
+        if (NULL == Colon || (size_t)(Colon - Address) >= sizeof Host)
+            return -1;
+        memcpy(Host, Address, Colon - Address);
+        Host[Colon - Address] = '\0';
+
+        struct addrinfo Hints = {
+            .ai_family = AF_UNSPEC,
+            .ai_socktype = SOCK_STREAM,
+            .ai_flags = Listen? AI_PASSIVE : 0,
+        };
+        struct addrinfo *Addresses;
+        if (0 != getaddrinfo(Host[0]? Host : NULL, Colon + 1, &Hints, &Addresses))
+            return -1;
+        for (struct addrinfo *Info = Addresses; Info && Socket < 0; Info = Info->ai_next)
+        {
+            Socket = socket(Info->ai_family, Info->ai_socktype, Info->ai_protocol);
+            if (Socket < 0)
+                continue;
+            int Yes = 1;
+            if (Listen)
+                setsockopt(Socket, SOL_SOCKET, SO_REUSEADDR, &Yes, sizeof Yes);
+            else setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, &Yes, sizeof Yes);
+            if (0 != (Listen
+                ? bind(Socket, Info->ai_addr, Info->ai_addrlen)
+                : connect(Socket, Info->ai_addr, Info->ai_addrlen)))
+            {
+                close(Socket);
+                Socket = -1;
+            }
+        }
+        freeaddrinfo(Addresses);
+    }
+
+    if (Socket >= 0 && Listen && 0 != listen(Socket, SOMAXCONN))
+    {
+        close(Socket);
+        return -1;
+    }
+    return Socket;
+}
+
+static Bool8 Cluster_StartThread(pthread_t *Thread, void *(*Fn)(void *), void *UserData)
+{
+    return 0 == pthread_create(Thread, NULL, Fn, UserData);
+}
+
+static void Cluster_Sleep(int Milliseconds)
+{
+    struct timespec Time = {
+        .tv_sec = Milliseconds / 1000,
+        .tv_nsec = (long)(Milliseconds % 1000) * 1000000,
+    };
+    nanosleep(&Time, NULL);
+}
+
+
+
+/* worker side */
+
+typedef struct cluster_worker_tile
+{
+    int Socket;
+    const cluster_request *Request;
+    Bool8 Sent;
+} cluster_worker_tile;
+
+static Bool8 Cluster_SendTile(void *UserData, const pixel_buffer *Band, int FirstRow)
+{
+    (void)FirstRow;
+    cluster_worker_tile *Tile = UserData;
+    const cluster_request *Request = Tile->Request;
+    size_t PixelSize = GetPixelFormatSize(Request->Format);
+    size_t RowSize = Request->InnerWidth * PixelSize;
+
+    u8 Response[CLUSTER_RESPONSE_SIZE];
+    Cluster_PackResponse(CLUSTER_STATUS_OK, (u64)RowSize * Request->InnerHeight, Response);
+    Tile->Sent = true;
+    if (!Cluster_Send(Tile->Socket, Response, sizeof Response))
+        return false;
+    const u8 *Row = (const u8 *)Band->Ptr + Request->InnerY * Band->Stride + Request->InnerX * PixelSize;
+    for (int y = 0; y < Request->InnerHeight; y++, Row += Band->Stride)
+    {
+        if (!Cluster_Send(Tile->Socket, Row, RowSize))
+            return false;
+    }
+    return true;
+}
+
+typedef struct cluster_worker_connection
+{
+    const render_engine *Engine;
+    int Socket;
+} cluster_worker_connection;
+
+static void *Cluster_WorkerThread(void *UserData)
+{
+    cluster_worker_connection *Connection = UserData;
+    const render_engine *Engine = Connection->Engine;
+    int Socket = Connection->Socket;
+    free(Connection);
+
+    u8 Data[CLUSTER_REQUEST_SIZE];
+    while (Cluster_Receive(Socket, Data, sizeof Data))
+    {
+        cluster_request Request;
+        cluster_status Status = !Cluster_UnpackRequest(Data, &Request)? CLUSTER_STATUS_BAD_REQUEST
+            : !CanRunMode(Request.Mode)? CLUSTER_STATUS_UNSUPPORTED_MODE
+            : CLUSTER_STATUS_OK;
+        if (CLUSTER_STATUS_OK == Status)
+        {
+            render_engine TileEngine = *Engine;
+            TileEngine.Mode = Request.Mode;
+            TileEngine.Method = Request.Method;
+            TileEngine.IterationCount = Request.IterationCount;
+            TileEngine.MaxValue = Request.MaxValue;
+            memcpy(TileEngine.Palette, Request.Palette, sizeof TileEngine.Palette);
+            coordmap Map = {
+                .Left = Request.Left,
+                .Top = Request.Top,
+                .Width = Request.Width * Request.Delta,
+                .Height = Request.Height * Request.Delta,
+                .Delta = Request.Delta,
+                .OffsetX = Request.OffsetX,
+                .OffsetY = Request.OffsetY,
+            };
+
+            /* one band of all of it, sent from the band function */
+            cluster_worker_tile Tile = {
+                .Socket = Socket,
+                .Request = &Request,
+            };
+            Bool8 Rendered = EngineRenderBands(
+                &TileEngine, &Map,
+                Request.Width, Request.Height,
+                0, Request.Height,
+                Request.Format,
+                Request.Supersample,
+                Cluster_SendTile, &Tile
+            );
+            if (Tile.Sent && !Rendered)
+                break;
+            if (Tile.Sent)
+                continue;
+            Status = CLUSTER_STATUS_OUT_OF_MEMORY;
+        }
+
+        u8 Response[CLUSTER_RESPONSE_SIZE];
+        Cluster_PackResponse(Status, 0, Response);
+        if (!Cluster_Send(Socket, Response, sizeof Response) || CLUSTER_STATUS_BAD_REQUEST == Status)
+            break;
+    }
+    close(Socket);
+    return NULL;
+}
+
+Bool8 ClusterServeWorker(const render_engine *Engine, const char *Address)
+{
+    render_engine *WorkerEngine = malloc(sizeof *WorkerEngine);
+    if (NULL == WorkerEngine)
+        return false;
+    *WorkerEngine = *Engine;
+
+    /* the tiles of every connection share the threads */
+    WorkerEngine->Pool = EngineCreatePool(Engine->ThreadCount);
+    int Listener = Cluster_OpenSocket(Address, true);
+    if (NULL == WorkerEngine->Pool || Listener < 0)
+        return false;
+
+    fprintf(stderr, "worker listening on %s, %d thread%s\n", Address, Engine->ThreadCount, Engine->ThreadCount != 1? "s" : "");
+    for (;;)
+    {
+        int Socket = accept(Listener, NULL, NULL);
+        if (Socket < 0)
+            continue;
+        int Yes = 1;
+        setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, &Yes, sizeof Yes);
+
+        cluster_worker_connection *Connection = malloc(sizeof *Connection);
+        pthread_t Thread;
+        if (Connection)
+        {
+            Connection->Engine = WorkerEngine;
+            Connection->Socket = Socket;
+            if (Cluster_StartThread(&Thread, Cluster_WorkerThread, Connection))
+            {
+                pthread_detach(Thread);
+                continue;
+            }
+            free(Connection);
+        }
+        close(Socket);
+    }
+}
+
+
+
+/* coordinator side */
+
+typedef enum cluster_tile_state
+{
+    CLUSTER_TILE_PENDING,
+    CLUSTER_TILE_RENDERING,
+    CLUSTER_TILE_DONE,
+} cluster_tile_state;
+
+typedef struct cluster_tile
+{
+    int x, y;
+    int Width, Height;
+    cluster_tile_state State;
+
+    /* the workers it failed on, by their index in the list */
+    int FailedWorkers[CLUSTER_MAX_TILE_FAILURES];
+    int FailedWorkerCount;
+} cluster_tile;
+
+typedef struct cluster
+{
+    const render_engine *Engine;
+    pixel_format Format;
+    Bool8 Supersample;
+    int ImageHeight;
+
+    pthread_mutex_t Lock;
+    pthread_cond_t Changed;
+
+    /* the band that's being rendered, from BandRow of the image, Map is the whole image's */
+    pixel_buffer Band;
+    int BandRow;
+    coordmap Map;
+    cluster_tile *Tiles;
+    int TileCount;
+    int PendingCount;
+    int DoneCount;
+
+    int LiveLinkCount;
+    Bool8 Failed;
+    Bool8 Quit;
+} cluster;
+
+/* a connection to a worker */
+typedef struct cluster_link
+{
+    cluster *Cluster;
+    const char *Address;
+    int Worker;
+    int Socket;
+    int Failures;
+    pthread_t Thread;
+    Bool8 Started;
+} cluster_link;
+
+static Bool8 Cluster_Connect(cluster_link *Link)
+{
+    Link->Socket = Cluster_OpenSocket(Link->Address, false);
+    if (Link->Socket < 0)
+        return false;
+    struct timeval Timeout = { .tv_sec = CLUSTER_TIMEOUT };
+    setsockopt(Link->Socket, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof Timeout);
+    setsockopt(Link->Socket, SOL_SOCKET, SO_SNDTIMEO, &Timeout, sizeof Timeout);
+    return true;
+}
+
+static Bool8 Cluster_RenderRemote(cluster_link *Link, const cluster_tile *Tile)
+{
+    cluster *Cluster = Link->Cluster;
+
+    /* a row of context on every side that's in the image, so supersampling marks the same edges it would here, 
+     * the points and the jitter come from the image map and the pixels' place in the image, like they do here */
+    int Context = Cluster->Supersample? 1 : 0;
+    int ImageY = Cluster->BandRow + Tile->y;
+    int Left = MIN(Context, Tile->x);
+    int Top = MIN(Context, ImageY);
+    int Right = MIN(Context, Cluster->Band.Width - Tile->x - Tile->Width);
+    int Bottom = MIN(Context, Cluster->ImageHeight - ImageY - Tile->Height);
+    const render_engine *Engine = Cluster->Engine;
+    cluster_request Request = {
+        .Width = Left + Tile->Width + Right,
+        .Height = Top + Tile->Height + Bottom,
+        .InnerX = Left,
+        .InnerY = Top,
+        .InnerWidth = Tile->Width,
+        .InnerHeight = Tile->Height,
+        .Format = Cluster->Format,
+        .Mode = Engine->Mode,
+        .Method = Engine->Method,
+        .IterationCount = Engine->IterationCount,
+        .Supersample = Cluster->Supersample,
+        .OffsetX = Cluster->Map.OffsetX + Tile->x - Left,
+        .OffsetY = Cluster->Map.OffsetY + ImageY - Top,
+        .Left = Cluster->Map.Left,
+        .Top = Cluster->Map.Top,
+        .Delta = Cluster->Map.Delta,
+        .MaxValue = Engine->MaxValue,
+    };
+    memcpy(Request.Palette, Engine->Palette, sizeof Request.Palette);
+
+    u8 Data[CLUSTER_REQUEST_SIZE];
+    Cluster_PackRequest(&Request, Data);
+    u8 Response[CLUSTER_RESPONSE_SIZE];
+    if (!Cluster_Send(Link->Socket, Data, sizeof Data) || !Cluster_Receive(Link->Socket, Response, sizeof Response))
+        return false;
+
+    const u8 *Ptr = Response + 4;
+    u32 Status = Cluster_Get32(&Ptr);
+    u64 Size = Cluster_Get64(&Ptr);
+    size_t PixelSize = GetPixelFormatSize(Cluster->Format);
+    size_t RowSize = Tile->Width * PixelSize;
+    if (0 != memcmp(Response, "SBR1", 4) || CLUSTER_STATUS_OK != Status || Size != (u64)RowSize * Tile->Height)
+    {
+        if (CLUSTER_STATUS_UNSUPPORTED_MODE == Status)
+            fprintf(stderr, "worker %s can't run %s\n", Link->Address, GetModeName(Engine->Mode));
+        return false;
+    }
+
+    /* no other link has the tile, and the band stays until every tile is done */
+    u8 *Row = (u8 *)Cluster->Band.Ptr + Tile->y * Cluster->Band.Stride + Tile->x * PixelSize;
+    for (int y = 0; y < Tile->Height; y++, Row += Cluster->Band.Stride)
+    {
+        if (!Cluster_Receive(Link->Socket, Row, RowSize))
+            return false;
+    }
+    return true;
+}
+
+static Bool8 Cluster_HasFailedOn(const cluster_tile *Tile, int Worker)
+{
+    for (int i = 0; i < Tile->FailedWorkerCount; i++)
+    {
+        if (Worker == Tile->FailedWorkers[i])
+            return true;
+    }
+    return false;
+}
+
+/* the first pending tile that hasn't failed on the link's worker yet, or the first pending one when they all have */
+static cluster_tile *Cluster_TakeTile(cluster *Cluster, const cluster_link *Link)
+{
+    cluster_tile *Tile = NULL;
+    for (int i = 0; i < Cluster->TileCount; i++)
+    {
+        if (CLUSTER_TILE_PENDING != Cluster->Tiles[i].State)
+            continue;
+        if (NULL == Tile)
+            Tile = &Cluster->Tiles[i];
+        if (!Cluster_HasFailedOn(&Cluster->Tiles[i], Link->Worker))
+        {
+            Tile = &Cluster->Tiles[i];
+            break;
+        }
+    }
+    Tile->State = CLUSTER_TILE_RENDERING;
+    Cluster->PendingCount--;
+    return Tile;
+}
+
+/* false when the link is given up on, called with the lock held */
+static Bool8 Cluster_LinkFailed(cluster_link *Link)
+{
+    cluster *Cluster = Link->Cluster;
+    if (++Link->Failures < CLUSTER_MAX_FAILURES)
+        return true;
+
+    fprintf(stderr, "gave up on worker %s\n", Link->Address);
+    if (0 == --Cluster->LiveLinkCount && !Cluster->Failed)
+    {
+        fprintf(stderr, "no workers left to render on\n");
+        Cluster->Failed = true;
+    }
+    pthread_cond_broadcast(&Cluster->Changed);
+    return false;
+}
+
+static void *Cluster_LinkThread(void *UserData)
+{
+    cluster_link *Link = UserData;
+    cluster *Cluster = Link->Cluster;
+    pthread_mutex_lock(&Cluster->Lock);
+    for (;;)
+    {
+        while (!Cluster->Quit && 0 == Cluster->PendingCount)
+            pthread_cond_wait(&Cluster->Changed, &Cluster->Lock);
+        if (Cluster->Quit)
+            break;
+
+        /* a worker that can't be reached never holds a tile up, or gets it blamed on it */
+        if (Link->Socket < 0)
+        {
+            pthread_mutex_unlock(&Cluster->Lock);
+            Bool8 Connected = Cluster_Connect(Link);
+            pthread_mutex_lock(&Cluster->Lock);
+            if (!Connected)
+            {
+                if (!Cluster_LinkFailed(Link))
+                    break;
+                pthread_mutex_unlock(&Cluster->Lock);
+                Cluster_Sleep(MIN(CLUSTER_RETRY_DELAY << (Link->Failures - 1), CLUSTER_MAX_RETRY_DELAY));
+                pthread_mutex_lock(&Cluster->Lock);
+            }
+            continue;
+        }
+
+        cluster_tile *Tile = Cluster_TakeTile(Cluster, Link);
+        pthread_mutex_unlock(&Cluster->Lock);
+
+        Bool8 Rendered = Cluster_RenderRemote(Link, Tile);
+        if (!Rendered)
+        {
+            close(Link->Socket);
+            Link->Socket = -1;
+        }
+
+        pthread_mutex_lock(&Cluster->Lock);
+        if (Rendered)
+        {
+            Tile->State = CLUSTER_TILE_DONE;
+            Cluster->DoneCount++;
+            Link->Failures = 0;
+        }
+        else
+        {
+            /* back to the others */
+            Tile->State = CLUSTER_TILE_PENDING;
+            Cluster->PendingCount++;
+            if (!Cluster_HasFailedOn(Tile, Link->Worker) && Tile->FailedWorkerCount < CLUSTER_MAX_TILE_FAILURES)
+            {
+                Tile->FailedWorkers[Tile->FailedWorkerCount++] = Link->Worker;
+                if (CLUSTER_MAX_TILE_FAILURES == Tile->FailedWorkerCount && !Cluster->Failed)
+                {
+                    fprintf(stderr, "a tile failed on %d workers, giving up on the render\n", Tile->FailedWorkerCount);
+                    Cluster->Failed = true;
+                }
+            }
+            if (!Cluster_LinkFailed(Link))
+                break;
+        }
+        pthread_cond_broadcast(&Cluster->Changed);
+
+        if (!Rendered)
+        {
+            pthread_mutex_unlock(&Cluster->Lock);
+            Cluster_Sleep(MIN(CLUSTER_RETRY_DELAY << (Link->Failures - 1), CLUSTER_MAX_RETRY_DELAY));
+            pthread_mutex_lock(&Cluster->Lock);
+        }
+    }
+    pthread_mutex_unlock(&Cluster->Lock);
+    return NULL;
+}
+
+Bool8 ClusterRenderBands(
+    const render_engine *Engine,
+    const coordmap *Map,
+    int Width, int Height,
+    int StartRow,
+    int BandHeight,
+    pixel_format Format,
+    Bool8 Supersample,
+    band_fn Fn,
+    void *UserData,
+    const char *const *Workers,
+    int WorkerCount
+)
+{
+    BandHeight = MAX(1, MIN(BandHeight, Height));
+    int TileCountX = (Width + CLUSTER_TILE_WIDTH - 1) / CLUSTER_TILE_WIDTH;
+    int MaxTileCount = TileCountX * ((BandHeight + CLUSTER_TILE_HEIGHT - 1) / CLUSTER_TILE_HEIGHT);
+    size_t PixelSize = GetPixelFormatSize(Format);
+    int LinkCount = WorkerCount * CLUSTER_CONNECTIONS_PER_WORKER;
+
+    cluster Cluster = {
+        .Engine = Engine,
+        .Format = Format,
+        .Supersample = Supersample,
+        .ImageHeight = Height,
+        .Band = {
+            .Format = Format,
+            .Ptr = malloc((size_t)Width * BandHeight * PixelSize),
+            .Width = Width,
+            .Stride = Width * PixelSize,
+        },
+        .Tiles = malloc(MaxTileCount * sizeof *Cluster.Tiles),
+    };
+    cluster_link *Links = calloc(LinkCount, sizeof *Links);
+    Bool8 Ok = NULL != Cluster.Band.Ptr && NULL != Cluster.Tiles && NULL != Links;
+    pthread_mutex_init(&Cluster.Lock, NULL);
+    pthread_cond_init(&Cluster.Changed, NULL);
+
+    for (int i = 0; Ok && i < LinkCount; i++)
+    {
+        Links[i].Cluster = &Cluster;
+        Links[i].Address = Workers[i % WorkerCount];
+        Links[i].Worker = i % WorkerCount;
+        Links[i].Socket = -1;
+        Links[i].Started = Cluster_StartThread(&Links[i].Thread, Cluster_LinkThread, &Links[i]);
+        pthread_mutex_lock(&Cluster.Lock);
+        Cluster.LiveLinkCount += Links[i].Started;
+        pthread_mutex_unlock(&Cluster.Lock);
+    }
+    Ok = Ok && Cluster.LiveLinkCount > 0;
+
+    for (int Row = MAX(0, StartRow); Ok && Row < Height; Row += BandHeight)
+    {
+        int RowCount = MIN(BandHeight, Height - Row);
+        pthread_mutex_lock(&Cluster.Lock);
+        Cluster.BandRow = Row;
+        Cluster.Band.Height = RowCount;
+        Cluster.Map = *Map;
+        Cluster.TileCount = 0;
+        for (int y = 0; y < RowCount; y += CLUSTER_TILE_HEIGHT)
+        {
+            for (int x = 0; x < Width; x += CLUSTER_TILE_WIDTH)
+            {
+                Cluster.Tiles[Cluster.TileCount++] = (cluster_tile) {
+                    .x = x,
+                    .y = y,
+                    .Width = MIN(CLUSTER_TILE_WIDTH, Width - x),
+                    .Height = MIN(CLUSTER_TILE_HEIGHT, RowCount - y),
+                    .State = CLUSTER_TILE_PENDING,
+                };
+            }
+        }
+        Cluster.PendingCount = Cluster.TileCount;
+        Cluster.DoneCount = 0;
+        pthread_cond_broadcast(&Cluster.Changed);
+        while (!Cluster.Failed && Cluster.DoneCount < Cluster.TileCount)
+            pthread_cond_wait(&Cluster.Changed, &Cluster.Lock);
+        Ok = !Cluster.Failed;
+        pthread_mutex_unlock(&Cluster.Lock);
+
+        Ok = Ok && Fn(UserData, &Cluster.Band, Row);
+    }
+
+    /* a failed render can still have tiles out, their links stop once they come back */
+    pthread_mutex_lock(&Cluster.Lock);
+    Cluster.Quit = true;
+    Cluster.PendingCount = 0;
+    pthread_cond_broadcast(&Cluster.Changed);
+    pthread_mutex_unlock(&Cluster.Lock);
+    for (int i = 0; Links && i < LinkCount; i++)
+    {
+        if (Links[i].Started)
+            pthread_join(Links[i].Thread, NULL);
+        if (Links[i].Socket >= 0)
+            close(Links[i].Socket);
+    }
+
+    pthread_cond_destroy(&Cluster.Changed);
+    pthread_mutex_destroy(&Cluster.Lock);
+    free(Links);
+    free(Cluster.Tiles);
+    free(Cluster.Band.Ptr);
+    return Ok;
+}
+
+#else
+
+Bool8 ClusterServeWorker(const render_engine *Engine, const char *Address)
+{
+    (void)Engine;
+    (void)Address;
+    fprintf(stderr, "workers need posix sockets\n");
+    return false;
+}
+
+Bool8 ClusterRenderBands(
+    const render_engine *Engine,
+    const coordmap *Map,
+    int Width, int Height,
+    int StartRow,
+    int BandHeight,
+    pixel_format Format,
+    Bool8 Supersample,
+    band_fn Fn,
+    void *UserData,
+    const char *const *Workers,
+    int WorkerCount
+)
+{
+    (void)Engine, (void)Map, (void)Width, (void)Height, (void)StartRow, (void)BandHeight;
+    (void)Format, (void)Supersample, (void)Fn, (void)UserData, (void)Workers, (void)WorkerCount;
+    fprintf(stderr, "workers need posix sockets\n");
+    return false;
+}
+
+#endif /* _WIN32 */
@@ -2,12 +2,16 @@
 #define COMMON_H
 
 #include <stdint.h>
+#include <stdio.h>
 
 typedef uint8_t u8;
+typedef int8_t i8;
 typedef uint16_t u16;
 typedef int16_t i16;
 typedef uint32_t u32;
+typedef int32_t i32;
 typedef uint64_t u64;
+typedef int64_t i64;
 typedef uint8_t Bool8;
 #define false 0
 #define true 1
@@ -24,21 +28,98 @@ typedef uint8_t Bool8;
 #  define MAX(a, b) ((a) > (b)? (a) : (b))
 #endif /* MAX */
 
+#ifndef THREAD_LOCAL
+#  ifdef _MSC_VER
+#    define THREAD_LOCAL __declspec(thread)
+#  else
+#    define THREAD_LOCAL __thread
+#  endif
+#endif /* THREAD_LOCAL */
+
 typedef struct color_buffer 
 {
     u32 Palette[16];
     u32 *Ptr;
     int Width;
     int Height;
+    int Stride; /* in pixels, distance between the start of 2 rows */
+
+    /* when it's not NULL, the kernels also write the iteration count they picked each color with here, 
+     * laid out like the pixels, ITERATION_COUNT_INSIDE for the pixels that never escaped, 
+     * only the full method fills every pixel with a kernel, so it's the only one that writes them */
+    u32 *Counts;
 } color_buffer;
 
+#define ITERATION_COUNT_INSIDE 0xFFFFFFFFu
+
+/* what a pixel is stored as once it's out of the kernels, rgb32 is what a color_buffer holds */
+typedef enum pixel_format
+{
+    PIXEL_FORMAT_RGB32 = 0,
+    PIXEL_FORMAT_INDEX8,    /* the palette index, PIXEL_INDEX_INSIDE inside the set */
+    PIXEL_FORMAT_COUNT16,   /* the iteration count, up to PIXEL_COUNT16_MAX, PIXEL_COUNT16_INSIDE inside the set */
+    PIXEL_FORMAT_RGB565,
+    PIXEL_FORMAT_RGB24,     /* r, g, b bytes, the way ppm and png have them */
+
+    PIXEL_FORMAT_COUNT,
+} pixel_format;
+
+#define PIXEL_INDEX_INSIDE 0xFF
+#define PIXEL_COUNT16_MAX 0xFFFE
+#define PIXEL_COUNT16_INSIDE 0xFFFF
+
+/* rows of pixels in any format */
+typedef struct pixel_buffer
+{
+    pixel_format Format;
+    void *Ptr;
+    int Width;
+    int Height;
+    size_t Stride; /* in bytes */
+} pixel_buffer;
+
+/* pixel (x, y) of a buffer is at (-Left + (OffsetX + x)*Delta, Top - (OffsetY + y)*Delta),
+ * a part of the buffer keeps Left and Top and only moves the offsets, 
+ * so a pixel gets the same point however the image was split up to render it */
 typedef struct coordmap
 {
     double Left, Top;
     double Width, Height;
     double Delta;
+    int OffsetX, OffsetY;
 } coordmap;
 
+static inline double GetMapX(const coordmap *Map, int x)
+{
+    return -Map->Left + (double)(Map->OffsetX + x) * Map->Delta;
+}
+
+static inline double GetMapY(const coordmap *Map, int y)
+{
+    return Map->Top - (double)(Map->OffsetY + y) * Map->Delta;
+}
+
+/* the polar counterpart of coordmap, for rings of points around a center, 
+ * pixel (x, y) is at Center + exp(LogRadius - y*LogDelta) * (Cos[x], Sin[x]), 
+ * every row is a circle that is a constant factor smaller than the one above it */
+typedef struct polarmap
+{
+    double CenterX, CenterY;
+    double LogRadius;
+    double LogDelta;
+    const double *Cos, *Sin;
+} polarmap;
+
+/* where each pixel stopped iterating, laid out the same way as the pixels of a color_buffer, 
+ * Z is the last value that was still bounded, Count is how many iterations it took to get there */
+typedef struct iteration_state
+{
+    double *Zx, *Zy;
+    u32 *Count;
+    u8 *Escaped;
+    int Stride;
+} iteration_state;
+
 
 static inline void GetDefaultPalette(u32 Palette[16])
 {
@@ -72,6 +153,22 @@ static inline void GetDefaultPalette(u32 Palette[16])
 
 #define STATIC_ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 
+#define MODE_MAX 9
+
+/* the even modes iterate in f32 */
+static inline Bool8 IsSingleMode(int Mode)
+{
+    return 0 == Mode % 2;
+}
+
+/* the scalar kernels (modes 0 and 1) count the iteration a pixel escaped on as well, the simd ones don't, 
+ * so the same pixel is one color further along the palette, and black when it escapes on the last iteration */
+static inline int GetModeCountBias(int Mode)
+{
+    return Mode < 2;
+}
+#define PROGRESSIVE_MAX_SPACING 8
+
 
 void RenderMandelbrotSet32_Unopt(
     color_buffer *ColorBuffer,
@@ -148,5 +245,738 @@ void RenderMandelbrotSet64_AVXFMA(
 );
 
 
-#endif /* COMMON_H */
+/* 
+ * continue iterating every pixel that has not escaped yet from where it stopped, 
+ * up to IterationCount, then color the pixels like the other kernels do, 
+ * the state is f64 but every step is done the way the kernel of Mode does it (in f32 for the f32 modes) 
+ * and the pixels are counted the way it counts them, 
+ * PointsX and PointsY are the points of the columns and rows, from GetModePoints, 
+ * so a resumed rectangle comes out the same as one rendered by the kernel of Mode 
+ */
+void ResumeMandelbrotSet64_Unopt(
+    color_buffer *ColorBuffer,
+    iteration_state *State,
+    const double *PointsX, 
+    const double *PointsY,
+    int Mode,
+    int IterationCount,
+    double MaxValue
+);
+
+void ResumeMandelbrotSet64_AVX(
+    color_buffer *ColorBuffer,
+    iteration_state *State,
+    const double *PointsX, 
+    const double *PointsY,
+    int Mode,
+    int IterationCount,
+    double MaxValue
+);
+
+
+/* 
+ * the same as the render kernels, but on the points of a polarmap instead of a grid, 
+ * they iterate and count like the kernel of Mode, 
+ * the avx one does the last (Width % 4) columns with the other one 
+ */
+void RenderPolarMandelbrotSet64_Unopt(
+    color_buffer *ColorBuffer,
+    const polarmap *Map,
+    int Mode,
+    int IterationCount,
+    double MaxValue
+);
+
+void RenderPolarMandelbrotSet64_AVX(
+    color_buffer *ColorBuffer,
+    const polarmap *Map,
+    int Mode,
+    int IterationCount,
+    double MaxValue
+);
+
+
+/* colors the rows of the buffer from its counts with its palette, the same colors the kernels would give them */
+void RecolorCounts_Unopt(color_buffer *ColorBuffer, int FirstRow, int RowCount);
+void RecolorCounts_AVX(color_buffer *ColorBuffer, int FirstRow, int RowCount);
+
+
+/* packs Count pixels into Format, from their colors (rgb32, rgb565) or their counts (index8, count16) */
+void PackPixels_Unopt(pixel_format Format, void *Dst, const u32 *Colors, const u32 *Counts, int Count);
+void PackPixels_AVX(pixel_format Format, void *Dst, const u32 *Colors, const u32 *Counts, int Count);
+
+/* the pieces of the image encoders that see every byte, 
+ * FilterPngRow writes the filter byte and the filtered row (sub or up, whichever looks smaller) to Dst, 
+ * GetMatchLength is how many of the first Max bytes of A and B are the same, 
+ * CountEqualPixels is how many of the first Count pixels are Value */
+void FilterPngRow_Unopt(u8 *Dst, const u8 *Row, const u8 *Prior, int Size, int PixelSize);
+void FilterPngRow_AVX(u8 *Dst, const u8 *Row, const u8 *Prior, int Size, int PixelSize);
+int GetMatchLength_Unopt(const u8 *A, const u8 *B, int Max);
+int GetMatchLength_AVX(const u8 *A, const u8 *B, int Max);
+int CountEqualPixels_Unopt(const u32 *Pixels, int Count, u32 Value);
+int CountEqualPixels_AVX(const u32 *Pixels, int Count, u32 Value);
+
+
+/* Render.c */
+
+/* one of the grids of samples that a progressive pass renders, 
+ * sample (i, j) of the grid lands on pixel (OffsetX + i*Step, OffsetY + j*Step) */
+typedef struct progressive_subgrid
+{
+    int OffsetX, OffsetY;
+    int Step;
+} progressive_subgrid;
+
+/* renders the whole buffer with the kernel of the given mode, 
+ * including the columns that don't fit in a simd register */
+void RenderMandelbrotSet(
+    int Mode,
+    color_buffer *ColorBuffer,
+    const coordmap *Map,
+    int IterationCount,
+    double MaxValue
+);
+
+/* the points of the columns and rows of a rectangle of up to a tile, 
+ * rounded and stepped from one to the next exactly the way RenderMandelbrotSet has them in that mode */
+void GetModePoints(int Mode, const coordmap *Map, int Width, int Height, double *PointsX, double *PointsY);
+
+/* bytes per pixel, and the name that goes on the command line */
+int GetPixelFormatSize(pixel_format Format);
+const char *GetPixelFormatName(pixel_format Format);
+
+/* packs pixels with the function that fits the mode */
+void PackPixels(int Mode, pixel_format Format, void *Dst, const u32 *Colors, const u32 *Counts, int Count);
+
+/* the encoder functions that fit the mode */
+void FilterPngRow(int Mode, u8 *Dst, const u8 *Row, const u8 *Prior, int Size, int PixelSize);
+int GetMatchLength(int Mode, const u8 *A, const u8 *B, int Max);
+int CountEqualPixels(int Mode, const u32 *Pixels, int Count, u32 Value);
+
+/* recolors the rows of the buffer from its counts with the function that fits the mode */
+void RecolorCounts(int Mode, color_buffer *ColorBuffer, int FirstRow, int RowCount);
+
+/* renders the whole buffer on the points of a polar map with the kernel that fits the mode */
+void RenderPolarMandelbrotSet(
+    int Mode,
+    color_buffer *ColorBuffer,
+    const polarmap *Map,
+    int IterationCount,
+    double MaxValue
+);
+
+typedef enum render_method
+{
+    RENDER_METHOD_FULL = 0,
+    RENDER_METHOD_SUBDIVIDE,
+    RENDER_METHOD_BOUNDARY_TRACE,
+    RENDER_METHOD_RESUMABLE,
+    RENDER_METHOD_ANYTIME,
+
+    RENDER_METHOD_COUNT,
+} render_method;
+
+#define TILE_SIZE 64
+
+/* a buffer split into TILE_SIZE x TILE_SIZE tiles, 
+ * render threads grab the next tile by atomically incrementing NextTile */
+typedef struct tile_job
+{
+    color_buffer ColorBuffer;
+    coordmap Map;
+    render_method Method;
+    int Mode, IterationCount;
+    double MaxValue;
+
+    /* for RENDER_METHOD_RESUMABLE and RENDER_METHOD_ANYTIME, same layout as ColorBuffer, 
+     * ResetState starts every pixel over from 0 instead of resuming it */
+    iteration_state IterationState;
+    Bool8 ResetState;
+
+    int TileCountX, TileCountY;
+    int TileCount;
+    volatile long NextTile;
+} tile_job;
+
+tile_job MakeTileJob(
+    render_method Method, 
+    int Mode, 
+    const color_buffer *ColorBuffer, 
+    const coordmap *Map, 
+    int IterationCount, 
+    double MaxValue
+);
+
+/* everything that decides what the pixels of a rendered buffer look like */
+typedef struct render_view
+{
+    coordmap Map;
+    int Width, Height;
+    int IterationCount, Mode;
+    render_method Method;
+} render_view;
+
+Bool8 RenderViewEqual(const render_view *A, const render_view *B);
+
+/* true when Curr only differs from Last by a translation, 
+ * the translation is rounded to whole pixels and Curr->Map is snapped onto the pixel grid of Last, 
+ * the old pixel (x, y) ends up at (x + ShiftX, y + ShiftY) */
+Bool8 GetPanOffset(const render_view *Last, render_view *Curr, int *ShiftX, int *ShiftY);
+
+/* moves every pixel by (ShiftX, ShiftY), the pixels that get uncovered are left as is */
+void ShiftColorBuffer(color_buffer *Buffer, int ShiftX, int ShiftY);
+
+/* the w*h rectangle at (x, y) of the buffer, and the part of the map that it covers */
+void GetSubRect(
+    const color_buffer *ColorBuffer, const coordmap *Map, 
+    int x, int y, int w, int h, 
+    color_buffer *SubBuffer, coordmap *SubMap
+);
+
+/* renders tile number TileIndex (row major) of the job with the job's method */
+void RenderTile(tile_job *Job, int TileIndex);
+
+int GetProgressiveSubgrids(int Spacing, progressive_subgrid Subgrids[3]);
+
+void GetProgressiveSubgridSize(
+    progressive_subgrid Grid, 
+    int Width, int Height, 
+    int *GridWidth, int *GridHeight
+);
+
+coordmap GetProgressiveSubgridMap(progressive_subgrid Grid, const coordmap *Map);
+
+void ScatterProgressiveSubgrid(
+    color_buffer *Dst, 
+    const color_buffer *Samples, 
+    progressive_subgrid Grid, 
+    int BlockSize
+);
+
+#define ESCAPE_PROBE_WIDTH 32
+#define ESCAPE_PROBE_HEIGHT 24
+#define ITERATION_COUNT_MIN 64
+#define ITERATION_COUNT_MAX 1000000
+
+/* scratch space of ProbeEscapeCounts */
+typedef struct escape_probe
+{
+    u32 Colors[ESCAPE_PROBE_WIDTH * ESCAPE_PROBE_HEIGHT];
+    double Zx[ESCAPE_PROBE_WIDTH * ESCAPE_PROBE_HEIGHT];
+    double Zy[ESCAPE_PROBE_WIDTH * ESCAPE_PROBE_HEIGHT];
+    u32 Count[ESCAPE_PROBE_WIDTH * ESCAPE_PROBE_HEIGHT];
+    u8 Escaped[ESCAPE_PROBE_WIDTH * ESCAPE_PROBE_HEIGHT];
+} escape_probe;
+
+typedef struct escape_stats
+{
+    int IterationCount;
+    int SampleCount;
+    int BoundedCount;   /* never escaped, drawn black */
+    int LateCount;      /* escaped in the upper half of the limit */
+    int MaxEscapeCount; /* the most iterations any escaping sample needed */
+} escape_stats;
+
+/* renders a coarse grid of samples over the Width*Height view and counts how they escaped */
+escape_stats ProbeEscapeCounts(
+    escape_probe *Probe, 
+    int Mode, 
+    const coordmap *Map, 
+    int Width, int Height, 
+    int IterationCount, 
+    double MaxValue
+);
+
+#define SUPERSAMPLE_GRID 4
+#define SUPERSAMPLE_COUNT (SUPERSAMPLE_GRID * SUPERSAMPLE_GRID)
+#define SUPERSAMPLE_THRESHOLD 32
+
+/* marks the pixels of the rows that differ from one of their 4 neighbors 
+ * by more than Threshold (summed over r, g and b), Edges has the same layout as the buffer, 
+ * returns how many got marked */
+int FindEdgePixels(const color_buffer *Buffer, u8 *Edges, int FirstRow, int RowCount, int Threshold);
+
+/* replaces the marked pixels of the rows with the average of SUPERSAMPLE_COUNT jittered samples, 
+ * only reads the marks, so the rows can be split between threads once all of them are marked */
+void SupersampleEdgePixels(
+    int Mode, 
+    color_buffer *Buffer, 
+    const u8 *Edges, 
+    const coordmap *Map, 
+    int IterationCount, 
+    double MaxValue, 
+    int FirstRow, int RowCount
+);
+
+/* fills the pixels of the rows that can be taken from the previous frame of a zoom (Previous, the image of PreviousMap), 
+ * marks the ones that can't, Marks has the same layout as the buffer, returns how many got marked */
+int ReusePreviousFrame(
+    color_buffer *Buffer, 
+    u8 *Marks, 
+    const coordmap *Map, 
+    const color_buffer *Previous, 
+    const coordmap *PreviousMap, 
+    int FirstRow, int RowCount
+);
 
+/* renders the marked pixels of the rows, leaves the rest alone */
+void RenderMarkedPixels(
+    int Mode, 
+    color_buffer *Buffer, 
+    const u8 *Marks, 
+    const coordmap *Map, 
+    int IterationCount, 
+    double MaxValue, 
+    int FirstRow, int RowCount
+);
+
+/* the iteration count that the view should get next, 
+ * Zoom is how far the view is magnified compared to the whole set */
+int EstimateIterationCount(const escape_stats *Stats, double Zoom);
+
+
+
+/* Cache.c */
+
+#define TILE_CACHE_LEVELS_PER_OCTAVE 32
+#define TILE_CACHE_CAPACITY 1024
+
+/* only the mandelbrot set for now */
+#define FORMULA_MANDELBROT 0
+
+typedef struct tile_key
+{
+    int Level;
+    i64 TileX, TileY;
+    int IterationCount;
+    int Mode;
+    render_method Method;
+    int Formula;
+} tile_key;
+
+typedef struct tile_cache_entry
+{
+    tile_key Key;
+    u32 Hash;
+    int Next;
+    int MoreRecent, LessRecent;
+    u32 Pixels[TILE_SIZE * TILE_SIZE];
+} tile_cache_entry;
+
+/* not thread safe, lookups and inserts happen on the main thread, 
+ * the render threads only fill in the pixels of entries they were handed */
+typedef struct tile_cache
+{
+    tile_cache_entry *Entries;
+    int Count, Capacity;
+    int *Buckets;
+    int BucketCount;
+    int MostRecent, LeastRecent;
+    u64 Hits, Misses;
+} tile_cache;
+
+/* a view snapped onto the global pixel grid of a quantized scale */
+typedef struct tile_grid
+{
+    int Level;
+    double Delta;
+    i64 OriginX, OriginY; /* global pixel of the top left corner */
+    int Width, Height;
+} tile_grid;
+
+u32 HashTileKey(const tile_key *Key);
+Bool8 TileKeyEqual(const tile_key *A, const tile_key *B);
+
+Bool8 TileCacheInit(tile_cache *Cache, int Capacity);
+void TileCacheDestroy(tile_cache *Cache);
+
+/* marks the entry as the most recently used one, NULL when it's not cached */
+tile_cache_entry *TileCacheLookup(tile_cache *Cache, const tile_key *Key);
+
+/* evicts the least recently used entry when full, the caller fills in the pixels */
+tile_cache_entry *TileCacheInsert(tile_cache *Cache, const tile_key *Key);
+
+/* quantizes Map->Delta and moves Map onto the pixel grid of that scale, keeping its center */
+void SnapViewToTileGrid(coordmap *Map, int Width, int Height, tile_grid *Grid);
+
+/* the range of tiles that the grid covers, returns the number of tiles */
+int GetTileGridTiles(const tile_grid *Grid, i64 *FirstTileX, i64 *FirstTileY, int *TileCountX, int *TileCountY);
+
+coordmap GetTileGridMap(const tile_grid *Grid, i64 TileX, i64 TileY);
+
+void CopyTileToBuffer(
+    color_buffer *Buffer, 
+    const tile_grid *Grid, 
+    i64 TileX, i64 TileY, 
+    const u32 *Pixels
+);
+
+
+/* Store.c */
+
+#define TILE_STORE_PATH "Simdbrot.tiles"
+
+/* not thread safe either, same rules as the tile cache */
+typedef struct tile_store
+{
+#ifdef _WIN32
+    void *File, *Mapping;
+#else
+    int File;
+#endif /* _WIN32 */
+    u8 *Base;
+    u64 MappedSize;
+    u64 RecordCapacity;
+    i64 *Slots;
+    u64 SlotCount;
+} tile_store;
+
+/* creates the file when it doesn't exist, starts over when it was made with another palette,
+ * fails when another process has it open */
+Bool8 TileStoreOpen(tile_store *Store, const char *Path, const u32 Palette[16]);
+void TileStoreClose(tile_store *Store);
+
+/* the pixels live in the mapped file, they stay valid until the next TileStorePut */
+const u32 *TileStoreLookup(tile_store *Store, const tile_key *Key);
+
+/* appends the tile, a tile that was already stored gets replaced, 
+ * closes the store if the file can't grow */
+Bool8 TileStorePut(tile_store *Store, const tile_key *Key, const u32 *Pixels);
+
+/* number of tiles in the file */
+u64 TileStoreCount(tile_store *Store);
+
+
+/* Engine.c */
+
+#define ENGINE_MAX_THREAD_COUNT 128
+/* strips start every ENGINE_STRIP_HEIGHT rows whatever the thread count, the kernels step from the first row of a strip 
+ * and the pixels would round differently with the strips somewhere else, streaming strips are a few of them together */
+#define ENGINE_STRIP_HEIGHT 16
+#define ENGINE_STREAM_STRIP_HEIGHT TILE_SIZE
+
+/* called on the render thread that just finished a part of the buffer, Tile points into the buffer being rendered 
+ * and its pixels don't change again during the render, so it can be shown, encoded or sent while the rest renders */
+typedef void (*tile_done_fn)(void *UserData, const color_buffer *Tile);
+
+/* threads that stay around between loops, see EngineCreatePool */
+typedef struct engine_pool engine_pool;
+
+/* the settings every render goes through */
+typedef struct render_engine
+{
+    /* the loops run on Pool when there is one, on ThreadCount new threads otherwise, 
+     * ThreadCount is still how many parts a buffer is split into */
+    int ThreadCount;
+    engine_pool *Pool;
+    int Mode;
+    render_method Method;
+    int IterationCount;
+    double MaxValue;
+    u32 Palette[16];
+
+    /* optional, EngineRenderStrips and EngineRenderTiles call it for every strip and tile, 
+     * the passes that render somewhere else first (progressive, tile cache) don't */
+    tile_done_fn TileDone;
+    void *TileDoneUserData;
+} render_engine;
+
+typedef void (*parallel_for_fn)(void *UserData, int Index);
+
+/* calls Fn(UserData, i) for every i in [0, Count) on up to ThreadCount threads, 
+ * every thread keeps grabbing the next index until there's none left, returns once all of them are done */
+void ParallelFor(int ThreadCount, int Count, parallel_for_fn Fn, void *UserData);
+
+/* a pool of ThreadCount threads, counting the one that runs a loop, so ThreadCount - 1 of them are made, 
+ * any thread can run loops on it at any time, NULL when out of memory */
+engine_pool *EngineCreatePool(int ThreadCount);
+void EngineDestroyPool(engine_pool *Pool);
+int EngineGetPoolThreadCount(const engine_pool *Pool);
+
+/* ParallelFor on the pool */
+void EnginePoolFor(engine_pool *Pool, int Count, parallel_for_fn Fn, void *UserData);
+
+/* ParallelFor on the engine's pool, or on ThreadCount new threads when it has none */
+void EngineParallelFor(const render_engine *Engine, int Count, parallel_for_fn Fn, void *UserData);
+
+int GetProcessorCount(void);
+double GetTimeMillisec(void);
+
+/* the fastest f64 kernel that the cpu supports */
+int GetBestMode(void);
+
+/* whether the cpu has what the kernels of Mode need */
+Bool8 CanRunMode(int Mode);
+
+const char *GetModeName(int Mode);
+const char *GetRenderMethodName(render_method Method);
+
+/* every processor, the best mode, the full method, 400 iterations and the default palette */
+render_engine MakeRenderEngine(void);
+
+color_buffer MakeColorBuffer(const render_engine *Engine, u32 *Ptr, int Width, int Height, int Stride);
+
+/* a map with square pixels, Height units high around (CenterX, CenterY) */
+coordmap MakeCenteredMap(double CenterX, double CenterY, double Height, int BufferWidth, int BufferHeight);
+
+/* horizontal strips of ENGINE_STRIP_HEIGHT rows, always uses the kernels directly, 
+ * strips of ENGINE_STREAM_STRIP_HEIGHT rows when there's a TileDone to hear about them */
+void EngineRenderStrips(const render_engine *Engine, const color_buffer *Buffer, const coordmap *Map);
+
+void EngineRenderTiles(const render_engine *Engine, tile_job *Job);
+
+/* strips for the methods that render every pixel anyway, tiles for the others */
+void EngineRenderBuffer(const render_engine *Engine, const color_buffer *Buffer, const coordmap *Map);
+
+/* one view of a batch, rendered with the engine's mode, method and escape radius */
+typedef struct engine_view
+{
+    color_buffer Buffer;
+    coordmap Map;
+    int IterationCount;
+    u8 *Edges; /* optional, like the Edges of EngineSupersampleEdges, the view gets supersampled when it's there */
+} engine_view;
+
+/* renders all the views in one loop over the tiles of every one of them, 
+ * so a batch of small views keeps the threads as busy as one big view would, 
+ * the resumable methods render like the full one, there's no state to resume from, 
+ * false when out of memory, nothing is rendered then */
+Bool8 EngineRenderViews(const render_engine *Engine, const engine_view *Views, int ViewCount);
+
+/* renders the pass with the given spacing, Samples holds at least a quarter of the buffer */
+void EngineRenderProgressivePass(
+    const render_engine *Engine, 
+    color_buffer *Buffer, 
+    const coordmap *Map, 
+    int Spacing, 
+    u32 *Samples
+);
+
+/* the buffer already holds the image of Map before it was moved by (ShiftX, ShiftY), 
+ * move the pixels that are still visible and only render the strips that got uncovered */
+void EngineRenderPan(
+    const render_engine *Engine, 
+    color_buffer *Buffer, 
+    const coordmap *Map, 
+    int ShiftX, int ShiftY
+);
+
+/* recolors a buffer that was rendered with counts (with the full method) from them, with the buffer's palette, 
+ * nothing gets iterated, so a new palette shows up right away */
+void EngineRecolor(const render_engine *Engine, color_buffer *Buffer);
+
+/* anti-aliases the edges of a rendered buffer, Edges has the same layout as the buffer, 
+ * returns the number of pixels that got supersampled */
+int EngineSupersampleEdges(const render_engine *Engine, color_buffer *Buffer, const coordmap *Map, u8 *Edges);
+
+/* after EngineRenderPan, anti-aliases the strips that got uncovered and the pixels along their seam, 
+ * the rest of the buffer was anti-aliased before it moved */
+int EngineSupersamplePan(
+    const render_engine *Engine, 
+    color_buffer *Buffer, 
+    const coordmap *Map, 
+    u8 *Edges, 
+    int ShiftX, int ShiftY
+);
+
+/* copies every tile of the grid that is cached (or stored, Store can be NULL), 
+ * renders, caches and stores the ones that aren't, 
+ * false when the grid needs more tiles than the cache holds or out of memory, the buffer is untouched then */
+Bool8 EngineRenderFromTileCache(
+    const render_engine *Engine, 
+    tile_cache *Cache, 
+    tile_store *Store, 
+    color_buffer *Buffer, 
+    const tile_grid *Grid
+);
+
+/* renders the next frame of a zoom into Buffer, reusing what it can of Previous (the frame of PreviousMap), 
+ * Marks has the same layout as the buffer, returns the number of pixels that had to be rendered */
+int EngineRenderZoomFrame(
+    const render_engine *Engine, 
+    color_buffer *Buffer, 
+    const coordmap *Map, 
+    const color_buffer *Previous, 
+    const coordmap *PreviousMap, 
+    u8 *Marks
+);
+
+/* gets each band once it's rendered, the band is reused after it returns, false stops the render */
+typedef Bool8 (*band_fn)(void *UserData, const pixel_buffer *Band, int FirstRow);
+
+/* renders the Width*Height image of Map BandHeight rows at a time from StartRow on, with every thread on each band, 
+ * only one band is ever in memory, false when out of memory or Fn stopped it, 
+ * the formats other than rgb32 are rendered with the full method, in blocks that fit in the cache and get packed 
+ * straight into the band, so the band only ever sees the narrow pixels, they can't be supersampled */
+Bool8 EngineRenderBands(
+    const render_engine *Engine, 
+    const coordmap *Map, 
+    int Width, int Height, 
+    int StartRow, 
+    int BandHeight, 
+    pixel_format Format, 
+    Bool8 Supersample, 
+    band_fn Fn, 
+    void *UserData
+);
+
+/* ExpMap.c */
+
+#define EXP_MAP_BAND_HEIGHT 64
+
+/* the strip of an exponential map zoom into (CenterX, CenterY), and where the pixels of a frame are in it */
+typedef struct exp_map
+{
+    double CenterX, CenterY;
+    /* row y of the strip is the circle of radius exp(LogRadius - y*LogDelta), 
+     * LogDelta is also the angle between two samples of a row, so the samples are square */
+    double LogRadius;
+    double LogDelta;
+    int Width;
+    int RowCount;
+
+    /* the rows that were rendered so far, only the last WindowHeight of them are still in the window */
+    int RenderedRowCount;
+    int WindowHeight;
+    u32 *Window;
+    double *Cos, *Sin;
+
+    /* the row (relative to the row of the frame's pixel size) and the column of every pixel of a frame */
+    int FrameWidth, FrameHeight;
+    float *PixelRows, *PixelColumns;
+} exp_map;
+
+/* sets up the strip for a zoom from a view StartViewHeight high to one EndViewHeight high, 
+ * (zooming in, so End < Start), with frames of FrameWidth*FrameHeight pixels, 
+ * false when out of memory */
+Bool8 ExpMapInit(
+    exp_map *Map, 
+    double CenterX, double CenterY, 
+    double StartViewHeight, double EndViewHeight, 
+    int FrameWidth, int FrameHeight
+);
+void ExpMapFree(exp_map *Map);
+
+/* the frame of the zoom whose view is ViewHeight high, renders the rows of the strip that it's the first to need, 
+ * the frames have to come in order, each one no bigger than the one before */
+void ExpMapRenderFrame(const render_engine *Engine, exp_map *Map, color_buffer *Frame, double ViewHeight);
+
+/* Image.c */
+
+/* binary ppm (P6), written a band of rows at a time so the image never has to be in memory all at once */
+Bool8 WritePPMHeader(FILE *File, int Width, int Height);
+Bool8 WritePPMRows(FILE *File, const color_buffer *Band);
+
+/* the file for an image in any of the formats, rgb32 is a ppm, index8 and count16 are pgms (8 and 16 bit), 
+ * rgb24 is a ppm too, rgb565 is only the pixels, little endian, no header */
+Bool8 WriteImageHeader(FILE *File, pixel_format Format, int Width, int Height);
+Bool8 WriteImageRows(FILE *File, const pixel_buffer *Band);
+
+/* uncompressed video (YUV4MPEG2, 4:4:4), what ffmpeg and the like read from a pipe */
+Bool8 WriteY4MHeader(FILE *File, int Width, int Height, int FrameRate);
+Bool8 WriteY4MFrame(FILE *File, const color_buffer *Frame);
+
+/* Encoder.c */
+
+/* what the file of an image is, netpbm is what WriteImageHeader and WriteImageRows write */
+typedef enum image_file_format
+{
+    IMAGE_FILE_NETPBM = 0,
+    IMAGE_FILE_PNG,
+    IMAGE_FILE_QOI,
+} image_file_format;
+
+/* rows of a band that one thread encodes on its own, into bytes that go in the file as they are */
+typedef struct image_encoder_piece
+{
+    u8 *Data;
+    size_t Size;
+    /* png, the rows before and after filtering, what was deflated, and where the matches are */
+    u8 *Rows;
+    u8 *Filtered;
+    size_t FilteredSize;
+    u32 Adler;
+    i32 *Head;
+} image_encoder_piece;
+
+/* encodes an image a band at a time, the bands split into pieces that are encoded on every thread, 
+ * a piece of a qoi starts without the state of the one before (its first pixel is a full color), 
+ * a piece of a png is a deflate stream on its own (ending with a flush), 
+ * so the file is the pieces one after the other */
+typedef struct image_encoder
+{
+    const render_engine *Engine;
+    FILE *File;
+    image_file_format FileFormat;
+    pixel_format Format;
+    int Width, Height;
+    Bool8 Stored; /* png, no compression, only filtering */
+
+    int RowSize;    /* of a row as it's encoded */
+    int PixelSize;
+    int PieceHeight;
+    int PieceCount;
+    image_encoder_piece *Pieces;
+    const pixel_buffer *Band;
+
+    /* png, the last row of the band before, for the filter, and the checksum of everything so far */
+    u8 *PriorRow;
+    u32 Adler;
+} image_encoder;
+
+/* whether the pixels of Format can go in the file */
+Bool8 ImageEncoderSupports(image_file_format FileFormat, pixel_format Format);
+
+/* writes the header, false when out of memory or the file can't be written */
+Bool8 ImageEncoderInit(
+    image_encoder *Encoder, 
+    const render_engine *Engine, 
+    FILE *File, 
+    image_file_format FileFormat, 
+    pixel_format Format, 
+    int Width, int Height, 
+    Bool8 Stored
+);
+Bool8 ImageEncoderWriteBand(image_encoder *Encoder, const pixel_buffer *Band);
+Bool8 ImageEncoderFinish(image_encoder *Encoder);
+void ImageEncoderFree(image_encoder *Encoder);
+
+
+/* Server.c */
+
+typedef struct tile_server_options
+{
+    int Port; /* 0 for any free one */
+    Bool8 Supersample;
+    Bool8 Stored;
+} tile_server_options;
+
+/* serves the tiles of the xyz pyramid on localhost, rendered with the engine (and a pool of its ThreadCount threads), 
+ * only returns when it can't start, with false */
+Bool8 ServeTiles(const render_engine *Engine, const tile_server_options *Options);
+
+
+/* Cluster.c */
+
+/* renders the tiles that coordinators send to Address (unix:PATH or HOST:PORT) with the engine's threads, 
+ * only returns when it can't start, with false */
+Bool8 ClusterServeWorker(const render_engine *Engine, const char *Address);
+
+/* EngineRenderBands on the workers at the given addresses instead of this box, 
+ * the tiles of a worker that fails go to the others, false also when every worker is lost */
+Bool8 ClusterRenderBands(
+    const render_engine *Engine, 
+    const coordmap *Map, 
+    int Width, int Height, 
+    int StartRow, 
+    int BandHeight, 
+    pixel_format Format, 
+    Bool8 Supersample, 
+    band_fn Fn, 
+    void *UserData, 
+    const char *const *Workers, 
+    int WorkerCount
+);
+
+
+#endif /* COMMON_H */
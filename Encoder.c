@@ -0,0 +1,637 @@
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Common.h"
+
+/*
+ * Built-in image encoders:
+ * an image far bigger than memory can't wait for a library to encode it afterwards,
+ * so every band is encoded as soon as it's rendered, split into pieces that all the render threads work on.
+ * QOI is a byte stream where every pixel depends on the ones before it,
+ * a piece starts over with an empty index and a full color for its first pixel, which the format allows anywhere.
+ * PNG is filtered rows (sub or up) in a zlib stream, a piece is deflated on its own and ends with a flush
+ * (an empty stored block), so that its bytes carry on from wherever the piece before it ended,
+ * and goes in the file as its own IDAT chunk. The adler32 of the whole stream is put together from those of the pieces.
+ * The deflate is the fast kind: fixed codes, one hash lookup per byte, the first match that's long enough.
+ */
+
+/* about how many bytes of rows a piece has */
+#define IMAGE_ENCODER_PIECE_SIZE (256 << 10)
+
+#define DEFLATE_WINDOW_SIZE 32768
+#define DEFLATE_MIN_MATCH 4
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_STORED_BLOCK_SIZE 65535
+
+#define ADLER_BASE 65521
+
+static const u16 DeflateLengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const u8 DeflateLengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const u16 DeflateDistanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const u8 DeflateDistanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* the tables are filled in once, by whichever encoder comes first, the others wait for it */
+static pthread_once_t EncoderTablesOnce = PTHREAD_ONCE_INIT;
+static u32 Crc32Table[8][256];
+static u16 FixedCodes[288];     /* bit reversed, deflate sends huffman codes from the top bit down */
+static u8 FixedCodeLengths[288];
+static u8 DistanceCodes[30];
+static u8 LengthSymbols[256];   /* of length - 3 */
+static u8 DistanceSymbols[512]; /* of distance - 1 up to 256, then of (distance - 1) >> 7 from 256 on */
+
+static u32 ReverseBits(u32 Value, int Count)
+{
+    u32 Reversed = 0;
+    for (int i = 0; i < Count; i++)
+        Reversed |= ((Value >> i) & 1) << (Count - 1 - i);
+    return Reversed;
+}
+
+static void EncoderInitTables(void)
+{
+    for (u32 n = 0; n < 256; n++)
+    {
+        u32 Crc = n;
+        for (int k = 0; k < 8; k++)
+            Crc = Crc & 1? 0xEDB88320 ^ (Crc >> 1) : Crc >> 1;
+        Crc32Table[0][n] = Crc;
+    }
+    for (int k = 1; k < 8; k++)
+    {
+        for (int n = 0; n < 256; n++)
+            Crc32Table[k][n] = (Crc32Table[k - 1][n] >> 8) ^ Crc32Table[0][Crc32Table[k - 1][n] & 0xFF];
+    }
+
+    for (int Symbol = 0; Symbol < 288; Symbol++)
+    {
+        u32 Code;
+        int Length;
+        if (Symbol < 144)       Code = 0x30 + Symbol,          Length = 8;
+        else if (Symbol < 256)  Code = 0x190 + Symbol - 144,   Length = 9;
+        else if (Symbol < 280)  Code = Symbol - 256,           Length = 7;
+        else                    Code = 0xC0 + Symbol - 280,    Length = 8;
+        FixedCodes[Symbol] = (u16)ReverseBits(Code, Length);
+        FixedCodeLengths[Symbol] = (u8)Length;
+    }
+    for (int Code = 0; Code < 30; Code++)
+        DistanceCodes[Code] = (u8)ReverseBits(Code, 5);
+
+    int Length = 0;
+    for (int Code = 0; Code < 28; Code++)
+    {
+        for (int n = 0; n < 1 << DeflateLengthExtra[Code]; n++)
+            LengthSymbols[Length++] = (u8)Code;
+    }
+    LengthSymbols[255] = 28;
+
+    int Distance = 0;
+    for (int Code = 0; Code < 16; Code++)
+    {
+        for (int n = 0; n < 1 << DeflateDistanceExtra[Code]; n++)
+            DistanceSymbols[Distance++] = (u8)Code;
+    }
+    Distance >>= 7;
+    for (int Code = 16; Code < 30; Code++)
+    {
+        for (int n = 0; n < 1 << (DeflateDistanceExtra[Code] - 7); n++)
+            DistanceSymbols[256 + Distance++] = (u8)Code;
+    }
+}
+
+static u32 Load32(const u8 *Ptr)
+{
+    u32 Value;
+    memcpy(&Value, Ptr, sizeof Value);
+    return Value;
+}
+
+static void StoreBigEndian32(u8 *Ptr, u32 Value)
+{
+    Ptr[0] = (u8)(Value >> 24);
+    Ptr[1] = (u8)(Value >> 16);
+    Ptr[2] = (u8)(Value >> 8);
+    Ptr[3] = (u8)Value;
+}
+
+static u32 Crc32(u32 Crc, const u8 *Data, size_t Size)
+{
+    /* 8 bytes at a time */
+    Crc = ~Crc;
+    for (; Size >= 8; Size -= 8, Data += 8)
+    {
+        u32 Low = Crc ^ Load32(Data);
+        u32 High = Load32(Data + 4);
+        Crc = Crc32Table[7][Low & 0xFF] ^ Crc32Table[6][(Low >> 8) & 0xFF]
+            ^ Crc32Table[5][(Low >> 16) & 0xFF] ^ Crc32Table[4][Low >> 24]
+            ^ Crc32Table[3][High & 0xFF] ^ Crc32Table[2][(High >> 8) & 0xFF]
+            ^ Crc32Table[1][(High >> 16) & 0xFF] ^ Crc32Table[0][High >> 24];
+    }
+    for (; Size; Size--, Data++)
+        Crc = Crc32Table[0][(Crc ^ *Data) & 0xFF] ^ (Crc >> 8);
+    return ~Crc;
+}
+
+static u32 Adler32(u32 Adler, const u8 *Data, size_t Size)
+{
+    /* 5552 bytes is as many as the sums can take before they have to be reduced */
+    u32 A = Adler & 0xFFFF;
+    u32 B = Adler >> 16;
+    while (Size)
+    {
+        size_t Count = MIN(Size, 5552);
+        Size -= Count;
+        for (; Count; Count--)
+        {
+            A += *Data++;
+            B += A;
+        }
+        A %= ADLER_BASE;
+        B %= ADLER_BASE;
+    }
+    return (B << 16) | A;
+}
+
+/* the adler32 of A's bytes followed by B's SizeB bytes */
+static u32 Adler32Combine(u32 AdlerA, u32 AdlerB, size_t SizeB)
+{
+    u32 Remainder = (u32)(SizeB % ADLER_BASE);
+    u32 A = AdlerA & 0xFFFF;
+    u32 B = (u32)(((u64)Remainder * A) % ADLER_BASE);
+    A += (AdlerB & 0xFFFF) + ADLER_BASE - 1;
+    B += (AdlerA >> 16) + (AdlerB >> 16) + ADLER_BASE - Remainder;
+    if (A >= ADLER_BASE) A -= ADLER_BASE;
+    if (A >= ADLER_BASE) A -= ADLER_BASE;
+    if (B >= 2*ADLER_BASE) B -= 2*ADLER_BASE;
+    if (B >= ADLER_BASE) B -= ADLER_BASE;
+    return (B << 16) | A;
+}
+
+
+
+typedef struct bit_writer
+{
+    u8 *Ptr;
+    u64 Bits;
+    int Count;
+} bit_writer;
+
+static inline void PutBits(bit_writer *Writer, u32 Value, int Count)
+{
+    /* deflate fills bytes from the low bit up */
+    Writer->Bits |= (u64)Value << Writer->Count;
+    Writer->Count += Count;
+    if (Writer->Count >= 32)
+    {
+        u32 Low = (u32)Writer->Bits;
+        memcpy(Writer->Ptr, &Low, sizeof Low);
+        Writer->Ptr += 4;
+        Writer->Bits >>= 32;
+        Writer->Count -= 32;
+    }
+}
+
+static void FlushBits(bit_writer *Writer)
+{
+    for (; Writer->Count > 0; Writer->Count -= 8)
+    {
+        *Writer->Ptr++ = (u8)Writer->Bits;
+        Writer->Bits >>= 8;
+    }
+    Writer->Bits = 0;
+    Writer->Count = 0;
+}
+
+static inline void PutLiteral(bit_writer *Writer, int Symbol)
+{
+    PutBits(Writer, FixedCodes[Symbol], FixedCodeLengths[Symbol]);
+}
+
+static inline void PutMatch(bit_writer *Writer, int Length, int Distance)
+{
+    int LengthCode = LengthSymbols[Length - 3];
+    PutLiteral(Writer, 257 + LengthCode);
+    PutBits(Writer, Length - DeflateLengthBase[LengthCode], DeflateLengthExtra[LengthCode]);
+
+    int DistanceCode = Distance <= 256
+        ? DistanceSymbols[Distance - 1]
+        : DistanceSymbols[256 + ((Distance - 1) >> 7)];
+    PutBits(Writer, DistanceCodes[DistanceCode], 5);
+    PutBits(Writer, Distance - DeflateDistanceBase[DistanceCode], DeflateDistanceExtra[DistanceCode]);
+}
+
+/* the most a piece of Size bytes can deflate to, including the flush */
+static size_t DeflateBound(size_t Size)
+{
+    return Size + Size/8 + 5 * (Size / DEFLATE_STORED_BLOCK_SIZE + 1) + 16;
+}
+
+static u8 *DeflateStored(u8 *Out, const u8 *In, size_t Size)
+{
+    /* blocks that aren't the last one, the stream doesn't end with a piece, so it always ends on a byte */
+    while (Size)
+    {
+        u16 Count = (u16)MIN(Size, DEFLATE_STORED_BLOCK_SIZE);
+        Out[0] = 0;
+        Out[1] = (u8)Count;
+        Out[2] = (u8)(Count >> 8);
+        Out[3] = (u8)~Count;
+        Out[4] = (u8)(~Count >> 8);
+        memcpy(Out + 5, In, Count);
+        Out += 5 + Count;
+        In += Count;
+        Size -= Count;
+    }
+    return Out;
+}
+
+static u8 *DeflateFixed(int Mode, u8 *Out, const u8 *In, size_t Size, i32 *Head)
+{
+    bit_writer Writer = { .Ptr = Out };
+
+    /* not the last block, fixed codes */
+    PutBits(&Writer, 1 << 1, 3);
+
+    memset(Head, 0xFF, sizeof *Head << DEFLATE_HASH_BITS);
+    size_t i = 0;
+    while (i + DEFLATE_MIN_MATCH <= Size)
+    {
+        u32 Key = Load32(In + i);
+        u32 Hash = (Key * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+        i32 Candidate = Head[Hash];
+        Head[Hash] = (i32)i;
+        if (Candidate >= 0 && i - Candidate <= DEFLATE_WINDOW_SIZE && Load32(In + Candidate) == Key)
+        {
+            int Max = (int)MIN(DEFLATE_MAX_MATCH, Size - i);
+            int Length = DEFLATE_MIN_MATCH + GetMatchLength(
+                Mode,
+                In + Candidate + DEFLATE_MIN_MATCH,
+                In + i + DEFLATE_MIN_MATCH,
+                Max - DEFLATE_MIN_MATCH
+            );
+            PutMatch(&Writer, Length, (int)(i - Candidate));
+            i += Length;
+        }
+        else
+        {
+            PutLiteral(&Writer, In[i]);
+            i++;
+        }
+    }
+    for (; i < Size; i++)
+        PutLiteral(&Writer, In[i]);
+    PutLiteral(&Writer, 256);
+
+    /* the flush, an empty stored block, so the next piece starts on a byte */
+    PutBits(&Writer, 0, 3);
+    FlushBits(&Writer);
+    memcpy(Writer.Ptr, "\x00\x00\xFF\xFF", 4);
+    return Writer.Ptr + 4;
+}
+
+
+
+Bool8 ImageEncoderSupports(image_file_format FileFormat, pixel_format Format)
+{
+    switch (FileFormat)
+    {
+    case IMAGE_FILE_NETPBM: return true;
+    case IMAGE_FILE_PNG: return PIXEL_FORMAT_RGB565 != Format;
+    case IMAGE_FILE_QOI: return PIXEL_FORMAT_RGB32 == Format;
+    default: return false;
+    }
+}
+
+/* row y of the band the way the png has it */
+static void GetPngRow(const image_encoder *Encoder, int y, u8 *Row)
+{
+    const pixel_buffer *Band = Encoder->Band;
+    const u8 *Pixels = (const u8*)Band->Ptr + y*Band->Stride;
+    switch (Band->Format)
+    {
+    case PIXEL_FORMAT_RGB32:
+    {
+        PackPixels(Encoder->Engine->Mode, PIXEL_FORMAT_RGB24, Row, (const u32*)Pixels, NULL, Band->Width);
+    } break;
+
+    case PIXEL_FORMAT_COUNT16:
+    {
+        /* 16 bit png is big endian */
+        const u16 *Counts = (const u16*)Pixels;
+        for (int x = 0; x < Band->Width; x++)
+        {
+            Row[2*x + 0] = (u8)(Counts[x] >> 8);
+            Row[2*x + 1] = (u8)Counts[x];
+        }
+    } break;
+
+    default:
+    {
+        memcpy(Row, Pixels, Encoder->RowSize);
+    } break;
+    }
+}
+
+static void EncodePngPieceFn(void *UserData, int Index)
+{
+    image_encoder *Encoder = UserData;
+    image_encoder_piece *Piece = &Encoder->Pieces[Index];
+    int Mode = Encoder->Engine->Mode;
+    int FirstRow = Index * Encoder->PieceHeight;
+    int RowCount = MIN(Encoder->PieceHeight, Encoder->Band->Height - FirstRow);
+
+    u8 *Prior = Piece->Rows;
+    u8 *Row = Piece->Rows + Encoder->RowSize;
+    if (FirstRow > 0)
+        GetPngRow(Encoder, FirstRow - 1, Prior);
+    else memcpy(Prior, Encoder->PriorRow, Encoder->RowSize);
+    for (int y = 0; y < RowCount; y++)
+    {
+        GetPngRow(Encoder, FirstRow + y, Row);
+        FilterPngRow(Mode, Piece->Filtered + y*(Encoder->RowSize + 1), Row, Prior, Encoder->RowSize, Encoder->PixelSize);
+        u8 *Swap = Prior;
+        Prior = Row;
+        Row = Swap;
+    }
+    Piece->FilteredSize = (size_t)RowCount * (Encoder->RowSize + 1);
+    Piece->Adler = Adler32(1, Piece->Filtered, Piece->FilteredSize);
+
+    /* an IDAT chunk: size, type, the deflated rows, crc of the type and the rows */
+    u8 *Deflated = Piece->Data + 8;
+    u8 *End = Encoder->Stored
+        ? DeflateStored(Deflated, Piece->Filtered, Piece->FilteredSize)
+        : DeflateFixed(Mode, Deflated, Piece->Filtered, Piece->FilteredSize, Piece->Head);
+    u32 Size = (u32)(End - Deflated);
+    StoreBigEndian32(Piece->Data, Size);
+    memcpy(Piece->Data + 4, "IDAT", 4);
+    StoreBigEndian32(End, Crc32(0, Piece->Data + 4, Size + 4));
+    Piece->Size = Size + 12;
+}
+
+static void EncodeQoiPieceFn(void *UserData, int Index)
+{
+    image_encoder *Encoder = UserData;
+    image_encoder_piece *Piece = &Encoder->Pieces[Index];
+    const pixel_buffer *Band = Encoder->Band;
+    int Mode = Encoder->Engine->Mode;
+    int FirstRow = Index * Encoder->PieceHeight;
+    int RowCount = MIN(Encoder->PieceHeight, Band->Height - FirstRow);
+
+    /* colors with the alpha byte, an empty entry has none so it never matches */
+    u32 Seen[64] = { 0 };
+    u32 Previous = 0;
+    Bool8 HasPrevious = false;
+    int Run = 0;
+    u8 *Out = Piece->Data;
+    for (int y = FirstRow; y < FirstRow + RowCount; y++)
+    {
+        const u32 *Pixels = (const u32*)((const u8*)Band->Ptr + y*Band->Stride);
+        for (int x = 0; x < Band->Width; )
+        {
+            u32 Pixel = Pixels[x] | 0xFF000000;
+            if (HasPrevious && Pixel == Previous)
+            {
+                int Length = CountEqualPixels(Mode, Pixels + x, Band->Width - x, Previous & 0xFFFFFF);
+                x += Length;
+                for (Run += Length; Run >= 62; Run -= 62)
+                    *Out++ = 0xC0 | 61;
+                continue;
+            }
+            if (Run)
+            {
+                *Out++ = (u8)(0xC0 | (Run - 1));
+                Run = 0;
+            }
+
+            int R = (Pixel >> 16) & 0xFF, G = (Pixel >> 8) & 0xFF, B = Pixel & 0xFF;
+            int Hash = (R*3 + G*5 + B*7 + 255*11) % 64;
+            if (Seen[Hash] == Pixel)
+            {
+                *Out++ = (u8)Hash;
+            }
+            else
+            {
+                Seen[Hash] = Pixel;
+                int Dr = (i8)(R - ((Previous >> 16) & 0xFF));
+                int Dg = (i8)(G - ((Previous >> 8) & 0xFF));
+                int Db = (i8)(B - (Previous & 0xFF));
+                if (HasPrevious && Dr >= -2 && Dr <= 1 && Dg >= -2 && Dg <= 1 && Db >= -2 && Db <= 1)
+                {
+                    *Out++ = (u8)(0x40 | (Dr + 2) << 4 | (Dg + 2) << 2 | (Db + 2));
+                }
+                else if (HasPrevious && Dg >= -32 && Dg <= 31
+                && Dr - Dg >= -8 && Dr - Dg <= 7 && Db - Dg >= -8 && Db - Dg <= 7)
+                {
+                    *Out++ = (u8)(0x80 | (Dg + 32));
+                    *Out++ = (u8)((Dr - Dg + 8) << 4 | (Db - Dg + 8));
+                }
+                else
+                {
+                    Out[0] = 0xFE;
+                    Out[1] = (u8)R;
+                    Out[2] = (u8)G;
+                    Out[3] = (u8)B;
+                    Out += 4;
+                }
+            }
+            Previous = Pixel;
+            HasPrevious = true;
+            x++;
+        }
+    }
+    if (Run)
+        *Out++ = (u8)(0xC0 | (Run - 1));
+    Piece->Size = (size_t)(Out - Piece->Data);
+}
+
+/* enough pieces for a band Height rows high */
+static Bool8 ImageEncoderReserve(image_encoder *Encoder, int Height)
+{
+    int PieceCount = (Height + Encoder->PieceHeight - 1) / Encoder->PieceHeight;
+    if (PieceCount <= Encoder->PieceCount)
+        return true;
+
+    image_encoder_piece *Pieces = realloc(Encoder->Pieces, PieceCount * sizeof *Pieces);
+    if (NULL == Pieces)
+        return false;
+    Encoder->Pieces = Pieces;
+
+    size_t RowsSize = (size_t)Encoder->PieceHeight * Encoder->RowSize;
+    for (; Encoder->PieceCount < PieceCount; Encoder->PieceCount++)
+    {
+        image_encoder_piece *Piece = &Pieces[Encoder->PieceCount];
+        memset(Piece, 0, sizeof *Piece);
+        if (IMAGE_FILE_QOI == Encoder->FileFormat)
+        {
+            /* a full color is 4 bytes for a 4 byte pixel */
+            Piece->Data = malloc(RowsSize);
+            if (NULL == Piece->Data)
+                return false;
+            continue;
+        }
+
+        size_t FilteredSize = RowsSize + Encoder->PieceHeight;
+        Piece->Data = malloc(12 + DeflateBound(FilteredSize));
+        Piece->Rows = malloc(2 * (size_t)Encoder->RowSize);
+        Piece->Filtered = malloc(FilteredSize);
+        Piece->Head = Encoder->Stored? NULL : malloc(sizeof *Piece->Head << DEFLATE_HASH_BITS);
+        if (NULL == Piece->Data || NULL == Piece->Rows || NULL == Piece->Filtered
+        || (!Encoder->Stored && NULL == Piece->Head))
+        {
+            Encoder->PieceCount++;
+            return false;
+        }
+    }
+    return true;
+}
+
+static Bool8 WritePngChunk(FILE *File, const char *Type, const u8 *Data, u32 Size)
+{
+    u8 Header[8];
+    StoreBigEndian32(Header, Size);
+    memcpy(Header + 4, Type, 4);
+    u8 Crc[4];
+    StoreBigEndian32(Crc, Crc32(Crc32(0, Header + 4, 4), Data, Size));
+    return fwrite(Header, 1, 8, File) == 8
+        && fwrite(Data, 1, Size, File) == Size
+        && fwrite(Crc, 1, 4, File) == 4;
+}
+
+Bool8 ImageEncoderInit(
+    image_encoder *Encoder,
+    const render_engine *Engine,
+    FILE *File,
+    image_file_format FileFormat,
+    pixel_format Format,
+    int Width, int Height,
+    Bool8 Stored
+)
+{
+    pthread_once(&EncoderTablesOnce, EncoderInitTables);
+    memset(Encoder, 0, sizeof *Encoder);
+    Encoder->Engine = Engine;
+    Encoder->File = File;
+    Encoder->FileFormat = FileFormat;
+    Encoder->Format = Format;
+    Encoder->Width = Width;
+    Encoder->Height = Height;
+    Encoder->Stored = Stored;
+    Encoder->Adler = 1;
+
+    /* png has rgb32 as rgb bytes */
+    Encoder->PixelSize = PIXEL_FORMAT_RGB32 == Format && IMAGE_FILE_PNG == FileFormat
+        ? 3
+        : GetPixelFormatSize(Format);
+    Encoder->RowSize = Width * Encoder->PixelSize;
+    Encoder->PieceHeight = MAX(1, IMAGE_ENCODER_PIECE_SIZE / Encoder->RowSize);
+
+    if (IMAGE_FILE_QOI == FileFormat)
+    {
+        /* rgb, srgb */
+        u8 Header[14] = { 'q', 'o', 'i', 'f' };
+        StoreBigEndian32(Header + 4, Width);
+        StoreBigEndian32(Header + 8, Height);
+        Header[12] = 3;
+        Header[13] = 0;
+        return fwrite(Header, 1, sizeof Header, File) == sizeof Header;
+    }
+
+    Encoder->PriorRow = calloc(Encoder->RowSize, 1);
+    if (NULL == Encoder->PriorRow)
+        return false;
+
+    /* 8 bit rgb, 8 bit palette indices or 16 bit gray */
+    u8 Header[13];
+    StoreBigEndian32(Header + 0, Width);
+    StoreBigEndian32(Header + 4, Height);
+    Header[8] = PIXEL_FORMAT_COUNT16 == Format? 16 : 8;
+    Header[9] = PIXEL_FORMAT_INDEX8 == Format? 3 : PIXEL_FORMAT_COUNT16 == Format? 0 : 2;
+    Header[10] = Header[11] = Header[12] = 0;
+    if (fwrite("\x89PNG\r\n\x1A\n", 1, 8, File) != 8 || !WritePngChunk(File, "IHDR", Header, sizeof Header))
+        return false;
+
+    if (PIXEL_FORMAT_INDEX8 == Format)
+    {
+        /* the indices past the palette are black, like PIXEL_INDEX_INSIDE */
+        u8 Palette[3 * 256] = { 0 };
+        for (int i = 0; i < 16; i++)
+        {
+            Palette[3*i + 0] = (u8)(Engine->Palette[i] >> 16);
+            Palette[3*i + 1] = (u8)(Engine->Palette[i] >> 8);
+            Palette[3*i + 2] = (u8)Engine->Palette[i];
+        }
+        if (!WritePngChunk(File, "PLTE", Palette, sizeof Palette))
+            return false;
+    }
+
+    /* the zlib header, deflate with a 32k window, no dictionary */
+    return WritePngChunk(File, "IDAT", (const u8*)"\x78\x01", 2);
+}
+
+Bool8 ImageEncoderWriteBand(image_encoder *Encoder, const pixel_buffer *Band)
+{
+    if (!ImageEncoderReserve(Encoder, Band->Height))
+        return false;
+
+    Encoder->Band = Band;
+    int PieceCount = (Band->Height + Encoder->PieceHeight - 1) / Encoder->PieceHeight;
+    EngineParallelFor(
+        Encoder->Engine, PieceCount,
+        IMAGE_FILE_QOI == Encoder->FileFormat? EncodeQoiPieceFn : EncodePngPieceFn,
+        Encoder
+    );
+
+    for (int i = 0; i < PieceCount; i++)
+    {
+        image_encoder_piece *Piece = &Encoder->Pieces[i];
+        if (fwrite(Piece->Data, 1, Piece->Size, Encoder->File) != Piece->Size)
+            return false;
+        if (IMAGE_FILE_PNG == Encoder->FileFormat)
+            Encoder->Adler = Adler32Combine(Encoder->Adler, Piece->Adler, Piece->FilteredSize);
+    }
+    if (IMAGE_FILE_PNG == Encoder->FileFormat)
+        GetPngRow(Encoder, Band->Height - 1, Encoder->PriorRow);
+    Encoder->Band = NULL;
+    return true;
+}
+
+Bool8 ImageEncoderFinish(image_encoder *Encoder)
+{
+    if (IMAGE_FILE_QOI == Encoder->FileFormat)
+        return fwrite("\0\0\0\0\0\0\0\1", 1, 8, Encoder->File) == 8;
+
+    /* the last block (empty and stored), then the checksum of the rows */
+    u8 End[9] = { 0x01, 0x00, 0x00, 0xFF, 0xFF };
+    StoreBigEndian32(End + 5, Encoder->Adler);
+    return WritePngChunk(Encoder->File, "IDAT", End, sizeof End)
+        && WritePngChunk(Encoder->File, "IEND", NULL, 0);
+}
+
+void ImageEncoderFree(image_encoder *Encoder)
+{
+    for (int i = 0; i < Encoder->PieceCount; i++)
+    {
+        free(Encoder->Pieces[i].Data);
+        free(Encoder->Pieces[i].Rows);
+        free(Encoder->Pieces[i].Filtered);
+        free(Encoder->Pieces[i].Head);
+    }
+    free(Encoder->Pieces);
+    free(Encoder->PriorRow);
+    Encoder->Pieces = NULL;
+    Encoder->PriorRow = NULL;
+    Encoder->PieceCount = 0;
+}
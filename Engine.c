@@ -0,0 +1,1123 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include "Common.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <time.h>
+#  include <unistd.h>
+#endif /* _WIN32 */
+
+/*
+ * Render engine:
+ * everything between a front-end and the kernels, splitting a buffer into strips or tiles,
+ * handing them out to threads and the multi pass methods (progressive, pan, supersampling, tile cache).
+ * Only the threads, the atomics and the clock below are platform specific.
+ */
+
+typedef struct parallel_for
+{
+    parallel_for_fn Fn;
+    void *UserData;
+    int Count;
+    volatile long Next;
+
+    /* on a pool, the pool threads that are in the loop, and the loop after it */
+    int Workers;
+    struct parallel_for *NextLoop;
+} parallel_for;
+
+#ifdef _WIN32
+
+typedef SRWLOCK engine_lock;
+typedef CONDITION_VARIABLE engine_signal;
+typedef HANDLE engine_thread;
+
+static long EngineAtomicAdd(volatile long *Value, long Addend)
+{
+    return InterlockedExchangeAdd(Value, Addend);
+}
+
+static void EngineLockInit(engine_lock *Lock) { InitializeSRWLock(Lock); }
+static void EngineLockFree(engine_lock *Lock) { (void)Lock; }
+static void EngineLock(engine_lock *Lock) { AcquireSRWLockExclusive(Lock); }
+static void EngineUnlock(engine_lock *Lock) { ReleaseSRWLockExclusive(Lock); }
+static void EngineSignalInit(engine_signal *Signal) { InitializeConditionVariable(Signal); }
+static void EngineSignalFree(engine_signal *Signal) { (void)Signal; }
+static void EngineWait(engine_signal *Signal, engine_lock *Lock) { SleepConditionVariableSRW(Signal, Lock, INFINITE, 0); }
+static void EngineWakeAll(engine_signal *Signal) { WakeAllConditionVariable(Signal); }
+
+static DWORD ParallelForThread(LPVOID UserData);
+
+static void ParallelForSpawn(parallel_for *Loop, int ThreadCount)
+{
+    HANDLE Threads[ENGINE_MAX_THREAD_COUNT] = { 0 };
+    for (int i = 0; i < ThreadCount; i++)
+    {
+        DWORD ID;
+        Threads[i] = CreateThread(NULL, 0, ParallelForThread, Loop, 0, &ID);
+    }
+    for (int i = 0; i < ThreadCount; i++)
+    {
+        /* a thread that couldn't be made leaves its share to the others */
+        if (NULL == Threads[i])
+            continue;
+        WaitForSingleObject(Threads[i], INFINITE);
+        CloseHandle(Threads[i]);
+    }
+}
+
+double GetTimeMillisec(void)
+{
+    static double MillisecPerCount = 0;
+    LARGE_INTEGER Li;
+    if (0 == MillisecPerCount)
+    {
+        QueryPerformanceFrequency(&Li);
+        MillisecPerCount = 1000.0 / (double)Li.QuadPart;
+    }
+    QueryPerformanceCounter(&Li);
+    return (double)Li.QuadPart * MillisecPerCount;
+}
+
+int GetProcessorCount(void)
+{
+    SYSTEM_INFO Info;
+    GetSystemInfo(&Info);
+    return MAX(1, (int)Info.dwNumberOfProcessors);
+}
+
+#else
+
+typedef pthread_mutex_t engine_lock;
+typedef pthread_cond_t engine_signal;
+typedef pthread_t engine_thread;
+
+static long EngineAtomicAdd(volatile long *Value, long Addend)
+{
+    return __atomic_fetch_add(Value, Addend, __ATOMIC_SEQ_CST);
+}
+
+static void EngineLockInit(engine_lock *Lock) { pthread_mutex_init(Lock, NULL); }
+static void EngineLockFree(engine_lock *Lock) { pthread_mutex_destroy(Lock); }
+static void EngineLock(engine_lock *Lock) { pthread_mutex_lock(Lock); }
+static void EngineUnlock(engine_lock *Lock) { pthread_mutex_unlock(Lock); }
+static void EngineSignalInit(engine_signal *Signal) { pthread_cond_init(Signal, NULL); }
+static void EngineSignalFree(engine_signal *Signal) { pthread_cond_destroy(Signal); }
+static void EngineWait(engine_signal *Signal, engine_lock *Lock) { pthread_cond_wait(Signal, Lock); }
+static void EngineWakeAll(engine_signal *Signal) { pthread_cond_broadcast(Signal); }
+
+static void *ParallelForThread(void *UserData);
+
+static void ParallelForSpawn(parallel_for *Loop, int ThreadCount)
+{
+    pthread_t Threads[ENGINE_MAX_THREAD_COUNT];
+    Bool8 Created[ENGINE_MAX_THREAD_COUNT] = { 0 };
+    for (int i = 0; i < ThreadCount; i++)
+    {
+        Created[i] = 0 == pthread_create(&Threads[i], NULL, ParallelForThread, Loop);
+    }
+    for (int i = 0; i < ThreadCount; i++)
+    {
+        /* a thread that couldn't be made leaves its share to the others */
+        if (Created[i])
+            pthread_join(Threads[i], NULL);
+    }
+}
+
+double GetTimeMillisec(void)
+{
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return Time.tv_sec * 1000.0 + Time.tv_nsec / 1000000.0;
+}
+
+int GetProcessorCount(void)
+{
+    long Count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (int)MIN(MAX(Count, 1), ENGINE_MAX_THREAD_COUNT);
+}
+
+#endif /* _WIN32 */
+
+static void ParallelForRun(parallel_for *Loop)
+{
+    long Index;
+    while ((Index = EngineAtomicAdd(&Loop->Next, 1)) < Loop->Count)
+    {
+        Loop->Fn(Loop->UserData, Index);
+    }
+}
+
+static void EnginePoolWork(engine_pool *Pool);
+
+#ifdef _WIN32
+static DWORD ParallelForThread(LPVOID UserData)
+{
+    ParallelForRun(UserData);
+    return 0;
+}
+
+static DWORD EnginePoolThread(LPVOID UserData)
+{
+    EnginePoolWork(UserData);
+    return 0;
+}
+
+static Bool8 EngineStartThread(engine_thread *Thread, engine_pool *Pool)
+{
+    DWORD ID;
+    *Thread = CreateThread(NULL, 0, EnginePoolThread, Pool, 0, &ID);
+    return NULL != *Thread;
+}
+
+static void EngineJoinThread(engine_thread Thread)
+{
+    WaitForSingleObject(Thread, INFINITE);
+    CloseHandle(Thread);
+}
+#else
+static void *ParallelForThread(void *UserData)
+{
+    ParallelForRun(UserData);
+    return NULL;
+}
+
+static void *EnginePoolThread(void *UserData)
+{
+    EnginePoolWork(UserData);
+    return NULL;
+}
+
+static Bool8 EngineStartThread(engine_thread *Thread, engine_pool *Pool)
+{
+    return 0 == pthread_create(Thread, NULL, EnginePoolThread, Pool);
+}
+
+static void EngineJoinThread(engine_thread Thread)
+{
+    pthread_join(Thread, NULL);
+}
+#endif /* _WIN32 */
+
+void ParallelFor(int ThreadCount, int Count, parallel_for_fn Fn, void *UserData)
+{
+    parallel_for Loop = {
+        .Fn = Fn,
+        .UserData = UserData,
+        .Count = Count,
+    };
+
+    ThreadCount = MIN(ThreadCount, ENGINE_MAX_THREAD_COUNT);
+    ThreadCount = MAX(1, MIN(ThreadCount, Count));
+    if (1 == ThreadCount)
+    {
+        ParallelForRun(&Loop);
+        return;
+    }
+    ParallelForSpawn(&Loop, ThreadCount);
+
+    /* every index is taken even if no thread could be made */
+    ParallelForRun(&Loop);
+}
+
+
+
+/*
+ * Thread pool:
+ * ParallelFor makes its threads for every loop, fine for a front-end that renders a frame at a time, 
+ * but a process that renders lots of small views would spend its time making threads, a pool keeps them around.
+ * Any number of threads can run loops on the same pool at once, the pool threads take indices from 
+ * whichever loop has some left, and the thread that runs a loop works on it too, 
+ * so a loop gets done even when every pool thread is busy with the others.
+ */
+
+struct engine_pool
+{
+    engine_lock Lock;
+    engine_signal WorkReady;
+    engine_signal LoopDone;
+    parallel_for *Loops;
+    Bool8 Quit;
+    int ThreadCount;
+    engine_thread Threads[ENGINE_MAX_THREAD_COUNT];
+};
+
+static void EnginePoolWork(engine_pool *Pool)
+{
+    EngineLock(&Pool->Lock);
+    while (!Pool->Quit)
+    {
+        parallel_for *Loop = Pool->Loops;
+        while (Loop && Loop->Next >= Loop->Count)
+            Loop = Loop->NextLoop;
+        if (NULL == Loop)
+        {
+            EngineWait(&Pool->WorkReady, &Pool->Lock);
+            continue;
+        }
+
+        /* the loop can't go away while a pool thread is in it */
+        Loop->Workers++;
+        EngineUnlock(&Pool->Lock);
+        ParallelForRun(Loop);
+        EngineLock(&Pool->Lock);
+        if (0 == --Loop->Workers)
+            EngineWakeAll(&Pool->LoopDone);
+    }
+    EngineUnlock(&Pool->Lock);
+}
+
+engine_pool *EngineCreatePool(int ThreadCount)
+{
+    engine_pool *Pool = calloc(1, sizeof *Pool);
+    if (NULL == Pool)
+        return NULL;
+    EngineLockInit(&Pool->Lock);
+    EngineSignalInit(&Pool->WorkReady);
+    EngineSignalInit(&Pool->LoopDone);
+
+    /* the thread that runs a loop is one of them */
+    ThreadCount = MIN(MAX(ThreadCount, 1), ENGINE_MAX_THREAD_COUNT);
+    for (int i = 0; i < ThreadCount - 1; i++)
+    {
+        if (!EngineStartThread(&Pool->Threads[Pool->ThreadCount], Pool))
+            break;
+        Pool->ThreadCount++;
+    }
+    return Pool;
+}
+
+void EngineDestroyPool(engine_pool *Pool)
+{
+    if (NULL == Pool)
+        return;
+    EngineLock(&Pool->Lock);
+    Pool->Quit = true;
+    EngineWakeAll(&Pool->WorkReady);
+    EngineUnlock(&Pool->Lock);
+    for (int i = 0; i < Pool->ThreadCount; i++)
+        EngineJoinThread(Pool->Threads[i]);
+
+    EngineSignalFree(&Pool->LoopDone);
+    EngineSignalFree(&Pool->WorkReady);
+    EngineLockFree(&Pool->Lock);
+    free(Pool);
+}
+
+int EngineGetPoolThreadCount(const engine_pool *Pool)
+{
+    return Pool->ThreadCount + 1;
+}
+
+void EnginePoolFor(engine_pool *Pool, int Count, parallel_for_fn Fn, void *UserData)
+{
+    parallel_for Loop = {
+        .Fn = Fn,
+        .UserData = UserData,
+        .Count = Count,
+    };
+    if (Count > 1 && Pool->ThreadCount > 0)
+    {
+        EngineLock(&Pool->Lock);
+        Loop.NextLoop = Pool->Loops;
+        Pool->Loops = &Loop;
+        EngineWakeAll(&Pool->WorkReady);
+        EngineUnlock(&Pool->Lock);
+    }
+    ParallelForRun(&Loop);
+    if (Count <= 1 || 0 == Pool->ThreadCount)
+        return;
+
+    /* out of the list so no other pool thread starts on it, then wait for the ones that did */
+    EngineLock(&Pool->Lock);
+    parallel_for **Link = &Pool->Loops;
+    while (*Link != &Loop)
+        Link = &(*Link)->NextLoop;
+    *Link = Loop.NextLoop;
+    while (Loop.Workers > 0)
+        EngineWait(&Pool->LoopDone, &Pool->Lock);
+    EngineUnlock(&Pool->Lock);
+}
+
+void EngineParallelFor(const render_engine *Engine, int Count, parallel_for_fn Fn, void *UserData)
+{
+    if (Engine->Pool)
+        EnginePoolFor(Engine->Pool, Count, Fn, UserData);
+    else ParallelFor(Engine->ThreadCount, Count, Fn, UserData);
+}
+
+
+
+int GetBestMode(void)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return 9;
+    if (__builtin_cpu_supports("avx2"))
+        return 7;
+#endif
+    /* sse2 is always there on x64 */
+    return 3;
+}
+
+Bool8 CanRunMode(int Mode)
+{
+    int BestMode = GetBestMode();
+    if (Mode < 0 || Mode > MODE_MAX)
+        return false;
+    if (Mode >= 8)
+        return BestMode >= 9;
+    if (Mode >= 6)
+        return BestMode >= 7;
+    return true;
+}
+
+const char *GetModeName(int Mode)
+{
+    switch (Mode)
+    {
+    default:
+    case 0: return "regular f32x1";
+    case 1: return "regular f64x1";
+    case 2: return "sse f32x4";
+    case 3: return "sse f64x2";
+    case 4: return "sse f32x4 (with fma)";
+    case 5: return "sse f64x2 (with fma)";
+    case 6: return "avx f32x8";
+    case 7: return "avx f64x4";
+    case 8: return "avx f32x8 (with fma)";
+    case 9: return "avx f64x4 (with fma)";
+    }
+}
+
+const char *GetRenderMethodName(render_method Method)
+{
+    switch (Method)
+    {
+    default:
+    case RENDER_METHOD_FULL: return "full";
+    case RENDER_METHOD_SUBDIVIDE: return "subdivide";
+    case RENDER_METHOD_BOUNDARY_TRACE: return "boundary trace";
+    case RENDER_METHOD_RESUMABLE: return "resumable";
+    case RENDER_METHOD_ANYTIME: return "anytime";
+    }
+}
+
+render_engine MakeRenderEngine(void)
+{
+    render_engine Engine = {
+        .ThreadCount = GetProcessorCount(),
+        .Mode = GetBestMode(),
+        .Method = RENDER_METHOD_FULL,
+        .IterationCount = 400,
+        .MaxValue = 4.0,
+    };
+    GetDefaultPalette(Engine.Palette);
+    return Engine;
+}
+
+color_buffer MakeColorBuffer(const render_engine *Engine, u32 *Ptr, int Width, int Height, int Stride)
+{
+    color_buffer Buffer = {
+        .Ptr = Ptr,
+        .Width = Width,
+        .Height = Height,
+        .Stride = Stride,
+    };
+    memcpy(Buffer.Palette, Engine->Palette, sizeof Buffer.Palette);
+    return Buffer;
+}
+
+coordmap MakeCenteredMap(double CenterX, double CenterY, double Height, int BufferWidth, int BufferHeight)
+{
+    double Delta = Height / BufferHeight;
+    coordmap Map = {
+        .Left = -(CenterX - 0.5*BufferWidth*Delta),
+        .Top = CenterY + 0.5*Height,
+        .Width = BufferWidth * Delta,
+        .Height = Height,
+        .Delta = Delta,
+    };
+    return Map;
+}
+
+
+
+typedef struct engine_strips
+{
+    const render_engine *Engine;
+    const color_buffer *Buffer;
+    const coordmap *Map;
+    int StripHeight;
+} engine_strips;
+
+static void EngineRenderStripFn(void *UserData, int Index)
+{
+    engine_strips *Strips = UserData;
+    int Row = Index * Strips->StripHeight;
+    int Height = MIN(Strips->StripHeight, Strips->Buffer->Height - Row);
+
+    /* a streaming strip is still rendered ENGINE_STRIP_HEIGHT rows at a time, so it comes out like the others */
+    color_buffer Strip;
+    coordmap StripMap;
+    for (int y = 0; y < Height; y += ENGINE_STRIP_HEIGHT)
+    {
+        GetSubRect(Strips->Buffer, Strips->Map, 0, Row + y, Strips->Buffer->Width, MIN(ENGINE_STRIP_HEIGHT, Height - y), &Strip, &StripMap);
+        RenderMandelbrotSet(
+            Strips->Engine->Mode,
+            &Strip, &StripMap,
+            Strips->Engine->IterationCount,
+            Strips->Engine->MaxValue
+        );
+    }
+    if (Strips->Engine->TileDone)
+    {
+        GetSubRect(Strips->Buffer, Strips->Map, 0, Row, Strips->Buffer->Width, Height, &Strip, &StripMap);
+        Strips->Engine->TileDone(Strips->Engine->TileDoneUserData, &Strip);
+    }
+}
+
+void EngineRenderStrips(const render_engine *Engine, const color_buffer *Buffer, const coordmap *Map)
+{
+    engine_strips Strips = {
+        .Engine = Engine,
+        .Buffer = Buffer,
+        .Map = Map,
+        .StripHeight = Engine->TileDone? ENGINE_STREAM_STRIP_HEIGHT : ENGINE_STRIP_HEIGHT,
+    };
+    int StripCount = (Buffer->Height + Strips.StripHeight - 1) / Strips.StripHeight;
+    EngineParallelFor(Engine, StripCount, EngineRenderStripFn, &Strips);
+}
+
+typedef struct engine_tiles
+{
+    const render_engine *Engine;
+    tile_job *Job;
+} engine_tiles;
+
+static void EngineRenderTileFn(void *UserData, int Index)
+{
+    engine_tiles *Tiles = UserData;
+    RenderTile(Tiles->Job, Index);
+    if (Tiles->Engine->TileDone)
+    {
+        /* the same rectangle that RenderTile took */
+        color_buffer Tile;
+        coordmap TileMap;
+        int x = (Index % Tiles->Job->TileCountX) * TILE_SIZE;
+        int y = (Index / Tiles->Job->TileCountX) * TILE_SIZE;
+        GetSubRect(
+            &Tiles->Job->ColorBuffer, &Tiles->Job->Map, 
+            x, y, 
+            MIN(TILE_SIZE, Tiles->Job->ColorBuffer.Width - x), 
+            MIN(TILE_SIZE, Tiles->Job->ColorBuffer.Height - y), 
+            &Tile, &TileMap
+        );
+        Tiles->Engine->TileDone(Tiles->Engine->TileDoneUserData, &Tile);
+    }
+}
+
+void EngineRenderTiles(const render_engine *Engine, tile_job *Job)
+{
+    engine_tiles Tiles = {
+        .Engine = Engine,
+        .Job = Job,
+    };
+    EngineParallelFor(Engine, Job->TileCount, EngineRenderTileFn, &Tiles);
+}
+
+void EngineRenderBuffer(const render_engine *Engine, const color_buffer *Buffer, const coordmap *Map)
+{
+    /* the resumable method needs the iteration state that belongs to the whole buffer,
+     * a part of it or a different buffer is rendered from scratch, 
+     * and only the full method writes counts */
+    if (RENDER_METHOD_FULL == Engine->Method
+    || Buffer->Counts
+    || RENDER_METHOD_RESUMABLE == Engine->Method
+    || RENDER_METHOD_ANYTIME == Engine->Method)
+    {
+        EngineRenderStrips(Engine, Buffer, Map);
+    }
+    else
+    {
+        tile_job Job = MakeTileJob(Engine->Method, Engine->Mode, Buffer, Map, Engine->IterationCount, Engine->MaxValue);
+        EngineRenderTiles(Engine, &Job);
+    }
+}
+
+typedef struct engine_views
+{
+    const render_engine *Engine;
+    const engine_view *Views;
+    tile_job *Jobs;
+    int *FirstTiles;    /* of every view, and the tile count after the last one */
+    int ViewCount;
+} engine_views;
+
+static void EngineRenderViewTileFn(void *UserData, int Index)
+{
+    engine_views *Batch = UserData;
+
+    /* the last view that starts at or before the tile */
+    int Low = 0, High = Batch->ViewCount - 1;
+    while (Low < High)
+    {
+        int Mid = (Low + High + 1) / 2;
+        if (Batch->FirstTiles[Mid] <= Index)
+            Low = Mid;
+        else High = Mid - 1;
+    }
+    engine_tiles Tiles = {
+        .Engine = Batch->Engine,
+        .Job = &Batch->Jobs[Low],
+    };
+    EngineRenderTileFn(&Tiles, Index - Batch->FirstTiles[Low]);
+}
+
+static void EngineSupersampleViewFn(void *UserData, int Index)
+{
+    engine_views *Batch = UserData;
+    const engine_view *View = &Batch->Views[Index];
+    if (NULL == View->Edges)
+        return;
+
+    /* the views are spread over the threads already */
+    render_engine Engine = *Batch->Engine;
+    Engine.IterationCount = View->IterationCount;
+    Engine.ThreadCount = 1;
+    Engine.Pool = NULL;
+    color_buffer Buffer = View->Buffer;
+    EngineSupersampleEdges(&Engine, &Buffer, &View->Map, View->Edges);
+}
+
+Bool8 EngineRenderViews(const render_engine *Engine, const engine_view *Views, int ViewCount)
+{
+    if (ViewCount <= 0)
+        return true;
+    tile_job *Jobs = malloc(ViewCount * sizeof *Jobs);
+    int *FirstTiles = malloc((ViewCount + 1) * sizeof *FirstTiles);
+    if (NULL == Jobs || NULL == FirstTiles)
+    {
+        free(Jobs);
+        free(FirstTiles);
+        return false;
+    }
+
+    /* with nothing to resume from, the resumable methods render every pixel like the full one, 
+     * without needing any iteration state */
+    render_method Method = Engine->Method;
+    if (RENDER_METHOD_RESUMABLE == Method || RENDER_METHOD_ANYTIME == Method)
+        Method = RENDER_METHOD_FULL;
+
+    int TileCount = 0;
+    Bool8 Supersample = false;
+    for (int i = 0; i < ViewCount; i++)
+    {
+        const engine_view *View = &Views[i];
+        Jobs[i] = MakeTileJob(
+            View->Buffer.Counts? RENDER_METHOD_FULL : Method, Engine->Mode, 
+            &View->Buffer, &View->Map, 
+            View->IterationCount, Engine->MaxValue
+        );
+        FirstTiles[i] = TileCount;
+        TileCount += Jobs[i].TileCount;
+        Supersample |= NULL != View->Edges;
+    }
+    FirstTiles[ViewCount] = TileCount;
+
+    engine_views Batch = {
+        .Engine = Engine,
+        .Views = Views,
+        .Jobs = Jobs,
+        .FirstTiles = FirstTiles,
+        .ViewCount = ViewCount,
+    };
+    EngineParallelFor(Engine, TileCount, EngineRenderViewTileFn, &Batch);
+    if (Supersample)
+        EngineParallelFor(Engine, ViewCount, EngineSupersampleViewFn, &Batch);
+
+    free(Jobs);
+    free(FirstTiles);
+    return true;
+}
+
+void EngineRenderProgressivePass(
+    const render_engine *Engine,
+    color_buffer *Buffer,
+    const coordmap *Map,
+    int Spacing,
+    u32 *Samples
+)
+{
+    progressive_subgrid Subgrids[3];
+    int SubgridCount = GetProgressiveSubgrids(Spacing, Subgrids);
+    for (int i = 0; i < SubgridCount; i++)
+    {
+        color_buffer SampleBuffer = MakeColorBuffer(Engine, Samples, 0, 0, 0);
+        GetProgressiveSubgridSize(Subgrids[i],
+            Buffer->Width, Buffer->Height,
+            &SampleBuffer.Width, &SampleBuffer.Height
+        );
+        if (0 == SampleBuffer.Width || 0 == SampleBuffer.Height)
+            continue;
+        SampleBuffer.Stride = SampleBuffer.Width;
+
+        /* the samples aren't where they end up yet */
+        render_engine SampleEngine = *Engine;
+        SampleEngine.TileDone = NULL;
+        coordmap SampleMap = GetProgressiveSubgridMap(Subgrids[i], Map);
+        EngineRenderBuffer(&SampleEngine, &SampleBuffer, &SampleMap);
+        ScatterProgressiveSubgrid(Buffer, &SampleBuffer, Subgrids[i], Spacing);
+    }
+}
+
+void EngineRenderPan(
+    const render_engine *Engine,
+    color_buffer *Buffer,
+    const coordmap *Map,
+    int ShiftX, int ShiftY
+)
+{
+    int AbsShiftX = ShiftX < 0? -ShiftX : ShiftX;
+    int AbsShiftY = ShiftY < 0? -ShiftY : ShiftY;
+    if (AbsShiftX >= Buffer->Width || AbsShiftY >= Buffer->Height)
+    {
+        EngineRenderBuffer(Engine, Buffer, Map);
+        return;
+    }
+    ShiftColorBuffer(Buffer, ShiftX, ShiftY);
+
+    color_buffer Strip;
+    coordmap StripMap;
+    if (AbsShiftX)
+    {
+        /* full height column on the left or right */
+        int x = ShiftX > 0? 0 : Buffer->Width - AbsShiftX;
+        GetSubRect(Buffer, Map, x, 0, AbsShiftX, Buffer->Height, &Strip, &StripMap);
+        EngineRenderBuffer(Engine, &Strip, &StripMap);
+    }
+    if (AbsShiftY)
+    {
+        /* the rest of the row on the top or bottom */
+        int x = ShiftX > 0? AbsShiftX : 0;
+        int y = ShiftY > 0? 0 : Buffer->Height - AbsShiftY;
+        GetSubRect(Buffer, Map, x, y, Buffer->Width - AbsShiftX, AbsShiftY, &Strip, &StripMap);
+        EngineRenderBuffer(Engine, &Strip, &StripMap);
+    }
+}
+
+
+
+#define SUPERSAMPLE_BAND_HEIGHT 16
+
+typedef struct engine_supersample
+{
+    const render_engine *Engine;
+    color_buffer *Buffer;
+    const coordmap *Map;
+    u8 *Edges;
+    volatile long EdgeCount;
+} engine_supersample;
+
+static void EngineFindEdgesFn(void *UserData, int Index)
+{
+    engine_supersample *Pass = UserData;
+    int FirstRow = Index * SUPERSAMPLE_BAND_HEIGHT;
+    int RowCount = MIN(SUPERSAMPLE_BAND_HEIGHT, Pass->Buffer->Height - FirstRow);
+    int EdgeCount = FindEdgePixels(Pass->Buffer, Pass->Edges, FirstRow, RowCount, SUPERSAMPLE_THRESHOLD);
+    EngineAtomicAdd(&Pass->EdgeCount, EdgeCount);
+}
+
+static void EngineSupersampleFn(void *UserData, int Index)
+{
+    engine_supersample *Pass = UserData;
+    int FirstRow = Index * SUPERSAMPLE_BAND_HEIGHT;
+    int RowCount = MIN(SUPERSAMPLE_BAND_HEIGHT, Pass->Buffer->Height - FirstRow);
+    SupersampleEdgePixels(
+        Pass->Engine->Mode,
+        Pass->Buffer, Pass->Edges, Pass->Map,
+        Pass->Engine->IterationCount, Pass->Engine->MaxValue,
+        FirstRow, RowCount
+    );
+}
+
+int EngineSupersampleEdges(const render_engine *Engine, color_buffer *Buffer, const coordmap *Map, u8 *Edges)
+{
+    /* all of it has to be marked before any pixel changes,
+     * otherwise a thread could compare against a neighbor that another thread already replaced */
+    engine_supersample Pass = {
+        .Engine = Engine,
+        .Buffer = Buffer,
+        .Map = Map,
+        .Edges = Edges,
+    };
+    int BandCount = (Buffer->Height + SUPERSAMPLE_BAND_HEIGHT - 1) / SUPERSAMPLE_BAND_HEIGHT;
+    EngineParallelFor(Engine, BandCount, EngineFindEdgesFn, &Pass);
+    EngineParallelFor(Engine, BandCount, EngineSupersampleFn, &Pass);
+    return Pass.EdgeCount;
+}
+
+int EngineSupersamplePan(
+    const render_engine *Engine, 
+    color_buffer *Buffer, 
+    const coordmap *Map, 
+    u8 *Edges, 
+    int ShiftX, int ShiftY
+)
+{
+    int AbsShiftX = ShiftX < 0? -ShiftX : ShiftX;
+    int AbsShiftY = ShiftY < 0? -ShiftY : ShiftY;
+    if (AbsShiftX >= Buffer->Width - 1 || AbsShiftY >= Buffer->Height - 1)
+        return EngineSupersampleEdges(Engine, Buffer, Map, Edges);
+
+    /* the strips of EngineRenderPan, grown by a pixel into the old part, 
+     * the pixels along the seam got a new neighbor so they may have become edges */
+    int EdgeCount = 0;
+    color_buffer Strip;
+    coordmap StripMap;
+    if (AbsShiftX)
+    {
+        int x = ShiftX > 0? 0 : Buffer->Width - AbsShiftX - 1;
+        GetSubRect(Buffer, Map, x, 0, AbsShiftX + 1, Buffer->Height, &Strip, &StripMap);
+        EdgeCount += EngineSupersampleEdges(Engine, &Strip, &StripMap, Edges + x);
+    }
+    if (AbsShiftY)
+    {
+        int x = ShiftX > 0? AbsShiftX : 0;
+        int y = ShiftY > 0? 0 : Buffer->Height - AbsShiftY - 1;
+        GetSubRect(Buffer, Map, x, y, Buffer->Width - AbsShiftX, AbsShiftY + 1, &Strip, &StripMap);
+        EdgeCount += EngineSupersampleEdges(Engine, &Strip, &StripMap, Edges + y*Buffer->Stride + x);
+    }
+    return EdgeCount;
+}
+
+
+
+typedef struct engine_recolor
+{
+    const render_engine *Engine;
+    color_buffer *Buffer;
+} engine_recolor;
+
+static void EngineRecolorFn(void *UserData, int Index)
+{
+    engine_recolor *Pass = UserData;
+    int FirstRow = Index * SUPERSAMPLE_BAND_HEIGHT;
+    int RowCount = MIN(SUPERSAMPLE_BAND_HEIGHT, Pass->Buffer->Height - FirstRow);
+    RecolorCounts(Pass->Engine->Mode, Pass->Buffer, FirstRow, RowCount);
+}
+
+void EngineRecolor(const render_engine *Engine, color_buffer *Buffer)
+{
+    engine_recolor Pass = {
+        .Engine = Engine,
+        .Buffer = Buffer,
+    };
+    int BandCount = (Buffer->Height + SUPERSAMPLE_BAND_HEIGHT - 1) / SUPERSAMPLE_BAND_HEIGHT;
+    EngineParallelFor(Engine, BandCount, EngineRecolorFn, &Pass);
+}
+
+
+
+typedef struct engine_zoom_frame
+{
+    const render_engine *Engine;
+    color_buffer *Buffer;
+    const coordmap *Map;
+    const color_buffer *Previous;
+    const coordmap *PreviousMap;
+    u8 *Marks;
+    volatile long MarkCount;
+} engine_zoom_frame;
+
+static void EngineRenderZoomFrameFn(void *UserData, int Index)
+{
+    /* the previous frame is only read, so every band can go on its own */
+    engine_zoom_frame *Pass = UserData;
+    int FirstRow = Index * SUPERSAMPLE_BAND_HEIGHT;
+    int RowCount = MIN(SUPERSAMPLE_BAND_HEIGHT, Pass->Buffer->Height - FirstRow);
+    int MarkCount = ReusePreviousFrame(
+        Pass->Buffer, Pass->Marks, Pass->Map,
+        Pass->Previous, Pass->PreviousMap,
+        FirstRow, RowCount
+    );
+    RenderMarkedPixels(
+        Pass->Engine->Mode,
+        Pass->Buffer, Pass->Marks, Pass->Map,
+        Pass->Engine->IterationCount, Pass->Engine->MaxValue,
+        FirstRow, RowCount
+    );
+    EngineAtomicAdd(&Pass->MarkCount, MarkCount);
+}
+
+int EngineRenderZoomFrame(
+    const render_engine *Engine,
+    color_buffer *Buffer,
+    const coordmap *Map,
+    const color_buffer *Previous,
+    const coordmap *PreviousMap,
+    u8 *Marks
+)
+{
+    engine_zoom_frame Pass = {
+        .Engine = Engine,
+        .Buffer = Buffer,
+        .Map = Map,
+        .Previous = Previous,
+        .PreviousMap = PreviousMap,
+        .Marks = Marks,
+    };
+    int BandCount = (Buffer->Height + SUPERSAMPLE_BAND_HEIGHT - 1) / SUPERSAMPLE_BAND_HEIGHT;
+    EngineParallelFor(Engine, BandCount, EngineRenderZoomFrameFn, &Pass);
+    return Pass.MarkCount;
+}
+
+
+
+typedef struct engine_tile_cache_pass
+{
+    const render_engine *Engine;
+    const tile_grid *Grid;
+    tile_cache_entry **Misses;
+} engine_tile_cache_pass;
+
+static void EngineRenderCacheMissFn(void *UserData, int Index)
+{
+    engine_tile_cache_pass *Pass = UserData;
+    tile_cache_entry *Entry = Pass->Misses[Index];
+
+    color_buffer TileBuffer = MakeColorBuffer(Pass->Engine, Entry->Pixels, TILE_SIZE, TILE_SIZE, TILE_SIZE);
+    coordmap TileMap = GetTileGridMap(Pass->Grid, Entry->Key.TileX, Entry->Key.TileY);
+    tile_job Job = MakeTileJob(
+        Pass->Engine->Method, Pass->Engine->Mode,
+        &TileBuffer, &TileMap,
+        Entry->Key.IterationCount, Pass->Engine->MaxValue
+    );
+    RenderTile(&Job, 0);
+}
+
+Bool8 EngineRenderFromTileCache(
+    const render_engine *Engine,
+    tile_cache *Cache,
+    tile_store *Store,
+    color_buffer *Buffer,
+    const tile_grid *Grid
+)
+{
+    i64 FirstTileX, FirstTileY;
+    int TileCountX, TileCountY;
+    int TileCount = GetTileGridTiles(Grid, &FirstTileX, &FirstTileY, &TileCountX, &TileCountY);
+
+    /* the view has to fit in the cache, otherwise its own tiles would evict each other */
+    if (TileCount > Cache->Capacity)
+        return false;
+    tile_cache_entry **Tiles = malloc(2 * (size_t)TileCount * sizeof *Tiles);
+    if (NULL == Tiles)
+        return false;
+    tile_cache_entry **Misses = Tiles + TileCount;
+    int MissCount = 0;
+
+    /* the tiles this view touched are the most recently used, so inserting won't evict them */
+    for (int y = 0; y < TileCountY; y++)
+    {
+        for (int x = 0; x < TileCountX; x++)
+        {
+            tile_key Key = {
+                .Level = Grid->Level,
+                .TileX = FirstTileX + x,
+                .TileY = FirstTileY + y,
+                .IterationCount = Engine->IterationCount,
+                .Mode = Engine->Mode,
+                .Method = Engine->Method,
+                .Formula = FORMULA_MANDELBROT,
+            };
+            tile_cache_entry *Entry = TileCacheLookup(Cache, &Key);
+            if (NULL == Entry)
+            {
+                /* rendered by an earlier run? */
+                Entry = TileCacheInsert(Cache, &Key);
+                const u32 *Stored = Store? TileStoreLookup(Store, &Key) : NULL;
+                if (Stored)
+                    memcpy(Entry->Pixels, Stored, sizeof Entry->Pixels);
+                else Misses[MissCount++] = Entry;
+            }
+            Tiles[y*TileCountX + x] = Entry;
+        }
+    }
+
+    engine_tile_cache_pass Pass = {
+        .Engine = Engine,
+        .Grid = Grid,
+        .Misses = Misses,
+    };
+    EngineParallelFor(Engine, MissCount, EngineRenderCacheMissFn, &Pass);
+    for (int i = 0; i < MissCount && Store; i++)
+    {
+        TileStorePut(Store, &Misses[i]->Key, Misses[i]->Pixels);
+    }
+    for (int i = 0; i < TileCount; i++)
+    {
+        CopyTileToBuffer(Buffer, Grid, Tiles[i]->Key.TileX, Tiles[i]->Key.TileY, Tiles[i]->Pixels);
+    }
+
+    free(Tiles);
+    return true;
+}
+
+
+
+/*
+ * Banded rendering:
+ * the image is rendered BandHeight rows at a time into a single band buffer,
+ * each band goes to the callback before the next one overwrites it,
+ * so memory stays at one band however big the image is.
+ * Supersampling compares a pixel with the rows above and below it,
+ * so then the band is rendered with one more row on each side, and those rows are left out of what the callback sees.
+ * Rows before StartRow are skipped, that's where a render that was stopped picks up again.
+ * The narrow formats never have a 32 bit band, a block of PACK_BLOCK_WIDTH x PACK_BLOCK_HEIGHT pixels
+ * is rendered on the stack of the thread, where it stays in the cache, and only its packed pixels go out to the band.
+ */
+
+#define PACK_BLOCK_WIDTH 256
+#define PACK_BLOCK_HEIGHT 16
+
+typedef struct engine_packed_band
+{
+    const render_engine *Engine;
+    const coordmap *Map;
+    pixel_buffer *Band;
+    int FirstRow;
+    int BlockCountX;
+} engine_packed_band;
+
+static void EngineRenderPackedBlockFn(void *UserData, int Index)
+{
+    engine_packed_band *Pass = UserData;
+    const render_engine *Engine = Pass->Engine;
+    pixel_buffer *Band = Pass->Band;
+    int x = (Index % Pass->BlockCountX) * PACK_BLOCK_WIDTH;
+    int y = (Index / Pass->BlockCountX) * PACK_BLOCK_HEIGHT;
+
+    u32 Colors[PACK_BLOCK_WIDTH * PACK_BLOCK_HEIGHT];
+    u32 Counts[PACK_BLOCK_WIDTH * PACK_BLOCK_HEIGHT];
+    color_buffer Block = MakeColorBuffer(
+        Engine, Colors, 
+        MIN(PACK_BLOCK_WIDTH, Band->Width - x), 
+        MIN(PACK_BLOCK_HEIGHT, Band->Height - y), 
+        PACK_BLOCK_WIDTH
+    );
+    Block.Counts = Counts;
+    coordmap BlockMap = *Pass->Map;
+    BlockMap.OffsetX += x;
+    BlockMap.OffsetY += Pass->FirstRow + y;
+    BlockMap.Width = Block.Width * Pass->Map->Delta;
+    BlockMap.Height = Block.Height * Pass->Map->Delta;
+    RenderMandelbrotSet(Engine->Mode, &Block, &BlockMap, Engine->IterationCount, Engine->MaxValue);
+
+    int Size = GetPixelFormatSize(Band->Format);
+    for (int Row = 0; Row < Block.Height; Row++)
+    {
+        PackPixels(
+            Engine->Mode, Band->Format, 
+            (u8*)Band->Ptr + (y + Row)*Band->Stride + (size_t)x*Size,
+            Colors + Row*PACK_BLOCK_WIDTH, Counts + Row*PACK_BLOCK_WIDTH, 
+            Block.Width
+        );
+    }
+}
+
+static Bool8 EngineRenderPackedBands(
+    const render_engine *Engine,
+    const coordmap *Map,
+    int Width, int Height,
+    int StartRow,
+    int BandHeight,
+    pixel_format Format,
+    band_fn Fn,
+    void *UserData
+)
+{
+    size_t Stride = (size_t)Width * GetPixelFormatSize(Format);
+    void *Pixels = malloc(Stride * BandHeight);
+    Bool8 Ok = NULL != Pixels;
+
+    for (int Row = MAX(0, StartRow); Ok && Row < Height; Row += BandHeight)
+    {
+        pixel_buffer Band = {
+            .Format = Format,
+            .Ptr = Pixels,
+            .Width = Width,
+            .Height = MIN(BandHeight, Height - Row),
+            .Stride = Stride,
+        };
+        engine_packed_band Pass = {
+            .Engine = Engine,
+            .Map = Map,
+            .Band = &Band,
+            .FirstRow = Row,
+            .BlockCountX = (Width + PACK_BLOCK_WIDTH - 1) / PACK_BLOCK_WIDTH,
+        };
+        int BlockCountY = (Band.Height + PACK_BLOCK_HEIGHT - 1) / PACK_BLOCK_HEIGHT;
+        EngineParallelFor(Engine, Pass.BlockCountX * BlockCountY, EngineRenderPackedBlockFn, &Pass);
+        Ok = Fn(UserData, &Band, Row);
+    }
+
+    free(Pixels);
+    return Ok;
+}
+
+Bool8 EngineRenderBands(
+    const render_engine *Engine,
+    const coordmap *Map,
+    int Width, int Height,
+    int StartRow,
+    int BandHeight,
+    pixel_format Format,
+    Bool8 Supersample,
+    band_fn Fn,
+    void *UserData
+)
+{
+    BandHeight = MAX(1, MIN(BandHeight, Height));
+    if (PIXEL_FORMAT_RGB32 != Format)
+        return EngineRenderPackedBands(Engine, Map, Width, Height, StartRow, BandHeight, Format, Fn, UserData);
+
+    int ContextRows = Supersample? 1 : 0;
+    size_t BandPixels = (size_t)Width * (BandHeight + 2*ContextRows);
+    u32 *Pixels = malloc(BandPixels * sizeof *Pixels);
+    u8 *Edges = Supersample? malloc(BandPixels) : NULL;
+    Bool8 Ok = NULL != Pixels && (!Supersample || NULL != Edges);
+
+    for (int Row = MAX(0, StartRow); Ok && Row < Height; Row += BandHeight)
+    {
+        int FirstRow = MAX(0, Row - ContextRows);
+        int LastRow = MIN(Height, Row + BandHeight + ContextRows);
+        color_buffer Band = MakeColorBuffer(Engine, Pixels, Width, LastRow - FirstRow, Width);
+        coordmap BandMap = *Map;
+        BandMap.OffsetY += FirstRow;
+        BandMap.Height = Band.Height * Map->Delta;
+
+        EngineRenderBuffer(Engine, &Band, &BandMap);
+        if (Supersample)
+            EngineSupersampleEdges(Engine, &Band, &BandMap, Edges);
+
+        pixel_buffer Inner = {
+            .Format = PIXEL_FORMAT_RGB32,
+            .Ptr = Band.Ptr + (Row - FirstRow) * Band.Stride,
+            .Width = Width,
+            .Height = MIN(BandHeight, Height - Row),
+            .Stride = Band.Stride * sizeof *Band.Ptr,
+        };
+        Ok = Fn(UserData, &Inner, Row);
+    }
+
+    free(Edges);
+    free(Pixels);
+    return Ok;
+}
+
@@ -0,0 +1,202 @@
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Common.h"
+
+/*
+ * Exponential map:
+ * a zoom into a fixed point is a stack of circles around that point, each one a constant factor smaller,
+ * so the whole zoom can be rendered once as a strip where every row is one circle (log-polar),
+ * with as many samples around a circle as the largest circle of a frame needs.
+ * A frame then doesn't render anything, every pixel is looked up in the strip at its radius and angle,
+ * only the rows the frames get to are rendered, and only once.
+ * The frames only ever see a window of rows that moves towards the small circles as the zoom goes on,
+ * so the strip lives in a ring of WindowHeight rows, row r at r % WindowHeight, and memory doesn't grow with the depth.
+ */
+
+#define EXP_MAP_PI 3.14159265358979323846
+
+/* the radius of the center pixel, it has no angle, so it gets the circle half a pixel away */
+#define EXP_MAP_CENTER_RADIUS 0.5
+
+Bool8 ExpMapInit(
+    exp_map *Map,
+    double CenterX, double CenterY,
+    double StartViewHeight, double EndViewHeight,
+    int FrameWidth, int FrameHeight
+)
+{
+    memset(Map, 0, sizeof *Map);
+
+    /* enough samples around the circle through the corners of a frame that they're a pixel apart there */
+    double HalfDiagonal = 0.5 * sqrt((double)FrameWidth*FrameWidth + (double)FrameHeight*FrameHeight);
+    int Width = (int)ceil(2 * EXP_MAP_PI * HalfDiagonal);
+    Width = (Width + 7) / 8 * 8;
+
+    Map->CenterX = CenterX;
+    Map->CenterY = CenterY;
+    Map->Width = Width;
+    Map->LogDelta = 2 * EXP_MAP_PI / Width;
+    Map->FrameWidth = FrameWidth;
+    Map->FrameHeight = FrameHeight;
+
+    /* row 0 is a row outside the corners of the first frame, the last row is a row inside the center pixel of the last one */
+    double StartDelta = StartViewHeight / FrameHeight;
+    double EndDelta = EndViewHeight / FrameHeight;
+    Map->LogRadius = log(HalfDiagonal * StartDelta) + Map->LogDelta;
+    Map->RowCount = 2 + (int)ceil((Map->LogRadius - log(EXP_MAP_CENTER_RADIUS * EndDelta)) / Map->LogDelta);
+
+    /* a frame spans the rows from its corners to its center pixel, plus one for the interpolation,
+     * and a band has to fit in next to them before the oldest of them are overwritten */
+    int FrameRowCount = 2 + (int)ceil(log(HalfDiagonal / EXP_MAP_CENTER_RADIUS) / Map->LogDelta);
+    Map->WindowHeight = (FrameRowCount + 2*EXP_MAP_BAND_HEIGHT - 1) / EXP_MAP_BAND_HEIGHT * EXP_MAP_BAND_HEIGHT;
+
+    size_t PixelCount = (size_t)FrameWidth * FrameHeight;
+    Map->Window = malloc((size_t)Width * Map->WindowHeight * sizeof *Map->Window);
+    Map->Cos = malloc(Width * sizeof *Map->Cos);
+    Map->Sin = malloc(Width * sizeof *Map->Sin);
+    Map->PixelRows = malloc(PixelCount * sizeof *Map->PixelRows);
+    Map->PixelColumns = malloc(PixelCount * sizeof *Map->PixelColumns);
+    if (NULL == Map->Window || NULL == Map->Cos || NULL == Map->Sin
+    || NULL == Map->PixelRows || NULL == Map->PixelColumns)
+    {
+        ExpMapFree(Map);
+        return false;
+    }
+
+    for (int i = 0; i < Width; i++)
+    {
+        Map->Cos[i] = cos(i * Map->LogDelta);
+        Map->Sin[i] = sin(i * Map->LogDelta);
+    }
+
+    /* where every pixel of a frame is in the strip, the row is relative to the row of the frame's pixel size,
+     * it's the same for every frame, only that row moves */
+    for (int y = 0; y < FrameHeight; y++)
+    {
+        for (int x = 0; x < FrameWidth; x++)
+        {
+            double Dx = x - 0.5*FrameWidth;
+            double Dy = 0.5*FrameHeight - y;
+            double Radius = MAX(sqrt(Dx*Dx + Dy*Dy), EXP_MAP_CENTER_RADIUS);
+            double Angle = atan2(Dy, Dx);
+            if (Angle < 0)
+                Angle += 2 * EXP_MAP_PI;
+            float Column = (float)(Angle / Map->LogDelta);
+
+            size_t i = (size_t)y*FrameWidth + x;
+            Map->PixelRows[i] = (float)(-log(Radius) / Map->LogDelta);
+            Map->PixelColumns[i] = Column < Width? Column : 0;
+        }
+    }
+    return true;
+}
+
+void ExpMapFree(exp_map *Map)
+{
+    free(Map->Window);
+    free(Map->Cos);
+    free(Map->Sin);
+    free(Map->PixelRows);
+    free(Map->PixelColumns);
+    Map->Window = NULL;
+    Map->Cos = Map->Sin = NULL;
+    Map->PixelRows = Map->PixelColumns = NULL;
+}
+
+
+
+typedef struct exp_map_pass
+{
+    const render_engine *Engine;
+    exp_map *Map;
+    color_buffer *Frame;
+    int FirstRow;
+    double RowShift;
+} exp_map_pass;
+
+static void ExpMapRenderRowFn(void *UserData, int Index)
+{
+    exp_map_pass *Pass = UserData;
+    exp_map *Map = Pass->Map;
+    int Row = Pass->FirstRow + Index;
+
+    color_buffer Ring = MakeColorBuffer(
+        Pass->Engine,
+        Map->Window + (size_t)(Row % Map->WindowHeight) * Map->Width,
+        Map->Width, 1, Map->Width
+    );
+    polarmap RowMap = {
+        .CenterX = Map->CenterX,
+        .CenterY = Map->CenterY,
+        .LogRadius = Map->LogRadius - Row * Map->LogDelta,
+        .LogDelta = Map->LogDelta,
+        .Cos = Map->Cos,
+        .Sin = Map->Sin,
+    };
+    RenderPolarMandelbrotSet(Pass->Engine->Mode, &Ring, &RowMap, Pass->Engine->IterationCount, Pass->Engine->MaxValue);
+}
+
+static u32 ExpMapLerpColor(u32 A, u32 B, u32 Weight /* of B, out of 256 */)
+{
+    u32 Rb = ((A & 0xFF00FF) * (256 - Weight) + (B & 0xFF00FF) * Weight) >> 8;
+    u32 G = ((A & 0x00FF00) * (256 - Weight) + (B & 0x00FF00) * Weight) >> 8;
+    return (Rb & 0xFF00FF) | (G & 0x00FF00);
+}
+
+static void ExpMapResampleFn(void *UserData, int Index)
+{
+    exp_map_pass *Pass = UserData;
+    exp_map *Map = Pass->Map;
+    color_buffer *Frame = Pass->Frame;
+    int FirstY = Index * EXP_MAP_BAND_HEIGHT;
+    int LastY = MIN(FirstY + EXP_MAP_BAND_HEIGHT, Frame->Height);
+    for (int y = FirstY; y < LastY; y++)
+    {
+        u32 *Pixels = Frame->Ptr + y*Frame->Stride;
+        const float *Rows = Map->PixelRows + (size_t)y*Map->FrameWidth;
+        const float *Columns = Map->PixelColumns + (size_t)y*Map->FrameWidth;
+        for (int x = 0; x < Frame->Width; x++)
+        {
+            double Row = MIN(Pass->RowShift + Rows[x], Map->RowCount - 1);
+            int Row0 = (int)Row;
+            int Row1 = MIN(Row0 + 1, Map->RowCount - 1);
+            int Column0 = (int)Columns[x];
+            int Column1 = Column0 + 1 == Map->Width? 0 : Column0 + 1;
+            u32 RowWeight = (u32)((Row - Row0) * 256);
+            u32 ColumnWeight = (u32)((Columns[x] - Column0) * 256);
+
+            const u32 *Ring0 = Map->Window + (size_t)(Row0 % Map->WindowHeight) * Map->Width;
+            const u32 *Ring1 = Map->Window + (size_t)(Row1 % Map->WindowHeight) * Map->Width;
+            Pixels[x] = ExpMapLerpColor(
+                ExpMapLerpColor(Ring0[Column0], Ring0[Column1], ColumnWeight),
+                ExpMapLerpColor(Ring1[Column0], Ring1[Column1], ColumnWeight),
+                RowWeight
+            );
+        }
+    }
+}
+
+void ExpMapRenderFrame(const render_engine *Engine, exp_map *Map, color_buffer *Frame, double ViewHeight)
+{
+    exp_map_pass Pass = {
+        .Engine = Engine,
+        .Map = Map,
+        .Frame = Frame,
+        .RowShift = (Map->LogRadius - log(ViewHeight / Map->FrameHeight)) / Map->LogDelta,
+    };
+
+    /* the rows up to the one of the center pixel, a band at a time, with a row for each thread */
+    int LastRow = MIN((int)(Pass.RowShift + Map->PixelRows[(size_t)(Map->FrameHeight/2)*Map->FrameWidth + Map->FrameWidth/2]) + 2, Map->RowCount);
+    while (Map->RenderedRowCount < LastRow)
+    {
+        Pass.FirstRow = Map->RenderedRowCount;
+        int RowCount = MIN(EXP_MAP_BAND_HEIGHT, Map->RowCount - Pass.FirstRow);
+        EngineParallelFor(Engine, RowCount, ExpMapRenderRowFn, &Pass);
+        Map->RenderedRowCount += RowCount;
+    }
+
+    int BandCount = (Frame->Height + EXP_MAP_BAND_HEIGHT - 1) / EXP_MAP_BAND_HEIGHT;
+    EngineParallelFor(Engine, BandCount, ExpMapResampleFn, &Pass);
+}
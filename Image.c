@@ -0,0 +1,131 @@
+
+#include <stdio.h>
+#include "Common.h"
+
+Bool8 WritePPMHeader(FILE *File, int Width, int Height)
+{
+    return fprintf(File, "P6\n%d %d\n255\n", Width, Height) > 0;
+}
+
+Bool8 WritePPMRows(FILE *File, const color_buffer *Band)
+{
+    u8 Row[3 * 4096];
+    for (int y = 0; y < Band->Height; y++)
+    {
+        const u32 *Pixels = Band->Ptr + y*Band->Stride;
+
+        /* the pixels are 0x00RRGGBB, ppm wants r, g, b bytes, a chunk of the row at a time */
+        for (int x = 0; x < Band->Width; x += 4096)
+        {
+            int Count = MIN(4096, Band->Width - x);
+            for (int i = 0; i < Count; i++)
+            {
+                u32 Color = Pixels[x + i];
+                Row[3*i + 0] = (u8)(Color >> 16);
+                Row[3*i + 1] = (u8)(Color >> 8);
+                Row[3*i + 2] = (u8)Color;
+            }
+            if (fwrite(Row, 3, Count, File) != (size_t)Count)
+                return false;
+        }
+    }
+    return true;
+}
+
+Bool8 WriteImageHeader(FILE *File, pixel_format Format, int Width, int Height)
+{
+    switch (Format)
+    {
+    case PIXEL_FORMAT_RGB32:
+    case PIXEL_FORMAT_RGB24: return WritePPMHeader(File, Width, Height);
+    case PIXEL_FORMAT_INDEX8: return fprintf(File, "P5\n%d %d\n255\n", Width, Height) > 0;
+    case PIXEL_FORMAT_COUNT16: return fprintf(File, "P5\n%d %d\n65535\n", Width, Height) > 0;
+    default: return true;
+    }
+}
+
+Bool8 WriteImageRows(FILE *File, const pixel_buffer *Band)
+{
+    if (PIXEL_FORMAT_RGB32 == Band->Format)
+    {
+        color_buffer Rows = {
+            .Ptr = Band->Ptr,
+            .Width = Band->Width,
+            .Height = Band->Height,
+            .Stride = (int)(Band->Stride / sizeof(u32)),
+        };
+        return WritePPMRows(File, &Rows);
+    }
+
+    for (int y = 0; y < Band->Height; y++)
+    {
+        const u8 *Pixels = (const u8*)Band->Ptr + y*Band->Stride;
+        if (PIXEL_FORMAT_COUNT16 != Band->Format)
+        {
+            /* already the bytes of the file */
+            size_t Size = (size_t)Band->Width * GetPixelFormatSize(Band->Format);
+            if (fwrite(Pixels, 1, Size, File) != Size)
+                return false;
+            continue;
+        }
+
+        /* 16 bit pgm is big endian, a chunk of the row at a time */
+        u8 Row[2 * 4096];
+        const u16 *Counts = (const u16*)Pixels;
+        for (int x = 0; x < Band->Width; x += 4096)
+        {
+            int Count = MIN(4096, Band->Width - x);
+            for (int i = 0; i < Count; i++)
+            {
+                Row[2*i + 0] = (u8)(Counts[x + i] >> 8);
+                Row[2*i + 1] = (u8)Counts[x + i];
+            }
+            if (fwrite(Row, 2, Count, File) != (size_t)Count)
+                return false;
+        }
+    }
+    return true;
+}
+
+Bool8 WriteY4MHeader(FILE *File, int Width, int Height, int FrameRate)
+{
+    return fprintf(File, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", Width, Height, FrameRate) > 0;
+}
+
+Bool8 WriteY4MFrame(FILE *File, const color_buffer *Frame)
+{
+    if (fprintf(File, "FRAME\n") < 0)
+        return false;
+
+    /* bt.601 with the video range (16..235), that's what y4m means when it doesn't say,
+     * the planes come one after the other, y, then u, then v */
+    u8 Row[4096];
+    for (int Plane = 0; Plane < 3; Plane++)
+    {
+        for (int y = 0; y < Frame->Height; y++)
+        {
+            const u32 *Pixels = Frame->Ptr + y*Frame->Stride;
+            for (int x = 0; x < Frame->Width; x += 4096)
+            {
+                int Count = MIN(4096, Frame->Width - x);
+                for (int i = 0; i < Count; i++)
+                {
+                    u32 Color = Pixels[x + i];
+                    int r = (Color >> 16) & 0xFF, g = (Color >> 8) & 0xFF, b = Color & 0xFF;
+                    int Value;
+                    if (0 == Plane)
+                        Value = ((66*r + 129*g + 25*b + 128) >> 8) + 16;
+                    else if (1 == Plane)
+                        Value = ((-38*r - 74*g + 112*b + 128) >> 8) + 128;
+                    else
+                        Value = ((112*r - 94*g - 18*b + 128) >> 8) + 128;
+                    Row[i] = (u8)Value;
+                }
+                if (fwrite(Row, 1, Count, File) != (size_t)Count)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
@@ -0,0 +1,1037 @@
+
+#include <math.h>
+#include <string.h>
+#include "Common.h"
+
+typedef void (*MandelbrotRenderFn)(
+    color_buffer *ColorBuffer,
+    const coordmap *Map,
+    int IterationCount,
+    double MaxValue
+);
+
+static const MandelbrotRenderFn Render[MODE_MAX + 1] = {
+    RenderMandelbrotSet32_Unopt,
+    RenderMandelbrotSet64_Unopt,
+    RenderMandelbrotSet32_SSE,
+    RenderMandelbrotSet64_SSE,
+    RenderMandelbrotSet32_SSEFMA,
+    RenderMandelbrotSet64_SSEFMA,
+    RenderMandelbrotSet32_AVX,
+    RenderMandelbrotSet64_AVX,
+    RenderMandelbrotSet32_AVXFMA,
+    RenderMandelbrotSet64_AVXFMA
+};
+
+/* how many pixels each kernel processes at a time */
+static const int RenderLaneCount[MODE_MAX + 1] = {
+    1, 1,
+    4, 2,
+    4, 2,
+    8, 4,
+    8, 4,
+};
+
+void RenderMandelbrotSet(
+    int Mode,
+    color_buffer *ColorBuffer,
+    const coordmap *Map,
+    int IterationCount,
+    double MaxValue
+)
+{
+    Render[Mode](ColorBuffer, Map, IterationCount, MaxValue);
+
+    /* the simd kernels skip the last (Width % LaneCount) columns, 
+     * render those with the same kernel into a block that is a full register wide, 
+     * then copy back the columns that belong to the buffer, 
+     * the scalar kernels count iterations slightly differently so they can't be used for this */
+    int LaneCount = RenderLaneCount[Mode];
+    int AlignedWidth = ColorBuffer->Width - (ColorBuffer->Width % LaneCount);
+    int TailWidth = ColorBuffer->Width - AlignedWidth;
+    if (0 == TailWidth)
+        return;
+
+    enum { TAIL_BLOCK_HEIGHT = 64 };
+    u32 TailBlock[8 * TAIL_BLOCK_HEIGHT];
+    u32 TailCounts[8 * TAIL_BLOCK_HEIGHT];
+    color_buffer Tail = { 
+        .Ptr = TailBlock,
+        .Width = LaneCount,
+        .Stride = LaneCount,
+        .Counts = ColorBuffer->Counts? TailCounts : NULL,
+    };
+    memcpy(Tail.Palette, ColorBuffer->Palette, sizeof Tail.Palette);
+
+    coordmap TailMap = *Map;
+    TailMap.OffsetX += AlignedWidth;
+    for (int y = 0; y < ColorBuffer->Height; y += TAIL_BLOCK_HEIGHT)
+    {
+        Tail.Height = MIN(TAIL_BLOCK_HEIGHT, ColorBuffer->Height - y);
+        TailMap.OffsetY = Map->OffsetY + y;
+        Render[Mode](&Tail, &TailMap, IterationCount, MaxValue);
+
+        u32 *Dst = ColorBuffer->Ptr + y*ColorBuffer->Stride + AlignedWidth;
+        for (int Row = 0; Row < Tail.Height; Row++, Dst += ColorBuffer->Stride)
+        {
+            for (int x = 0; x < TailWidth; x++)
+                Dst[x] = TailBlock[Row*LaneCount + x];
+        }
+        if (ColorBuffer->Counts)
+        {
+            u32 *DstCounts = ColorBuffer->Counts + y*ColorBuffer->Stride + AlignedWidth;
+            for (int Row = 0; Row < Tail.Height; Row++, DstCounts += ColorBuffer->Stride)
+            {
+                for (int x = 0; x < TailWidth; x++)
+                    DstCounts[x] = TailCounts[Row*LaneCount + x];
+            }
+        }
+    }
+}
+
+void GetModePoints(int Mode, const coordmap *Map, int Width, int Height, double *PointsX, double *PointsY)
+{
+    /* every kernel takes each point straight from the map, the f32 ones round it to f32 */
+    Bool8 Single = IsSingleMode(Mode);
+    for (int x = 0; x < Width; x++)
+        PointsX[x] = Single? (float)GetMapX(Map, x) : GetMapX(Map, x);
+    for (int y = 0; y < Height; y++)
+        PointsY[y] = Single? (float)GetMapY(Map, y) : GetMapY(Map, y);
+}
+
+int GetPixelFormatSize(pixel_format Format)
+{
+    static const int Sizes[PIXEL_FORMAT_COUNT] = { 4, 1, 2, 2, 3 };
+    return Sizes[Format];
+}
+
+const char *GetPixelFormatName(pixel_format Format)
+{
+    static const char *Names[PIXEL_FORMAT_COUNT] = { "rgb32", "index8", "count16", "rgb565", "rgb24" };
+    return Names[Format];
+}
+
+void PackPixels(int Mode, pixel_format Format, void *Dst, const u32 *Colors, const u32 *Counts, int Count)
+{
+    /* modes 6 and up are the avx ones */
+    if (Mode >= 6)
+        PackPixels_AVX(Format, Dst, Colors, Counts, Count);
+    else PackPixels_Unopt(Format, Dst, Colors, Counts, Count);
+}
+
+void FilterPngRow(int Mode, u8 *Dst, const u8 *Row, const u8 *Prior, int Size, int PixelSize)
+{
+    if (Mode >= 6)
+        FilterPngRow_AVX(Dst, Row, Prior, Size, PixelSize);
+    else FilterPngRow_Unopt(Dst, Row, Prior, Size, PixelSize);
+}
+
+int GetMatchLength(int Mode, const u8 *A, const u8 *B, int Max)
+{
+    return Mode >= 6
+        ? GetMatchLength_AVX(A, B, Max)
+        : GetMatchLength_Unopt(A, B, Max);
+}
+
+int CountEqualPixels(int Mode, const u32 *Pixels, int Count, u32 Value)
+{
+    return Mode >= 6
+        ? CountEqualPixels_AVX(Pixels, Count, Value)
+        : CountEqualPixels_Unopt(Pixels, Count, Value);
+}
+
+void RecolorCounts(int Mode, color_buffer *ColorBuffer, int FirstRow, int RowCount)
+{
+    /* modes 6 and up are the avx ones */
+    if (Mode >= 6)
+        RecolorCounts_AVX(ColorBuffer, FirstRow, RowCount);
+    else RecolorCounts_Unopt(ColorBuffer, FirstRow, RowCount);
+}
+
+void RenderPolarMandelbrotSet(
+    int Mode,
+    color_buffer *ColorBuffer,
+    const polarmap *Map,
+    int IterationCount,
+    double MaxValue
+)
+{
+    /* modes 6 and up are the avx ones */
+    if (Mode >= 6)
+        RenderPolarMandelbrotSet64_AVX(ColorBuffer, Map, Mode, IterationCount, MaxValue);
+    else RenderPolarMandelbrotSet64_Unopt(ColorBuffer, Map, Mode, IterationCount, MaxValue);
+}
+
+
+
+void GetSubRect(
+    const color_buffer *ColorBuffer, const coordmap *Map, 
+    int x, int y, int w, int h, 
+    color_buffer *SubBuffer, coordmap *SubMap
+)
+{
+    *SubBuffer = *ColorBuffer;
+    SubBuffer->Ptr += y*ColorBuffer->Stride + x;
+    if (SubBuffer->Counts)
+        SubBuffer->Counts += y*ColorBuffer->Stride + x;
+    SubBuffer->Width = w;
+    SubBuffer->Height = h;
+
+    *SubMap = *Map;
+    SubMap->OffsetX += x;
+    SubMap->OffsetY += y;
+    SubMap->Width = w*Map->Delta;
+    SubMap->Height = h*Map->Delta;
+}
+
+/* renders the w*h rectangle at (x, y) of the job's buffer */
+static void RenderRect(const tile_job *Job, int x, int y, int w, int h)
+{
+    if (w <= 0 || h <= 0)
+        return;
+
+    color_buffer Rect;
+    coordmap RectMap;
+    GetSubRect(&Job->ColorBuffer, &Job->Map, x, y, w, h, &Rect, &RectMap);
+    RenderMandelbrotSet(Job->Mode, &Rect, &RectMap, Job->IterationCount, Job->MaxValue);
+}
+
+/* compares iteration counts, not colors, the palette repeats so two bands can have the same color */
+static Bool8 RectIsUniform(const color_buffer *Buffer, int x, int y, int w, int h, u32 Count)
+{
+    const u32 *Row = Buffer->Counts + y*Buffer->Stride + x;
+    for (int j = 0; j < h; j++, Row += Buffer->Stride)
+    {
+        for (int i = 0; i < w; i++)
+        {
+            if (Row[i] != Count)
+                return false;
+        }
+    }
+    return true;
+}
+
+static void FillRect(color_buffer *Buffer, int x, int y, int w, int h, u32 Color, u32 Count)
+{
+    u32 *Row = Buffer->Ptr + y*Buffer->Stride + x;
+    u32 *Counts = Buffer->Counts + y*Buffer->Stride + x;
+    for (int j = 0; j < h; j++, Row += Buffer->Stride, Counts += Buffer->Stride)
+    {
+        for (int i = 0; i < w; i++)
+        {
+            Row[i] = Color;
+            Counts[i] = Count;
+        }
+    }
+}
+
+/*
+ * Mariani-Silver subdivision:
+ * the set and each of its iteration bands are connected, 
+ * so if the whole border of a rectangle has the same iteration count, so does its inside.
+ * The border is computed as a strip one simd register wide on the left and right 
+ * (so the kernels don't waste any lanes on a single column) plus the top and bottom rows, 
+ * if it's uniform the inside is filled, otherwise the inside gets split in half 
+ * along its longer side and each half does the same thing.
+ * Every pixel is computed at most once.
+ */
+static void RenderSubdivide(tile_job *Job, int x, int y, int w, int h)
+{
+    int LaneCount = RenderLaneCount[Job->Mode];
+    int StripWidth = MAX(LaneCount, 2);
+
+    /* not worth it, just render the thing */
+    if (w < 2*StripWidth + LaneCount || h < 4 || w*h <= 256)
+    {
+        RenderRect(Job, x, y, w, h);
+        return;
+    }
+
+    int InnerX = x + StripWidth, 
+        InnerW = w - 2*StripWidth;
+    RenderRect(Job, x, y, StripWidth, h);
+    RenderRect(Job, x + w - StripWidth, y, StripWidth, h);
+    RenderRect(Job, InnerX, y, InnerW, 1);
+    RenderRect(Job, InnerX, y + h - 1, InnerW, 1);
+
+    color_buffer *Buffer = &Job->ColorBuffer;
+    u32 Count = Buffer->Counts[y*Buffer->Stride + x];
+    if (RectIsUniform(Buffer, x, y, StripWidth, h, Count)
+    && RectIsUniform(Buffer, x + w - StripWidth, y, StripWidth, h, Count)
+    && RectIsUniform(Buffer, InnerX, y, InnerW, 1, Count)
+    && RectIsUniform(Buffer, InnerX, y + h - 1, InnerW, 1, Count))
+    {
+        FillRect(Buffer, InnerX, y + 1, InnerW, h - 2, Buffer->Ptr[y*Buffer->Stride + x], Count);
+        return;
+    }
+
+    int InnerY = y + 1, 
+        InnerH = h - 2;
+    if (InnerW > InnerH)
+    {
+        int HalfW = InnerW / 2;
+        RenderSubdivide(Job, InnerX, InnerY, HalfW, InnerH);
+        RenderSubdivide(Job, InnerX + HalfW, InnerY, InnerW - HalfW, InnerH);
+    }
+    else
+    {
+        int HalfH = InnerH / 2;
+        RenderSubdivide(Job, InnerX, InnerY, InnerW, HalfH);
+        RenderSubdivide(Job, InnerX, InnerY + HalfH, InnerW, InnerH - HalfH);
+    }
+}
+
+/*
+ * Boundary tracing:
+ * start from the border of the tile, every computed pixel whose iteration count differs from one of its neighbors' 
+ * is on the edge of an iteration band, so its neighbors get queued and computed too, 
+ * this walks along the contour of each band and never enters the inside of one.
+ * Whatever is left uncomputed is enclosed by a single iteration count, 
+ * so a scanline fill from the left takes care of it.
+ * Pixels are computed a whole simd register at a time (a run of LaneCount pixels), 
+ * the extra pixels of the run are kept and count as computed.
+ */
+enum 
+{
+    TRACE_LOADED = 1 << 0,
+    TRACE_QUEUED = 1 << 1,
+};
+
+typedef struct trace_context
+{
+    tile_job *Job;
+    int x, y, w, h;
+    int RunWidth;
+    u8 Flags[TILE_SIZE * TILE_SIZE];
+    u16 Queue[TILE_SIZE * TILE_SIZE];
+    int QueueHead, QueueTail;
+} trace_context;
+
+/* the iteration count of the pixel, rendering its run first if it isn't there yet */
+static u32 TraceLoad(trace_context *Trace, int x, int y)
+{
+    color_buffer *Buffer = &Trace->Job->ColorBuffer;
+    u32 *Count = Buffer->Counts + (Trace->y + y)*Buffer->Stride + Trace->x + x;
+    u8 *Flags = &Trace->Flags[y*TILE_SIZE];
+    if (!(Flags[x] & TRACE_LOADED))
+    {
+        int RunX = MAX(0, MIN(x - x % Trace->RunWidth, Trace->w - Trace->RunWidth));
+        int RunW = MIN(Trace->RunWidth, Trace->w - RunX);
+        RenderRect(Trace->Job, Trace->x + RunX, Trace->y + y, RunW, 1);
+        for (int i = RunX; i < RunX + RunW; i++)
+            Flags[i] |= TRACE_LOADED;
+    }
+    return *Count;
+}
+
+static void TraceEnqueue(trace_context *Trace, int x, int y)
+{
+    u8 *Flags = &Trace->Flags[y*TILE_SIZE + x];
+    if (*Flags & TRACE_QUEUED)
+        return;
+
+    *Flags |= TRACE_QUEUED;
+    Trace->Queue[Trace->QueueTail++] = y*TILE_SIZE + x;
+}
+
+static void TraceScan(trace_context *Trace, int x, int y)
+{
+    u32 Center = TraceLoad(Trace, x, y);
+    Bool8 HasLeft = x > 0, 
+          HasRight = x < Trace->w - 1,
+          HasUp = y > 0, 
+          HasDown = y < Trace->h - 1;
+
+    /* a neighbor with a different count means (x, y) sits on an edge */
+    Bool8 Left = HasLeft && TraceLoad(Trace, x - 1, y) != Center;
+    Bool8 Right = HasRight && TraceLoad(Trace, x + 1, y) != Center;
+    Bool8 Up = HasUp && TraceLoad(Trace, x, y - 1) != Center;
+    Bool8 Down = HasDown && TraceLoad(Trace, x, y + 1) != Center;
+
+    if (Left) TraceEnqueue(Trace, x - 1, y);
+    if (Right) TraceEnqueue(Trace, x + 1, y);
+    if (Up) TraceEnqueue(Trace, x, y - 1);
+    if (Down) TraceEnqueue(Trace, x, y + 1);
+
+    /* the edge can also continue diagonally */
+    if (HasUp && HasLeft && (Up || Left)) TraceEnqueue(Trace, x - 1, y - 1);
+    if (HasUp && HasRight && (Up || Right)) TraceEnqueue(Trace, x + 1, y - 1);
+    if (HasDown && HasLeft && (Down || Left)) TraceEnqueue(Trace, x - 1, y + 1);
+    if (HasDown && HasRight && (Down || Right)) TraceEnqueue(Trace, x + 1, y + 1);
+}
+
+static void RenderBoundaryTrace(tile_job *Job, int x, int y, int w, int h)
+{
+    /* too big for the stack of some of the render threads */
+    static THREAD_LOCAL trace_context Trace;
+    Trace.Job = Job;
+    Trace.x = x;
+    Trace.y = y;
+    Trace.w = w;
+    Trace.h = h;
+    Trace.RunWidth = RenderLaneCount[Job->Mode];
+    Trace.QueueHead = 0;
+    Trace.QueueTail = 0;
+    for (int j = 0; j < h; j++)
+        memset(&Trace.Flags[j*TILE_SIZE], 0, w);
+
+    for (int i = 0; i < w; i++)
+    {
+        TraceEnqueue(&Trace, i, 0);
+        TraceEnqueue(&Trace, i, h - 1);
+    }
+    for (int j = 1; j < h - 1; j++)
+    {
+        TraceEnqueue(&Trace, 0, j);
+        TraceEnqueue(&Trace, w - 1, j);
+    }
+
+    while (Trace.QueueHead < Trace.QueueTail)
+    {
+        int Index = Trace.Queue[Trace.QueueHead++];
+        TraceScan(&Trace, Index % TILE_SIZE, Index / TILE_SIZE);
+    }
+
+    /* the left column is always loaded, anything not loaded takes the color and count to its left */
+    color_buffer *Buffer = &Job->ColorBuffer;
+    for (int j = 0; j < h; j++)
+    {
+        u32 *Row = Buffer->Ptr + (y + j)*Buffer->Stride + x;
+        u32 *Counts = Buffer->Counts + (y + j)*Buffer->Stride + x;
+        const u8 *Flags = &Trace.Flags[j*TILE_SIZE];
+        for (int i = 1; i < w; i++)
+        {
+            if (!(Flags[i] & TRACE_LOADED))
+            {
+                Row[i] = Row[i - 1];
+                Counts[i] = Counts[i - 1];
+            }
+        }
+    }
+}
+
+/* 
+ * Resumable: every pixel keeps its Z and iteration count in Job->IterationState, 
+ * so when only the iteration count goes up, the pixels that already escaped stay as they are 
+ * and the others continue from where they stopped instead of starting over from 0 
+ */
+static void RenderResumable(tile_job *Job, int x, int y, int w, int h)
+{
+    color_buffer Rect;
+    coordmap RectMap;
+    GetSubRect(&Job->ColorBuffer, &Job->Map, x, y, w, h, &Rect, &RectMap);
+
+    iteration_state State = Job->IterationState;
+    int Offset = y*State.Stride + x;
+    State.Zx += Offset;
+    State.Zy += Offset;
+    State.Count += Offset;
+    State.Escaped += Offset;
+    if (Job->ResetState)
+    {
+        for (int j = 0; j < h; j++)
+        {
+            memset(State.Zx + j*State.Stride, 0, w * sizeof *State.Zx);
+            memset(State.Zy + j*State.Stride, 0, w * sizeof *State.Zy);
+            memset(State.Count + j*State.Stride, 0, w * sizeof *State.Count);
+            memset(State.Escaped + j*State.Stride, 0, w * sizeof *State.Escaped);
+        }
+    }
+
+    double PointsX[TILE_SIZE], PointsY[TILE_SIZE];
+    GetModePoints(Job->Mode, &RectMap, w, h, PointsX, PointsY);
+
+    /* modes 6 and up are the avx ones */
+    if (Job->Mode >= 6)
+        ResumeMandelbrotSet64_AVX(&Rect, &State, PointsX, PointsY, Job->Mode, Job->IterationCount, Job->MaxValue);
+    else ResumeMandelbrotSet64_Unopt(&Rect, &State, PointsX, PointsY, Job->Mode, Job->IterationCount, Job->MaxValue);
+}
+
+tile_job MakeTileJob(
+    render_method Method, 
+    int Mode, 
+    const color_buffer *ColorBuffer, 
+    const coordmap *Map, 
+    int IterationCount, 
+    double MaxValue
+)
+{
+    tile_job Job = {
+        .ColorBuffer = *ColorBuffer,
+        .Map = *Map,
+        .Method = Method,
+        .Mode = Mode,
+        .IterationCount = IterationCount,
+        .MaxValue = MaxValue,
+
+        .TileCountX = (ColorBuffer->Width + TILE_SIZE - 1) / TILE_SIZE,
+        .TileCountY = (ColorBuffer->Height + TILE_SIZE - 1) / TILE_SIZE,
+    };
+    Job.TileCount = Job.TileCountX * Job.TileCountY;
+    return Job;
+}
+
+/* the guessing methods go by the iteration counts, which the job's buffer only has for some formats, 
+ * so they render the tile into one of their own that always has them, and it's copied over */
+static void RenderTileWithCounts(tile_job *Job, int x, int y, int w, int h, void (*Render)(tile_job *, int, int, int, int))
+{
+    static THREAD_LOCAL u32 TileColors[TILE_SIZE * TILE_SIZE];
+    static THREAD_LOCAL u32 TileCounts[TILE_SIZE * TILE_SIZE];
+    tile_job TileJob = *Job;
+    GetSubRect(&Job->ColorBuffer, &Job->Map, x, y, w, h, &TileJob.ColorBuffer, &TileJob.Map);
+    TileJob.ColorBuffer.Ptr = TileColors;
+    TileJob.ColorBuffer.Counts = TileCounts;
+    TileJob.ColorBuffer.Stride = TILE_SIZE;
+    Render(&TileJob, 0, 0, w, h);
+
+    color_buffer *Buffer = &Job->ColorBuffer;
+    for (int j = 0; j < h; j++)
+    {
+        memcpy(Buffer->Ptr + (y + j)*Buffer->Stride + x, &TileColors[j*TILE_SIZE], w * sizeof *TileColors);
+        if (Buffer->Counts)
+            memcpy(Buffer->Counts + (y + j)*Buffer->Stride + x, &TileCounts[j*TILE_SIZE], w * sizeof *TileCounts);
+    }
+}
+
+void RenderTile(tile_job *Job, int TileIndex)
+{
+    int x = (TileIndex % Job->TileCountX) * TILE_SIZE;
+    int y = (TileIndex / Job->TileCountX) * TILE_SIZE;
+    int w = MIN(TILE_SIZE, Job->ColorBuffer.Width - x);
+    int h = MIN(TILE_SIZE, Job->ColorBuffer.Height - y);
+
+    switch (Job->Method)
+    {
+    case RENDER_METHOD_SUBDIVIDE: RenderTileWithCounts(Job, x, y, w, h, RenderSubdivide); break;
+    case RENDER_METHOD_BOUNDARY_TRACE: RenderTileWithCounts(Job, x, y, w, h, RenderBoundaryTrace); break;
+    case RENDER_METHOD_RESUMABLE:
+    case RENDER_METHOD_ANYTIME: RenderResumable(Job, x, y, w, h); break;
+    default:
+    case RENDER_METHOD_FULL: RenderRect(Job, x, y, w, h); break;
+    }
+}
+
+
+
+/*
+ * Progressive rendering:
+ * the first pass renders every PROGRESSIVE_MAX_SPACING'th pixel,
+ * every pass after that halves the spacing.
+ * Going from spacing 2S to S, the samples on the grid of 2S are already there,
+ * the new ones are 3 grids of step 2S, offset by (S, 0), (0, S) and (S, S),
+ * so nothing gets computed twice.
+ * Each sample is drawn as an SxS block until a later pass replaces it.
+ */
+int GetProgressiveSubgrids(int Spacing, progressive_subgrid Subgrids[3])
+{
+    if (Spacing >= PROGRESSIVE_MAX_SPACING)
+    {
+        Subgrids[0] = (progressive_subgrid) { 0, 0, Spacing };
+        return 1;
+    }
+
+    int Step = 2*Spacing;
+    Subgrids[0] = (progressive_subgrid) { Spacing, 0, Step };
+    Subgrids[1] = (progressive_subgrid) { 0, Spacing, Step };
+    Subgrids[2] = (progressive_subgrid) { Spacing, Spacing, Step };
+    return 3;
+}
+
+void GetProgressiveSubgridSize(
+    progressive_subgrid Grid,
+    int Width, int Height,
+    int *GridWidth, int *GridHeight
+)
+{
+    *GridWidth = Grid.OffsetX < Width
+        ? (Width - Grid.OffsetX + Grid.Step - 1) / Grid.Step
+        : 0;
+    *GridHeight = Grid.OffsetY < Height
+        ? (Height - Grid.OffsetY + Grid.Step - 1) / Grid.Step
+        : 0;
+}
+
+coordmap GetProgressiveSubgridMap(progressive_subgrid Grid, const coordmap *Map)
+{
+    /* the grid has a Delta of its own, so the offsets are folded into Left and Top */
+    coordmap GridMap = *Map;
+    GridMap.Left = -GetMapX(Map, Grid.OffsetX);
+    GridMap.Top = GetMapY(Map, Grid.OffsetY);
+    GridMap.OffsetX = 0;
+    GridMap.OffsetY = 0;
+    GridMap.Delta = Map->Delta * Grid.Step;
+    return GridMap;
+}
+
+void ScatterProgressiveSubgrid(
+    color_buffer *Dst,
+    const color_buffer *Samples,
+    progressive_subgrid Grid,
+    int BlockSize
+)
+{
+    for (int j = 0; j < Samples->Height; j++)
+    {
+        int y = Grid.OffsetY + j*Grid.Step;
+        int BlockHeight = MIN(BlockSize, Dst->Height - y);
+        const u32 *Src = Samples->Ptr + j*Samples->Stride;
+        for (int i = 0; i < Samples->Width; i++)
+        {
+            int x = Grid.OffsetX + i*Grid.Step;
+            int BlockWidth = MIN(BlockSize, Dst->Width - x);
+            u32 Color = Src[i];
+
+            u32 *Row = Dst->Ptr + y*Dst->Stride + x;
+            for (int by = 0; by < BlockHeight; by++, Row += Dst->Stride)
+            {
+                for (int bx = 0; bx < BlockWidth; bx++)
+                    Row[bx] = Color;
+            }
+        }
+    }
+}
+
+
+
+Bool8 RenderViewEqual(const render_view *A, const render_view *B)
+{
+    return A->Width == B->Width
+        && A->Height == B->Height
+        && A->IterationCount == B->IterationCount
+        && A->Mode == B->Mode
+        && A->Method == B->Method
+        && A->Map.Left == B->Map.Left
+        && A->Map.Top == B->Map.Top
+        && A->Map.Width == B->Map.Width
+        && A->Map.Height == B->Map.Height
+        && A->Map.Delta == B->Map.Delta;
+}
+
+Bool8 GetPanOffset(const render_view *Last, render_view *Curr, int *ShiftX, int *ShiftY)
+{
+    if (Last->Width != Curr->Width
+    || Last->Height != Curr->Height
+    || Last->IterationCount != Curr->IterationCount
+    || Last->Mode != Curr->Mode
+    || Last->Method != Curr->Method
+    || Last->Map.Width != Curr->Map.Width
+    || Last->Map.Height != Curr->Map.Height
+    || Last->Map.Delta != Curr->Map.Delta
+    || Last->Map.Delta <= 0)
+    {
+        return false;
+    }
+
+    /* x = -Left + i*Delta, so a bigger Left moves the image to the right, 
+     * y = Top - j*Delta, so a bigger Top moves the image down */
+    double Dx = (Curr->Map.Left - Last->Map.Left) / Last->Map.Delta;
+    double Dy = (Curr->Map.Top - Last->Map.Top) / Last->Map.Delta;
+    if (Dx*Dx + Dy*Dy > (double)Curr->Width*Curr->Width + (double)Curr->Height*Curr->Height)
+    {
+        /* moved so far that nothing would be reused anyway, 
+         * also keeps the rounding below within int range */
+        return false;
+    }
+
+    *ShiftX = (int)(Dx < 0? Dx - 0.5 : Dx + 0.5);
+    *ShiftY = (int)(Dy < 0? Dy - 0.5 : Dy + 0.5);
+    Curr->Map.Left = Last->Map.Left + *ShiftX * Last->Map.Delta;
+    Curr->Map.Top = Last->Map.Top + *ShiftY * Last->Map.Delta;
+    return true;
+}
+
+/* moves the Width pixels of every row that stay in view, Height is the height of the whole buffer */
+static void ShiftPlane(u32 *Plane, int Stride, int Width, int Height, int ShiftX, int ShiftY)
+{
+    int SrcX = MAX(0, -ShiftX), 
+        DstX = MAX(0, ShiftX);
+    if (ShiftY > 0)
+    {
+        /* moving down, go from the bottom so the rows aren't overwritten before they're moved */
+        for (int y = Height - 1 - ShiftY; y >= 0; y--)
+        {
+            u32 *Src = Plane + y*Stride + SrcX;
+            u32 *Dst = Plane + (y + ShiftY)*Stride + DstX;
+            memmove(Dst, Src, Width * sizeof *Dst);
+        }
+    }
+    else
+    {
+        for (int y = -ShiftY; y < Height; y++)
+        {
+            u32 *Src = Plane + y*Stride + SrcX;
+            u32 *Dst = Plane + (y + ShiftY)*Stride + DstX;
+            memmove(Dst, Src, Width * sizeof *Dst);
+        }
+    }
+}
+
+void ShiftColorBuffer(color_buffer *Buffer, int ShiftX, int ShiftY)
+{
+    int Width = Buffer->Width - (ShiftX < 0? -ShiftX : ShiftX);
+    int Height = Buffer->Height - (ShiftY < 0? -ShiftY : ShiftY);
+    if (Width <= 0 || Height <= 0)
+        return;
+
+    /* the counts move with their pixels */
+    ShiftPlane(Buffer->Ptr, Buffer->Stride, Width, Buffer->Height, ShiftX, ShiftY);
+    if (Buffer->Counts)
+        ShiftPlane(Buffer->Counts, Buffer->Stride, Width, Buffer->Height, ShiftX, ShiftY);
+}
+
+
+
+/*
+ * Iteration estimate:
+ * the samples that escape late are the ones right next to the boundary,
+ * when a lot of them only get out near the limit, more of them are still inside and drawn black by mistake, so raise it.
+ * When even the slowest escaping sample is far from the limit, the extra iterations only go into the black pixels, so trim it.
+ * The zoom sets a floor, deeper views need more iterations to show any boundary at all.
+ */
+escape_stats ProbeEscapeCounts(
+    escape_probe *Probe, 
+    int Mode, 
+    const coordmap *Map, 
+    int Width, int Height, 
+    int IterationCount, 
+    double MaxValue
+)
+{
+    int ProbeWidth = ESCAPE_PROBE_WIDTH;
+    int ProbeHeight = MIN(ESCAPE_PROBE_HEIGHT, MAX(1, Height * ESCAPE_PROBE_WIDTH / Width));
+    double Delta = Map->Delta * Width / ProbeWidth;
+    coordmap ProbeMap = {
+        /* the samples sit in the middle of the pixels they stand for */
+        .Left = Map->Left - 0.5*Delta,
+        .Top = Map->Top - 0.5*Delta,
+        .Width = ProbeWidth * Delta,
+        .Height = ProbeHeight * Delta,
+        .Delta = Delta,
+    };
+    color_buffer ProbeBuffer = {
+        .Ptr = Probe->Colors,
+        .Width = ProbeWidth,
+        .Height = ProbeHeight,
+        .Stride = ProbeWidth,
+    };
+    GetDefaultPalette(ProbeBuffer.Palette);
+
+    /* the resumable method is the one that keeps the counts around */
+    tile_job Job = MakeTileJob(RENDER_METHOD_RESUMABLE, Mode, &ProbeBuffer, &ProbeMap, IterationCount, MaxValue);
+    Job.IterationState = (iteration_state) {
+        .Zx = Probe->Zx,
+        .Zy = Probe->Zy,
+        .Count = Probe->Count,
+        .Escaped = Probe->Escaped,
+        .Stride = ProbeWidth,
+    };
+    Job.ResetState = true;
+    for (int i = 0; i < Job.TileCount; i++)
+        RenderTile(&Job, i);
+
+    escape_stats Stats = {
+        .IterationCount = IterationCount,
+        .SampleCount = ProbeWidth * ProbeHeight,
+    };
+    for (int i = 0; i < Stats.SampleCount; i++)
+    {
+        int Count = Probe->Count[i];
+        if (!Probe->Escaped[i])
+        {
+            Stats.BoundedCount++;
+            continue;
+        }
+        if (2*Count >= IterationCount)
+            Stats.LateCount++;
+        Stats.MaxEscapeCount = MAX(Stats.MaxEscapeCount, Count);
+    }
+    return Stats;
+}
+
+int EstimateIterationCount(const escape_stats *Stats, double Zoom)
+{
+    double Floor = ITERATION_COUNT_MIN;
+    if (Zoom > 1)
+        Floor += 48.0 * log2(Zoom);
+
+    double Count = Stats->IterationCount;
+    double LateRatio = (double)Stats->LateCount / MAX(Stats->SampleCount, 1);
+    if (LateRatio > 0.02)
+    {
+        Count *= 2;
+    }
+    else if (LateRatio > 0.005)
+    {
+        Count *= 1.5;
+    }
+    else if (2.0 * Stats->MaxEscapeCount < 0.8 * Count)
+    {
+        /* twice the slowest escape leaves room for the samples in between the probe's */
+        Count = 2.0 * Stats->MaxEscapeCount;
+    }
+
+    Count = MAX(Count, Floor);
+    Count = MIN(Count, ITERATION_COUNT_MAX);
+    return (int)Count;
+}
+
+
+
+/*
+ * Edge supersampling:
+ * the image is rendered once at 1 sample per pixel, 
+ * a pixel whose color differs from a neighbor's is next to a change in the iteration count, 
+ * and only those pixels get SUPERSAMPLE_COUNT more samples, one in every cell of a 
+ * SUPERSAMPLE_GRID x SUPERSAMPLE_GRID grid over the pixel, at a random spot inside the cell.
+ * Marked pixels of a row are gathered into spans that are rendered one sample at a time, 
+ * a sample of a span is a regular row of points, so it goes through the same kernels as everything else, 
+ * the span is padded to a whole register so the kernels never fall back to the tail.
+ * The random spots only depend on the pixel's row and its block of SUPERSAMPLE_JITTER_WIDTH columns in the image, 
+ * a span never crosses a block, so the samples don't change with how the image was split up to render it.
+ */
+
+#define SUPERSAMPLE_SPAN_MAX 256
+#define SUPERSAMPLE_JITTER_WIDTH 128
+
+static u32 SupersampleHash(u32 x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+/* a span starts at a marked pixel and ends after the last marked pixel before a gap, 
+ * gaps narrower than a register cost nothing extra, so they don't end the span */
+static int GetMarkedSpanEnd(const u8 *MarkRow, int Start, int Width, int LaneCount)
+{
+    int End = Start + 1;
+    for (int i = End; i < Width && i - Start < SUPERSAMPLE_SPAN_MAX - 8; i++)
+    {
+        if (MarkRow[i])
+            End = i + 1;
+        else if (i - End >= LaneCount)
+            break;
+    }
+    return End;
+}
+
+static int ColorDistance(u32 A, u32 B)
+{
+    int Dr = (int)((A >> 16) & 0xFF) - (int)((B >> 16) & 0xFF);
+    int Dg = (int)((A >> 8) & 0xFF) - (int)((B >> 8) & 0xFF);
+    int Db = (int)(A & 0xFF) - (int)(B & 0xFF);
+    return (Dr < 0? -Dr : Dr) + (Dg < 0? -Dg : Dg) + (Db < 0? -Db : Db);
+}
+
+int FindEdgePixels(const color_buffer *Buffer, u8 *Edges, int FirstRow, int RowCount, int Threshold)
+{
+    int EdgeCount = 0;
+    for (int y = FirstRow; y < FirstRow + RowCount; y++)
+    {
+        const u32 *Row = Buffer->Ptr + y*Buffer->Stride;
+        u8 *EdgeRow = Edges + y*Buffer->Stride;
+        for (int x = 0; x < Buffer->Width; x++)
+        {
+            u32 Color = Row[x];
+            Bool8 IsEdge = (x > 0 && ColorDistance(Color, Row[x - 1]) > Threshold)
+                || (x + 1 < Buffer->Width && ColorDistance(Color, Row[x + 1]) > Threshold)
+                || (y > 0 && ColorDistance(Color, Row[x - Buffer->Stride]) > Threshold)
+                || (y + 1 < Buffer->Height && ColorDistance(Color, Row[x + Buffer->Stride]) > Threshold);
+            EdgeRow[x] = IsEdge;
+            EdgeCount += IsEdge;
+        }
+    }
+    return EdgeCount;
+}
+
+void SupersampleEdgePixels(
+    int Mode, 
+    color_buffer *Buffer, 
+    const u8 *Edges, 
+    const coordmap *Map, 
+    int IterationCount, 
+    double MaxValue, 
+    int FirstRow, int RowCount
+)
+{
+    int LaneCount = RenderLaneCount[Mode];
+    u32 Samples[SUPERSAMPLE_SPAN_MAX];
+    u32 SumR[SUPERSAMPLE_SPAN_MAX], SumG[SUPERSAMPLE_SPAN_MAX], SumB[SUPERSAMPLE_SPAN_MAX];
+    color_buffer SampleBuffer = {
+        .Ptr = Samples,
+        .Height = 1,
+        .Stride = SUPERSAMPLE_SPAN_MAX,
+    };
+    memcpy(SampleBuffer.Palette, Buffer->Palette, sizeof SampleBuffer.Palette);
+
+    for (int y = FirstRow; y < FirstRow + RowCount; y++)
+    {
+        u32 *Row = Buffer->Ptr + y*Buffer->Stride;
+        const u8 *EdgeRow = Edges + y*Buffer->Stride;
+        int x = 0;
+        while (x < Buffer->Width)
+        {
+            if (!EdgeRow[x])
+            {
+                x++;
+                continue;
+            }
+
+            int Start = x;
+            int AbsoluteX = Map->OffsetX + Start;
+            int Block = (AbsoluteX - (AbsoluteX < 0? SUPERSAMPLE_JITTER_WIDTH - 1 : 0)) / SUPERSAMPLE_JITTER_WIDTH;
+            int BlockEnd = (Block + 1)*SUPERSAMPLE_JITTER_WIDTH - Map->OffsetX;
+            int End = GetMarkedSpanEnd(EdgeRow, Start, MIN(Buffer->Width, BlockEnd), LaneCount);
+            int SpanWidth = End - Start;
+            SampleBuffer.Width = (SpanWidth + LaneCount - 1) / LaneCount * LaneCount;
+
+            memset(SumR, 0, SpanWidth * sizeof *SumR);
+            memset(SumG, 0, SpanWidth * sizeof *SumG);
+            memset(SumB, 0, SpanWidth * sizeof *SumB);
+            u32 Seed = SupersampleHash(SupersampleHash((u32)(Map->OffsetY + y)) + (u32)Block) * SUPERSAMPLE_COUNT;
+            for (int s = 0; s < SUPERSAMPLE_COUNT; s++)
+            {
+                /* the pixel covers [-1/2, 1/2) around its sample */
+                u32 Random = SupersampleHash(Seed + s);
+                double JitterX = ((s % SUPERSAMPLE_GRID) + (Random & 0xFFFF) / 65536.0) / SUPERSAMPLE_GRID - 0.5;
+                double JitterY = ((s / SUPERSAMPLE_GRID) + (Random >> 16) / 65536.0) / SUPERSAMPLE_GRID - 0.5;
+                coordmap SampleMap = *Map;
+                SampleMap.Left = Map->Left - JitterX * Map->Delta;
+                SampleMap.Top = Map->Top - JitterY * Map->Delta;
+                SampleMap.OffsetX = Map->OffsetX + Start;
+                SampleMap.OffsetY = Map->OffsetY + y;
+                Render[Mode](&SampleBuffer, &SampleMap, IterationCount, MaxValue);
+
+                for (int i = 0; i < SpanWidth; i++)
+                {
+                    SumR[i] += (Samples[i] >> 16) & 0xFF;
+                    SumG[i] += (Samples[i] >> 8) & 0xFF;
+                    SumB[i] += Samples[i] & 0xFF;
+                }
+            }
+
+            for (int i = 0; i < SpanWidth; i++)
+            {
+                if (EdgeRow[Start + i])
+                {
+                    Row[Start + i] = RGB(
+                        SumR[i] / SUPERSAMPLE_COUNT, 
+                        SumG[i] / SUPERSAMPLE_COUNT, 
+                        SumB[i] / SUPERSAMPLE_COUNT
+                    );
+                }
+            }
+            x = End;
+        }
+    }
+}
+
+
+
+/*
+ * Frame reuse:
+ * the frames of a zoom are close to each other, most of a frame was already on screen in the one before it,
+ * only a bit bigger or smaller.
+ * A pixel whose spot in the previous frame is surrounded by pixels of a single color
+ * (inside the set, or in the middle of a band) takes that color,
+ * the rest get marked and are rendered again, in spans like the supersampled pixels.
+ * The inside of the set is where the iterations go, and it's also the most uniform part,
+ * so a zoom into it gets a lot cheaper.
+ */
+
+int ReusePreviousFrame(
+    color_buffer *Buffer, 
+    u8 *Marks, 
+    const coordmap *Map, 
+    const color_buffer *Previous, 
+    const coordmap *PreviousMap, 
+    int FirstRow, int RowCount
+)
+{
+    /* the neighborhood has to reach the previous frame's pixels around the ones next to this pixel */
+    double Scale = Map->Delta / PreviousMap->Delta;
+    int Radius = 1 + (int)Scale;
+    int MarkCount = 0;
+    for (int y = FirstRow; y < FirstRow + RowCount; y++)
+    {
+        u32 *Row = Buffer->Ptr + y*Buffer->Stride;
+        u8 *MarkRow = Marks + y*Buffer->Stride;
+        double PlaneY = GetMapY(Map, y);
+        int py = (int)floor((GetMapY(PreviousMap, 0) - PlaneY) / PreviousMap->Delta + 0.5);
+        for (int x = 0; x < Buffer->Width; x++)
+        {
+            double PlaneX = GetMapX(Map, x);
+            int px = (int)floor((PlaneX - GetMapX(PreviousMap, 0)) / PreviousMap->Delta + 0.5);
+
+            Bool8 IsUniform = px >= Radius && px < Previous->Width - Radius
+                && py >= Radius && py < Previous->Height - Radius;
+            u32 Color = IsUniform? Previous->Ptr[py*Previous->Stride + px] : 0;
+            for (int j = -Radius; IsUniform && j <= Radius; j++)
+            {
+                const u32 *Neighbors = Previous->Ptr + (py + j)*Previous->Stride + px;
+                for (int i = -Radius; i <= Radius; i++)
+                    IsUniform &= Neighbors[i] == Color;
+            }
+
+            if (IsUniform)
+                Row[x] = Color;
+            MarkRow[x] = !IsUniform;
+            MarkCount += !IsUniform;
+        }
+    }
+    return MarkCount;
+}
+
+void RenderMarkedPixels(
+    int Mode, 
+    color_buffer *Buffer, 
+    const u8 *Marks, 
+    const coordmap *Map, 
+    int IterationCount, 
+    double MaxValue, 
+    int FirstRow, int RowCount
+)
+{
+    int LaneCount = RenderLaneCount[Mode];
+    u32 Samples[SUPERSAMPLE_SPAN_MAX];
+    color_buffer SpanBuffer = {
+        .Ptr = Samples,
+        .Height = 1,
+        .Stride = SUPERSAMPLE_SPAN_MAX,
+    };
+    memcpy(SpanBuffer.Palette, Buffer->Palette, sizeof SpanBuffer.Palette);
+
+    for (int y = FirstRow; y < FirstRow + RowCount; y++)
+    {
+        u32 *Row = Buffer->Ptr + y*Buffer->Stride;
+        const u8 *MarkRow = Marks + y*Buffer->Stride;
+        int x = 0;
+        while (x < Buffer->Width)
+        {
+            if (!MarkRow[x])
+            {
+                x++;
+                continue;
+            }
+
+            int Start = x;
+            int End = GetMarkedSpanEnd(MarkRow, Start, Buffer->Width, LaneCount);
+            SpanBuffer.Width = (End - Start + LaneCount - 1) / LaneCount * LaneCount;
+            coordmap SpanMap = *Map;
+            SpanMap.OffsetX = Map->OffsetX + Start;
+            SpanMap.OffsetY = Map->OffsetY + y;
+            Render[Mode](&SpanBuffer, &SpanMap, IterationCount, MaxValue);
+
+            for (int i = Start; i < End; i++)
+            {
+                if (MarkRow[i])
+                    Row[i] = Samples[i - Start];
+            }
+            x = End;
+        }
+    }
+}
+
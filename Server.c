@@ -0,0 +1,570 @@
+#include <stdlib.h>
+#include <string.h>
+#include "Common.h"
+
+#ifndef _WIN32
+#  include <math.h>
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <pthread.h>
+#  include <strings.h>
+#  include <sys/socket.h>
+#  include <sys/time.h>
+#  include <unistd.h>
+#endif /* _WIN32 */
+
+/*
+ * Tile server:
+ * answers GET /{z}/{x}/{y}.png over http on localhost, the tiles of an xyz pyramid
+ * where zoom 0 is one tile of the square around the whole set, and every zoom level splits each tile in 4.
+ * Every connection has its own thread, and all of them render on the same engine pool.
+ * Rendered tiles stay in a cache (as png), a request for a tile that is being rendered waits for that render
+ * instead of starting another one, and after a tile is sent its neighbors are queued up to be rendered
+ * in the background, so the tiles that come into view when the map is panned are mostly there already.
+ * Only posix sockets for now.
+ */
+
+/* zoom 0 is the square of side SERVER_WORLD_SIZE with its top left corner here */
+#define SERVER_WORLD_LEFT -2.5
+#define SERVER_WORLD_TOP 2.0
+#define SERVER_WORLD_SIZE 4.0
+
+#define SERVER_TILE_SIZE 256
+
+/* past that a pixel is too small for f64 */
+#define SERVER_MAX_ZOOM 40
+
+/* deeper tiles need more iterations to show anything */
+#define SERVER_ITERATIONS_PER_ZOOM 100
+
+#define SERVER_CACHE_TILE_COUNT 2048
+#define SERVER_PREFETCH_QUEUE_SIZE 64
+#define SERVER_MAX_CONNECTIONS 64
+#define SERVER_REQUEST_SIZE 8192
+#define SERVER_IDLE_TIMEOUT 30 /* seconds */
+
+#ifndef _WIN32
+
+typedef enum server_tile_state
+{
+    SERVER_TILE_RENDERING,
+    SERVER_TILE_READY,
+    SERVER_TILE_FAILED,
+} server_tile_state;
+
+typedef struct server_tile_key
+{
+    int Zoom;
+    i64 X, Y;
+} server_tile_key;
+
+typedef struct server_tile
+{
+    server_tile_key Key;
+    server_tile_state State;
+    u8 *Png;
+    size_t Size;
+
+    /* the requests that wait for it or send it, it can't be evicted while there are any */
+    int Users;
+    u64 LastUsed;
+    struct server_tile *Next; /* in the bucket */
+} server_tile;
+
+typedef struct tile_server
+{
+    render_engine Engine;
+    tile_server_options Options;
+
+    pthread_mutex_t Lock;
+    pthread_cond_t TileDone;
+    pthread_cond_t PrefetchReady;
+
+    server_tile *Buckets[SERVER_CACHE_TILE_COUNT];
+    int TileCount;
+    u64 Clock;
+
+    /* a ring, the oldest ones get dropped when it's full, they are the least likely to be needed */
+    server_tile_key Prefetch[SERVER_PREFETCH_QUEUE_SIZE];
+    int PrefetchFirst;
+    int PrefetchCount;
+
+    int ConnectionCount;
+} tile_server;
+
+typedef struct server_connection
+{
+    tile_server *Server;
+    int Socket;
+} server_connection;
+
+static u32 Server_Hash(server_tile_key Key)
+{
+    u64 Hash = (u64)Key.Zoom * 0x9E3779B97F4A7C15ull;
+    Hash ^= (u64)Key.X * 0xC2B2AE3D27D4EB4Full;
+    Hash ^= (u64)Key.Y * 0x165667B19E3779F9ull;
+    return (u32)(Hash ^ (Hash >> 32)) % SERVER_CACHE_TILE_COUNT;
+}
+
+static Bool8 Server_KeyEqual(server_tile_key A, server_tile_key B)
+{
+    return A.Zoom == B.Zoom && A.X == B.X && A.Y == B.Y;
+}
+
+static Bool8 Server_IsValidKey(server_tile_key Key)
+{
+    return Key.Zoom >= 0 && Key.Zoom <= SERVER_MAX_ZOOM
+        && Key.X >= 0 && Key.X < (i64)1 << Key.Zoom
+        && Key.Y >= 0 && Key.Y < (i64)1 << Key.Zoom;
+}
+
+/* the lock is held */
+static server_tile *Server_FindTile(tile_server *Server, server_tile_key Key)
+{
+    server_tile *Tile = Server->Buckets[Server_Hash(Key)];
+    while (Tile && !Server_KeyEqual(Tile->Key, Key))
+        Tile = Tile->Next;
+    return Tile;
+}
+
+/* the lock is held, drops the tile that was used longest ago and that nobody is using */
+static void Server_EvictTile(tile_server *Server)
+{
+    server_tile **Oldest = NULL;
+    for (int i = 0; i < SERVER_CACHE_TILE_COUNT; i++)
+    {
+        for (server_tile **Link = &Server->Buckets[i]; *Link; Link = &(*Link)->Next)
+        {
+            server_tile *Tile = *Link;
+            if (Tile->Users > 0 || SERVER_TILE_RENDERING == Tile->State)
+                continue;
+            if (NULL == Oldest || Tile->LastUsed < (*Oldest)->LastUsed)
+                Oldest = Link;
+        }
+    }
+    if (NULL == Oldest)
+        return;
+
+    server_tile *Tile = *Oldest;
+    *Oldest = Tile->Next;
+    free(Tile->Png);
+    free(Tile);
+    Server->TileCount--;
+}
+
+static Bool8 Server_WriteBand(void *UserData, const pixel_buffer *Band, int FirstRow)
+{
+    (void)FirstRow;
+    return ImageEncoderWriteBand(UserData, Band);
+}
+
+static Bool8 Server_RenderTile(tile_server *Server, server_tile_key Key, u8 **Png, size_t *Size)
+{
+    render_engine Engine = Server->Engine;
+    Engine.IterationCount = MIN(Engine.IterationCount + SERVER_ITERATIONS_PER_ZOOM * Key.Zoom, ITERATION_COUNT_MAX);
+
+    double TileSize = ldexp(SERVER_WORLD_SIZE, -Key.Zoom);
+    coordmap Map = MakeCenteredMap(
+        SERVER_WORLD_LEFT + (Key.X + 0.5) * TileSize,
+        SERVER_WORLD_TOP - (Key.Y + 0.5) * TileSize,
+        TileSize,
+        SERVER_TILE_SIZE, SERVER_TILE_SIZE
+    );
+
+    char *Data = NULL;
+    FILE *File = open_memstream(&Data, Size);
+    if (NULL == File)
+        return false;
+    image_encoder Encoder;
+    Bool8 Rendered = false;
+    if (ImageEncoderInit(&Encoder, &Engine, File, IMAGE_FILE_PNG, PIXEL_FORMAT_RGB32, SERVER_TILE_SIZE, SERVER_TILE_SIZE, Server->Options.Stored))
+    {
+        Rendered = EngineRenderBands(
+            &Engine, &Map,
+            SERVER_TILE_SIZE, SERVER_TILE_SIZE,
+            0, SERVER_TILE_SIZE,
+            PIXEL_FORMAT_RGB32,
+            Server->Options.Supersample,
+            Server_WriteBand, &Encoder
+        );
+        Rendered = Rendered && ImageEncoderFinish(&Encoder);
+        ImageEncoderFree(&Encoder);
+    }
+    Rendered = 0 == fclose(File) && Rendered;
+    if (!Rendered)
+    {
+        free(Data);
+        return false;
+    }
+    *Png = (u8 *)Data;
+    return true;
+}
+
+/* the tile with a user added, rendered by this thread when no other thread has it or is on it,
+ * NULL when it couldn't be rendered, *WasCached says whether it was there (or on the way) already */
+static server_tile *Server_GetTile(tile_server *Server, server_tile_key Key, Bool8 *WasCached)
+{
+    pthread_mutex_lock(&Server->Lock);
+    server_tile *Tile = Server_FindTile(Server, Key);
+    *WasCached = NULL != Tile && SERVER_TILE_FAILED != Tile->State;
+    if (NULL == Tile)
+    {
+        if (Server->TileCount >= SERVER_CACHE_TILE_COUNT)
+            Server_EvictTile(Server);
+        Tile = calloc(1, sizeof *Tile);
+        if (NULL == Tile)
+        {
+            pthread_mutex_unlock(&Server->Lock);
+            return NULL;
+        }
+        u32 Bucket = Server_Hash(Key);
+        Tile->Key = Key;
+        Tile->State = SERVER_TILE_FAILED;
+        Tile->Next = Server->Buckets[Bucket];
+        Server->Buckets[Bucket] = Tile;
+        Server->TileCount++;
+    }
+    Tile->Users++;
+    Tile->LastUsed = ++Server->Clock;
+
+    if (SERVER_TILE_FAILED == Tile->State)
+    {
+        /* new, or the last render of it ran out of memory, try again */
+        Tile->State = SERVER_TILE_RENDERING;
+        pthread_mutex_unlock(&Server->Lock);
+        u8 *Png = NULL;
+        size_t Size = 0;
+        Bool8 Rendered = Server_RenderTile(Server, Key, &Png, &Size);
+        pthread_mutex_lock(&Server->Lock);
+        Tile->Png = Png;
+        Tile->Size = Size;
+        Tile->State = Rendered? SERVER_TILE_READY : SERVER_TILE_FAILED;
+        pthread_cond_broadcast(&Server->TileDone);
+    }
+    while (SERVER_TILE_RENDERING == Tile->State)
+        pthread_cond_wait(&Server->TileDone, &Server->Lock);
+
+    if (SERVER_TILE_READY != Tile->State)
+    {
+        Tile->Users--;
+        Tile = NULL;
+    }
+    pthread_mutex_unlock(&Server->Lock);
+    return Tile;
+}
+
+static void Server_ReleaseTile(tile_server *Server, server_tile *Tile)
+{
+    pthread_mutex_lock(&Server->Lock);
+    Tile->Users--;
+    pthread_mutex_unlock(&Server->Lock);
+}
+
+static void Server_PrefetchNeighbors(tile_server *Server, server_tile_key Key)
+{
+    pthread_mutex_lock(&Server->Lock);
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            server_tile_key Neighbor = { Key.Zoom, Key.X + dx, Key.Y + dy };
+            if ((0 == dx && 0 == dy) || !Server_IsValidKey(Neighbor) || Server_FindTile(Server, Neighbor))
+                continue;
+            if (SERVER_PREFETCH_QUEUE_SIZE == Server->PrefetchCount)
+            {
+                Server->PrefetchFirst = (Server->PrefetchFirst + 1) % SERVER_PREFETCH_QUEUE_SIZE;
+                Server->PrefetchCount--;
+            }
+            int Last = (Server->PrefetchFirst + Server->PrefetchCount++) % SERVER_PREFETCH_QUEUE_SIZE;
+            Server->Prefetch[Last] = Neighbor;
+        }
+    }
+    pthread_cond_signal(&Server->PrefetchReady);
+    pthread_mutex_unlock(&Server->Lock);
+}
+
+static void *Server_PrefetchThread(void *UserData)
+{
+    tile_server *Server = UserData;
+    for (;;)
+    {
+        pthread_mutex_lock(&Server->Lock);
+        while (0 == Server->PrefetchCount)
+            pthread_cond_wait(&Server->PrefetchReady, &Server->Lock);
+
+        /* the newest first, it's the closest to where the map is now */
+        Server->PrefetchCount--;
+        server_tile_key Key = Server->Prefetch[(Server->PrefetchFirst + Server->PrefetchCount) % SERVER_PREFETCH_QUEUE_SIZE];
+        Bool8 Cached = NULL != Server_FindTile(Server, Key);
+        pthread_mutex_unlock(&Server->Lock);
+        if (Cached)
+            continue;
+
+        Bool8 WasCached;
+        server_tile *Tile = Server_GetTile(Server, Key, &WasCached);
+        if (Tile)
+            Server_ReleaseTile(Server, Tile);
+    }
+    return NULL;
+}
+
+static Bool8 Server_Send(int Socket, const void *Data, size_t Size)
+{
+    const char *Ptr = Data;
+    while (Size > 0)
+    {
+        ssize_t Sent = send(Socket, Ptr, Size, MSG_NOSIGNAL);
+        if (Sent <= 0)
+            return false;
+        Ptr += Sent;
+        Size -= (size_t)Sent;
+    }
+    return true;
+}
+
+static Bool8 Server_SendError(int Socket, const char *Status, Bool8 KeepAlive)
+{
+    char Response[512];
+    int Length = snprintf(Response, sizeof Response,
+        "HTTP/1.1 %s\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: %d\r\n"
+        "Connection: %s\r\n"
+        "\r\n"
+        "%s\n",
+        Status, (int)strlen(Status) + 1, KeepAlive? "keep-alive" : "close", Status
+    );
+    return Server_Send(Socket, Response, (size_t)Length);
+}
+
+/* the end of the request line and headers, NULL when they aren't all there yet */
+static char *Server_FindHeaderEnd(char *Request, int Size)
+{
+    for (int i = 0; i + 4 <= Size; i++)
+    {
+        if (0 == memcmp(Request + i, "\r\n\r\n", 4))
+            return Request + i + 4;
+    }
+    return NULL;
+}
+
+/* whether the headers have Name with a value that contains Value, both lower case */
+static Bool8 Server_HasHeaderValue(const char *Headers, const char *Name, const char *Value)
+{
+    size_t NameLength = strlen(Name);
+    for (const char *Line = strstr(Headers, "\r\n"); Line; Line = strstr(Line, "\r\n"))
+    {
+        Line += 2;
+        if (0 != strncasecmp(Line, Name, NameLength) || ':' != Line[NameLength])
+            continue;
+        const char *End = strstr(Line, "\r\n");
+        for (const char *Ptr = Line + NameLength + 1; End && Ptr + strlen(Value) <= End; Ptr++)
+        {
+            if (0 == strncasecmp(Ptr, Value, strlen(Value)))
+                return true;
+        }
+    }
+    return false;
+}
+
+static Bool8 Server_ParseTilePath(const char *Path, server_tile_key *Key)
+{
+    long long X, Y;
+    int Length = 0;
+    if (3 != sscanf(Path, "/%d/%lld/%lld.png%n", &Key->Zoom, &X, &Y, &Length)
+    || ('\0' != Path[Length] && '?' != Path[Length]))
+    {
+        return false;
+    }
+    Key->X = X;
+    Key->Y = Y;
+    return Server_IsValidKey(*Key);
+}
+
+/* answers one request, false when the connection has to be closed */
+static Bool8 Server_HandleRequest(tile_server *Server, int Socket, char *Request)
+{
+    char Method[8], Path[1024];
+    int Major, Minor;
+    if (4 != sscanf(Request, "%7s %1023s HTTP/%d.%d", Method, Path, &Major, &Minor))
+    {
+        Server_SendError(Socket, "400 Bad Request", false);
+        return false;
+    }
+    Bool8 KeepAlive = Major > 1 || (1 == Major && Minor >= 1)
+        ? !Server_HasHeaderValue(Request, "connection", "close")
+        : Server_HasHeaderValue(Request, "connection", "keep-alive");
+
+    Bool8 IsHead = 0 == strcmp(Method, "HEAD");
+    if (!IsHead && 0 != strcmp(Method, "GET"))
+        return Server_SendError(Socket, "405 Method Not Allowed", KeepAlive) && KeepAlive;
+    server_tile_key Key;
+    if (!Server_ParseTilePath(Path, &Key))
+        return Server_SendError(Socket, "404 Not Found", KeepAlive) && KeepAlive;
+
+    Bool8 WasCached;
+    server_tile *Tile = Server_GetTile(Server, Key, &WasCached);
+    if (NULL == Tile)
+        return Server_SendError(Socket, "500 Internal Server Error", KeepAlive) && KeepAlive;
+
+    /* the tile can't change or go away until it's released */
+    char Headers[512];
+    int HeadersLength = snprintf(Headers, sizeof Headers,
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: image/png\r\n"
+        "Content-Length: %zu\r\n"
+        "Cache-Control: public, max-age=86400\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "X-Cache: %s\r\n"
+        "Connection: %s\r\n"
+        "\r\n",
+        Tile->Size, WasCached? "hit" : "miss", KeepAlive? "keep-alive" : "close"
+    );
+    Bool8 Sent = Server_Send(Socket, Headers, (size_t)HeadersLength)
+        && (IsHead || Server_Send(Socket, Tile->Png, Tile->Size));
+    Server_ReleaseTile(Server, Tile);
+
+    Server_PrefetchNeighbors(Server, Key);
+    return Sent && KeepAlive;
+}
+
+static void *Server_ConnectionThread(void *UserData)
+{
+    server_connection *Connection = UserData;
+    tile_server *Server = Connection->Server;
+    int Socket = Connection->Socket;
+    free(Connection);
+
+    char Request[SERVER_REQUEST_SIZE + 1];
+    int Used = 0;
+    for (;;)
+    {
+        char *End = Server_FindHeaderEnd(Request, Used);
+        if (NULL == End)
+        {
+            if (SERVER_REQUEST_SIZE == Used)
+            {
+                Server_SendError(Socket, "431 Request Header Fields Too Large", false);
+                break;
+            }
+            ssize_t Received = recv(Socket, Request + Used, SERVER_REQUEST_SIZE - Used, 0);
+            if (Received <= 0)
+                break;
+            Used += (int)Received;
+            continue;
+        }
+
+        /* a GET has no body, whatever comes after the headers is the next request */
+        char Next = *End;
+        *End = '\0';
+        if (!Server_HandleRequest(Server, Socket, Request))
+            break;
+        *End = Next;
+        Used -= (int)(End - Request);
+        memmove(Request, End, (size_t)Used);
+    }
+
+    close(Socket);
+    pthread_mutex_lock(&Server->Lock);
+    Server->ConnectionCount--;
+    pthread_mutex_unlock(&Server->Lock);
+    return NULL;
+}
+
+static Bool8 Server_StartThread(void *(*Fn)(void *), void *UserData)
+{
+    pthread_t Thread;
+    if (0 != pthread_create(&Thread, NULL, Fn, UserData))
+        return false;
+    pthread_detach(Thread);
+    return true;
+}
+
+Bool8 ServeTiles(const render_engine *Engine, const tile_server_options *Options)
+{
+    tile_server *Server = calloc(1, sizeof *Server);
+    if (NULL == Server)
+        return false;
+    Server->Engine = *Engine;
+    Server->Options = *Options;
+    pthread_mutex_init(&Server->Lock, NULL);
+    pthread_cond_init(&Server->TileDone, NULL);
+    pthread_cond_init(&Server->PrefetchReady, NULL);
+
+    /* the requests of every connection share the threads */
+    Server->Engine.Pool = EngineCreatePool(Engine->ThreadCount);
+    if (NULL == Server->Engine.Pool)
+        return false;
+
+    int Listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (Listener < 0)
+        return false;
+    int Yes = 1;
+    setsockopt(Listener, SOL_SOCKET, SO_REUSEADDR, &Yes, sizeof Yes);
+    struct sockaddr_in Address = {
+        .sin_family = AF_INET,
+        .sin_port = htons((u16)Options->Port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t AddressSize = sizeof Address;
+    if (0 != bind(Listener, (struct sockaddr *)&Address, sizeof Address)
+    || 0 != listen(Listener, SOMAXCONN)
+    || 0 != getsockname(Listener, (struct sockaddr *)&Address, &AddressSize))
+    {
+        close(Listener);
+        return false;
+    }
+
+    if (!Server_StartThread(Server_PrefetchThread, Server))
+    {
+        close(Listener);
+        return false;
+    }
+
+    fprintf(stderr, "serving tiles on http://127.0.0.1:%d/{z}/{x}/{y}.png\n", ntohs(Address.sin_port));
+    for (;;)
+    {
+        int Socket = accept(Listener, NULL, NULL);
+        if (Socket < 0)
+            continue;
+        setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, &Yes, sizeof Yes);
+        struct timeval Timeout = { .tv_sec = SERVER_IDLE_TIMEOUT };
+        setsockopt(Socket, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof Timeout);
+
+        pthread_mutex_lock(&Server->Lock);
+        Bool8 Full = Server->ConnectionCount >= SERVER_MAX_CONNECTIONS;
+        if (!Full)
+            Server->ConnectionCount++;
+        pthread_mutex_unlock(&Server->Lock);
+
+        server_connection *Connection = Full? NULL : malloc(sizeof *Connection);
+        if (Connection)
+        {
+            Connection->Server = Server;
+            Connection->Socket = Socket;
+            if (Server_StartThread(Server_ConnectionThread, Connection))
+                continue;
+            free(Connection);
+        }
+        if (!Full)
+        {
+            pthread_mutex_lock(&Server->Lock);
+            Server->ConnectionCount--;
+            pthread_mutex_unlock(&Server->Lock);
+        }
+        Server_SendError(Socket, "503 Service Unavailable", false);
+        close(Socket);
+    }
+}
+
+#else
+
+Bool8 ServeTiles(const render_engine *Engine, const tile_server_options *Options)
+{
+    (void)Engine;
+    (void)Options;
+    fprintf(stderr, "the tile server needs posix sockets\n");
+    return false;
+}
+
+#endif /* _WIN32 */
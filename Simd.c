@@ -1,7 +1,37 @@
 
 #include <immintrin.h>
+#include <math.h>
+#include <string.h>
 #include "Common.h"
 
+/* the points of a register of pixels from pixel x on, each lane computed from the map in one step like GetMapX, 
+ * the f32 ones are rounded from that, so every mode and every split of the image puts a pixel at the same point */
+static inline __m128d GetMapX2_SSE(const coordmap *Map, int x)
+{
+    double Index = Map->OffsetX + x;
+    __m128d Index2 = _mm_set_pd(Index + 1, Index);
+    return _mm_add_pd(_mm_set1_pd(-Map->Left), _mm_mul_pd(Index2, _mm_set1_pd(Map->Delta)));
+}
+
+static inline __m128 GetMapX4_SSE(const coordmap *Map, int x)
+{
+    return _mm_movelh_ps(_mm_cvtpd_ps(GetMapX2_SSE(Map, x)), _mm_cvtpd_ps(GetMapX2_SSE(Map, x + 2)));
+}
+
+static inline __m256d GetMapX4_AVX(const coordmap *Map, int x)
+{
+    double Index = Map->OffsetX + x;
+    __m256d Index4 = _mm256_set_pd(Index + 3, Index + 2, Index + 1, Index);
+    return _mm256_add_pd(_mm256_set1_pd(-Map->Left), _mm256_mul_pd(Index4, _mm256_set1_pd(Map->Delta)));
+}
+
+static inline __m256 GetMapX8_AVX(const coordmap *Map, int x)
+{
+    __m128 Lo4 = _mm256_cvtpd_ps(GetMapX4_AVX(Map, x));
+    __m128 Hi4 = _mm256_cvtpd_ps(GetMapX4_AVX(Map, x + 4));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(Lo4), Hi4, 1);
+}
+
 void RenderMandelbrotSet32_SSE(
     color_buffer *ColorBuffer,
     const coordmap *Map,
@@ -13,32 +43,26 @@ void RenderMandelbrotSet32_SSE(
     int BitsPerIteration = 4;
 
     u32 *Buffer = ColorBuffer->Ptr;
-    const __m128  DeltaX4 = _mm_set1_ps(Map->Delta*BitsPerIteration);
-    const __m128  DeltaY4 = _mm_set1_ps(Map->Delta);
+    u32 *Counts = ColorBuffer->Counts;
     const __m128  Two4 = _mm_set1_ps(2.0);
     const __m128i One4 = _mm_set1_epi32(1);
     const __m128i IterationCount4 = _mm_set1_epi32(IterationCount);
     const __m128i ColorPaletteSizeMask4 = _mm_set1_epi32(STATIC_ARRAY_SIZE(ColorBuffer->Palette) - 1);
     const __m128  MaxValueSquared4 = _mm_set1_ps(MaxValue*MaxValue);
-    const __m128  ZixResetValue4 = _mm_set_ps(
-        -Map->Left + 3*Map->Delta,
-        -Map->Left + 2*Map->Delta, 
-        -Map->Left + Map->Delta, 
-        -Map->Left
-    );
-    __m128 Zix4 = ZixResetValue4;
-    __m128 Ziy4 = _mm_set1_ps(Map->Top);
     int AlignedWidth = ColorBuffer->Width - (ColorBuffer->Width % BitsPerIteration);
-    int Remain = ColorBuffer->Width - AlignedWidth;
+    int Remain = ColorBuffer->Stride - AlignedWidth;
     for (int y = 0; 
              y < ColorBuffer->Height; 
              y++, 
              Buffer += Remain)
     {
+        __m128 Ziy4 = _mm_set1_ps((float)GetMapY(Map, y));
+
         for (int x = 0; 
                  x < AlignedWidth; 
                  x += BitsPerIteration)
         {
+            __m128 Zix4 = GetMapX4_SSE(Map, x);
             __m128 Zx4 = _mm_setzero_ps();
             __m128 Zy4 = _mm_setzero_ps();
 
@@ -123,11 +147,17 @@ LoopHead:
             _mm_storeu_si128((void*)Buffer, Color4);
             Buffer += BitsPerIteration;
 
-            Zix4 = _mm_add_ps(Zix4, DeltaX4);
+            /* the raw counts, inside the set is ITERATION_COUNT_INSIDE */
+            if (Counts)
+            {
+                __m128i Inside4 = _mm_cmpeq_epi32(UnderIterCount4, _mm_setzero_si128());
+                _mm_storeu_si128((void*)Counts, _mm_or_si128(Counter4, Inside4));
+                Counts += BitsPerIteration;
+            }
         }
 
-        Ziy4 = _mm_sub_ps(Ziy4, DeltaY4);
-        Zix4 = ZixResetValue4;
+        if (Counts)
+            Counts += Remain;
     }
 }
 
@@ -142,30 +172,26 @@ void RenderMandelbrotSet64_SSE(
     int BitsPerIteration = 2;
 
     u32 *Buffer = ColorBuffer->Ptr;
-    const __m128d DeltaX2 = _mm_set1_pd(Map->Delta*BitsPerIteration);
-    const __m128d DeltaY2 = _mm_set1_pd(Map->Delta);
+    u32 *Counts = ColorBuffer->Counts;
     const __m128d Two2 = _mm_set1_pd(2.0);
     const __m128i One2 = _mm_set1_epi64x(1);
     const __m128i IterationCount2 = _mm_set1_epi64x(IterationCount);
     const __m128i ColorPaletteSizeMask2 = _mm_set1_epi64x(STATIC_ARRAY_SIZE(ColorBuffer->Palette) - 1);
     const __m128d MaxValueSquared2 = _mm_set1_pd(MaxValue*MaxValue);
-    const __m128d ZixResetValue2 = _mm_set_pd(
-        -Map->Left + Map->Delta, 
-        -Map->Left
-    );
-    __m128d Zix2 = ZixResetValue2;
-    __m128d Ziy2 = _mm_set1_pd(Map->Top);
     int AlignedWidth = ColorBuffer->Width - (ColorBuffer->Width % BitsPerIteration);
-    int Remain = ColorBuffer->Width - AlignedWidth;
+    int Remain = ColorBuffer->Stride - AlignedWidth;
     for (int y = 0; 
              y < ColorBuffer->Height; 
              y++, 
              Buffer += Remain)
     {
+        __m128d Ziy2 = _mm_set1_pd(GetMapY(Map, y));
+
         for (int x = 0; 
                  x < AlignedWidth; 
                  x += BitsPerIteration)
         {
+            __m128d Zix2 = GetMapX2_SSE(Map, x);
             __m128d Zx2 = _mm_setzero_pd();
             __m128d Zy2 = _mm_setzero_pd();
 
@@ -227,11 +253,19 @@ LoopHead:
             Buffer[1] = _mm_extract_epi64(Color2, 1);
             Buffer += BitsPerIteration;
 
-            Zix2 = _mm_add_pd(Zix2, DeltaX2);
+            /* the raw counts, inside the set is ITERATION_COUNT_INSIDE */
+            if (Counts)
+            {
+                __m128i Inside2 = _mm_cmpeq_epi64(UnderIterCount2, _mm_setzero_si128());
+                __m128i Count2 = _mm_or_si128(Counter2, Inside2);
+                Counts[0] = (u32)_mm_extract_epi64(Count2, 0);
+                Counts[1] = (u32)_mm_extract_epi64(Count2, 1);
+                Counts += BitsPerIteration;
+            }
         }
 
-        Ziy2 = _mm_sub_pd(Ziy2, DeltaY2);
-        Zix2 = ZixResetValue2;
+        if (Counts)
+            Counts += Remain;
     }
 }
 
@@ -247,30 +281,26 @@ void RenderMandelbrotSet64_SSEFMA(
     int BitsPerIteration = 2;
 
     u32 *Buffer = ColorBuffer->Ptr;
-    const __m128d DeltaX2 = _mm_set1_pd(Map->Delta*BitsPerIteration);
-    const __m128d DeltaY2 = _mm_set1_pd(Map->Delta);
+    u32 *Counts = ColorBuffer->Counts;
     const __m128d Two2 = _mm_set1_pd(2.0);
     const __m128i One2 = _mm_set1_epi64x(1);
     const __m128i IterationCount2 = _mm_set1_epi64x(IterationCount);
     const __m128i ColorPaletteSizeMask2 = _mm_set1_epi64x(STATIC_ARRAY_SIZE(ColorBuffer->Palette) - 1);
     const __m128d MaxValueSquared2 = _mm_set1_pd(MaxValue*MaxValue);
-    const __m128d ZixResetValue2 = _mm_set_pd(
-        -Map->Left + Map->Delta, 
-        -Map->Left
-    );
-    __m128d Zix2 = ZixResetValue2;
-    __m128d Ziy2 = _mm_set1_pd(Map->Top);
     int AlignedWidth = ColorBuffer->Width - (ColorBuffer->Width % BitsPerIteration);
-    int Remain = ColorBuffer->Width - AlignedWidth;
+    int Remain = ColorBuffer->Stride - AlignedWidth;
     for (int y = 0; 
              y < ColorBuffer->Height; 
              y++, 
              Buffer += Remain)
     {
+        __m128d Ziy2 = _mm_set1_pd(GetMapY(Map, y));
+
         for (int x = 0; 
                  x < AlignedWidth; 
                  x += BitsPerIteration)
         {
+            __m128d Zix2 = GetMapX2_SSE(Map, x);
             __m128d Zx2 = _mm_setzero_pd();
             __m128d Zy2 = _mm_setzero_pd();
 
@@ -332,11 +362,19 @@ LoopHead:
             Buffer[1] = _mm_extract_epi64(Color2, 1);
             Buffer += BitsPerIteration;
 
-            Zix2 = _mm_add_pd(Zix2, DeltaX2);
+            /* the raw counts, inside the set is ITERATION_COUNT_INSIDE */
+            if (Counts)
+            {
+                __m128i Inside2 = _mm_cmpeq_epi64(UnderIterCount2, _mm_setzero_si128());
+                __m128i Count2 = _mm_or_si128(Counter2, Inside2);
+                Counts[0] = (u32)_mm_extract_epi64(Count2, 0);
+                Counts[1] = (u32)_mm_extract_epi64(Count2, 1);
+                Counts += BitsPerIteration;
+            }
         }
 
-        Ziy2 = _mm_sub_pd(Ziy2, DeltaY2);
-        Zix2 = ZixResetValue2;
+        if (Counts)
+            Counts += Remain;
     }
 }
 
@@ -352,32 +390,26 @@ void RenderMandelbrotSet32_SSEFMA(
     int BitsPerIteration = 4;
 
     u32 *Buffer = ColorBuffer->Ptr;
-    const __m128  DeltaX4 = _mm_set1_ps(Map->Delta*BitsPerIteration);
-    const __m128  DeltaY4 = _mm_set1_ps(Map->Delta);
+    u32 *Counts = ColorBuffer->Counts;
     const __m128  Two4 = _mm_set1_ps(2.0);
     const __m128i One4 = _mm_set1_epi32(1);
     const __m128i IterationCount4 = _mm_set1_epi32(IterationCount);
     const __m128i ColorPaletteSizeMask4 = _mm_set1_epi32(STATIC_ARRAY_SIZE(ColorBuffer->Palette) - 1);
     const __m128  MaxValueSquared4 = _mm_set1_ps(MaxValue*MaxValue);
-    const __m128  ZixResetValue4 = _mm_set_ps(
-        -Map->Left + 3*Map->Delta,
-        -Map->Left + 2*Map->Delta, 
-        -Map->Left + Map->Delta, 
-        -Map->Left
-    );
-    __m128 Zix4 = ZixResetValue4;
-    __m128 Ziy4 = _mm_set1_ps(Map->Top);
     int AlignedWidth = ColorBuffer->Width - (ColorBuffer->Width % BitsPerIteration);
-    int Remain = ColorBuffer->Width - AlignedWidth;
+    int Remain = ColorBuffer->Stride - AlignedWidth;
     for (int y = 0; 
              y < ColorBuffer->Height; 
              y++, 
              Buffer += Remain)
     {
+        __m128 Ziy4 = _mm_set1_ps((float)GetMapY(Map, y));
+
         for (int x = 0; 
                  x < AlignedWidth; 
                  x += BitsPerIteration)
         {
+            __m128 Zix4 = GetMapX4_SSE(Map, x);
             __m128 Zx4 = _mm_setzero_ps();
             __m128 Zy4 = _mm_setzero_ps();
 
@@ -462,11 +494,17 @@ LoopHead:
             _mm_storeu_si128((void*)Buffer, Color4);
             Buffer += BitsPerIteration;
 
-            Zix4 = _mm_add_ps(Zix4, DeltaX4);
+            /* the raw counts, inside the set is ITERATION_COUNT_INSIDE */
+            if (Counts)
+            {
+                __m128i Inside4 = _mm_cmpeq_epi32(UnderIterCount4, _mm_setzero_si128());
+                _mm_storeu_si128((void*)Counts, _mm_or_si128(Counter4, Inside4));
+                Counts += BitsPerIteration;
+            }
         }
 
-        Ziy4 = _mm_sub_ps(Ziy4, DeltaY4);
-        Zix4 = ZixResetValue4;
+        if (Counts)
+            Counts += Remain;
     }
 }
 
@@ -483,36 +521,26 @@ void RenderMandelbrotSet32_AVX(
     int BitsPerIteration = 8;
 
     u32 *Buffer = ColorBuffer->Ptr;
-    const __m256  DeltaX8 = _mm256_set1_ps(Map->Delta*BitsPerIteration);
-    const __m256  DeltaY8 = _mm256_set1_ps(Map->Delta);
+    u32 *Counts = ColorBuffer->Counts;
     const __m256  Two8 = _mm256_set1_ps(2.0);
     const __m256i One8 = _mm256_set1_epi32(1);
     const __m256i IterationCount8 = _mm256_set1_epi32(IterationCount);
     const __m256i ColorPaletteSizeMask8 = _mm256_set1_epi32(STATIC_ARRAY_SIZE(ColorBuffer->Palette) - 1);
     const __m256  MaxValueSquared8 = _mm256_set1_ps(MaxValue*MaxValue);
-    const __m256  ZixResetValue8 = _mm256_set_ps(
-        -Map->Left + 7*Map->Delta,
-        -Map->Left + 6*Map->Delta, 
-        -Map->Left + 5*Map->Delta, 
-        -Map->Left + 4*Map->Delta, 
-        -Map->Left + 3*Map->Delta,
-        -Map->Left + 2*Map->Delta, 
-        -Map->Left + Map->Delta, 
-        -Map->Left
-    );
-    __m256 Zix8 = ZixResetValue8;
-    __m256 Ziy8 = _mm256_set1_ps(Map->Top);
     int AlignedWidth = ColorBuffer->Width - (ColorBuffer->Width % BitsPerIteration);
-    int Remain = ColorBuffer->Width - AlignedWidth;
+    int Remain = ColorBuffer->Stride - AlignedWidth;
     for (int y = 0; 
              y < ColorBuffer->Height; 
              y++, 
              Buffer += Remain)
     {
+        __m256 Ziy8 = _mm256_set1_ps((float)GetMapY(Map, y));
+
         for (int x = 0; 
                  x < AlignedWidth; 
                  x += BitsPerIteration)
         {
+            __m256 Zix8 = GetMapX8_AVX(Map, x);
             /* the compiler will optimize a _mm256_set1_ps(0) to a dedicated vxorpd reg, reg, reg 
              * so we're good */
             __m256 Zx8 = _mm256_set1_ps(0);
@@ -582,11 +610,17 @@ LoopHead:
             _mm256_storeu_si256((void*)Buffer, Color8);
             Buffer += BitsPerIteration;
 
-            Zix8 = _mm256_add_ps(Zix8, DeltaX8);
+            /* the raw counts, inside the set is ITERATION_COUNT_INSIDE */
+            if (Counts)
+            {
+                __m256i Inside8 = _mm256_cmpeq_epi32(UnderIterCount8, _mm256_setzero_si256());
+                _mm256_storeu_si256((void*)Counts, _mm256_or_si256(Counter8, Inside8));
+                Counts += BitsPerIteration;
+            }
         }
 
-        Ziy8 = _mm256_sub_ps(Ziy8, DeltaY8);
-        Zix8 = ZixResetValue8;
+        if (Counts)
+            Counts += Remain;
     }
 }
 
@@ -602,34 +636,27 @@ void RenderMandelbrotSet64_AVX(
     int BitsPerIteration = 4;
 
     u32 *Buffer = ColorBuffer->Ptr;
-    const __m256d DeltaX4 = _mm256_set1_pd(Map->Delta*BitsPerIteration);
-    const __m256d DeltaY4 = _mm256_set1_pd(Map->Delta);
+    u32 *Counts = ColorBuffer->Counts;
     const __m256d Two4 = _mm256_set1_pd(2.0);
     const __m256i One4 = _mm256_set1_epi64x(1);
     const __m256i IterationCount4 = _mm256_set1_epi64x(IterationCount);
     const __m256i ColorPaletteSizeMask4 = _mm256_set1_epi64x(STATIC_ARRAY_SIZE(ColorBuffer->Palette) - 1);
     const __m256d MaxValueSquared4 = _mm256_set1_pd(MaxValue*MaxValue);
-    const __m256d ZixResetValue4 = _mm256_set_pd(
-        -Map->Left + 3*Map->Delta,
-        -Map->Left + 2*Map->Delta, 
-        -Map->Left + Map->Delta, 
-        -Map->Left
-    );
-    __m256d Zix4 = ZixResetValue4;
-    __m256d Ziy4 = _mm256_set1_pd(Map->Top);
     int AlignedWidth = ColorBuffer->Width - (ColorBuffer->Width % BitsPerIteration);
-    int Remain = ColorBuffer->Width - AlignedWidth;
+    int Remain = ColorBuffer->Stride - AlignedWidth;
 
     for (int y = 0; 
              y < ColorBuffer->Height;
              y++, 
              Buffer += Remain)
     {
+        __m256d Ziy4 = _mm256_set1_pd(GetMapY(Map, y));
 
         for (int x = 0; 
                  x < AlignedWidth; 
                  x += BitsPerIteration)
         {
+            __m256d Zix4 = GetMapX4_AVX(Map, x);
             /* the compiler will optimize a _mm256_set1_pd(0) to a dedicated vxorpd reg, reg, reg 
              * so we're good */
             __m256d Zx4 = _mm256_set1_pd(0);
@@ -700,10 +727,12 @@ LoopHead:
             );
 
             /* mask out black color */
-            __m256i A = _mm256_shuffle_epi32(UnderIterCount4, 0x88); /* [0, 2, ....]*/
-            __m256i B = _mm256_shuffle_epi32(UnderIterCount4, 0x80); /* [...., 4, 6] */
+            /* shuffle_epi32 can't cross the 128 bit lanes, so use a permute to gather the low halves */
             __m128i ColorMask4 = _mm256_castsi256_si128(
-                _mm256_blend_epi32(A, B, 0x0C)                       /* [0, 2, 4, 6] */
+                _mm256_permutevar8x32_epi32(
+                    UnderIterCount4, 
+                    _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6) /* [0, 2, 4, 6] */
+                )
             ); 
             Color4 = _mm_and_si128(Color4, ColorMask4);
 
@@ -711,11 +740,20 @@ LoopHead:
             _mm_storeu_si128((void*)Buffer, Color4);
             Buffer += BitsPerIteration;
 
-            Zix4 = _mm256_add_pd(Zix4, DeltaX4);
+            /* the raw counts, inside the set is ITERATION_COUNT_INSIDE */
+            if (Counts)
+            {
+                __m256i Inside4 = _mm256_cmpeq_epi64(UnderIterCount4, _mm256_setzero_si256());
+                __m256i Count4 = _mm256_or_si256(Counter4, Inside4);
+                _mm_storeu_si128((void*)Counts, _mm256_castsi256_si128(
+                    _mm256_permutevar8x32_epi32(Count4, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6))
+                ));
+                Counts += BitsPerIteration;
+            }
         }
 
-        Ziy4 = _mm256_sub_pd(Ziy4, DeltaY4);
-        Zix4 = ZixResetValue4;
+        if (Counts)
+            Counts += Remain;
     }
 }
 
@@ -735,36 +773,26 @@ void RenderMandelbrotSet32_AVXFMA(
     int BitsPerIteration = 8;
 
     u32 *Buffer = ColorBuffer->Ptr;
-    const __m256  DeltaX8 = _mm256_set1_ps(Map->Delta*BitsPerIteration);
-    const __m256  DeltaY8 = _mm256_set1_ps(Map->Delta);
+    u32 *Counts = ColorBuffer->Counts;
     const __m256  Two8 = _mm256_set1_ps(2.0);
     const __m256i One8 = _mm256_set1_epi32(1);
     const __m256i IterationCount8 = _mm256_set1_epi32(IterationCount);
     const __m256i ColorPaletteSizeMask8 = _mm256_set1_epi32(STATIC_ARRAY_SIZE(ColorBuffer->Palette) - 1);
     const __m256  MaxValueSquared8 = _mm256_set1_ps(MaxValue*MaxValue);
-    const __m256  ZixResetValue8 = _mm256_set_ps(
-        -Map->Left + 7*Map->Delta,
-        -Map->Left + 6*Map->Delta, 
-        -Map->Left + 5*Map->Delta, 
-        -Map->Left + 4*Map->Delta, 
-        -Map->Left + 3*Map->Delta,
-        -Map->Left + 2*Map->Delta, 
-        -Map->Left + Map->Delta, 
-        -Map->Left
-    );
-    __m256 Zix8 = ZixResetValue8;
-    __m256 Ziy8 = _mm256_set1_ps(Map->Top);
     int AlignedWidth = ColorBuffer->Width - (ColorBuffer->Width % BitsPerIteration);
-    int Remain = ColorBuffer->Width - AlignedWidth;
+    int Remain = ColorBuffer->Stride - AlignedWidth;
     for (int y = 0; 
              y < ColorBuffer->Height; 
              y++, 
              Buffer += Remain)
     {
+        __m256 Ziy8 = _mm256_set1_ps((float)GetMapY(Map, y));
+
         for (int x = 0; 
                  x < AlignedWidth; 
                  x += BitsPerIteration)
         {
+            __m256 Zix8 = GetMapX8_AVX(Map, x);
             /* the compiler will optimize a _mm256_set1_ps(0) to a dedicated vxorpd reg, reg, reg 
              * so we're good */
             __m256 Zx8 = _mm256_set1_ps(0);
@@ -831,11 +859,17 @@ LoopHead:
             _mm256_storeu_si256((void*)Buffer, Color8);
             Buffer += BitsPerIteration;
 
-            Zix8 = _mm256_add_ps(Zix8, DeltaX8);
+            /* the raw counts, inside the set is ITERATION_COUNT_INSIDE */
+            if (Counts)
+            {
+                __m256i Inside8 = _mm256_cmpeq_epi32(UnderIterCount8, _mm256_setzero_si256());
+                _mm256_storeu_si256((void*)Counts, _mm256_or_si256(Counter8, Inside8));
+                Counts += BitsPerIteration;
+            }
         }
 
-        Ziy8 = _mm256_sub_ps(Ziy8, DeltaY8);
-        Zix8 = ZixResetValue8;
+        if (Counts)
+            Counts += Remain;
     }
 }
 
@@ -850,34 +884,27 @@ void RenderMandelbrotSet64_AVXFMA(
     int BitsPerIteration = 4;
 
     u32 *Buffer = ColorBuffer->Ptr;
-    const __m256d DeltaX4 = _mm256_set1_pd(Map->Delta*BitsPerIteration);
-    const __m256d DeltaY4 = _mm256_set1_pd(Map->Delta);
+    u32 *Counts = ColorBuffer->Counts;
     const __m256d Two4 = _mm256_set1_pd(2.0);
     const __m256i One4 = _mm256_set1_epi64x(1);
     const __m256i IterationCount4 = _mm256_set1_epi64x(IterationCount);
     const __m256i ColorPaletteSizeMask4 = _mm256_set1_epi64x(STATIC_ARRAY_SIZE(ColorBuffer->Palette) - 1);
     const __m256d MaxValueSquared4 = _mm256_set1_pd(MaxValue*MaxValue);
-    const __m256d ZixResetValue4 = _mm256_set_pd(
-        -Map->Left + 3*Map->Delta,
-        -Map->Left + 2*Map->Delta, 
-        -Map->Left + Map->Delta, 
-        -Map->Left
-    );
-    __m256d Zix4 = ZixResetValue4;
-    __m256d Ziy4 = _mm256_set1_pd(Map->Top);
     int AlignedWidth = ColorBuffer->Width - (ColorBuffer->Width % BitsPerIteration);
-    int Remain = ColorBuffer->Width - AlignedWidth;
+    int Remain = ColorBuffer->Stride - AlignedWidth;
 
     for (int y = 0; 
              y < ColorBuffer->Height;
              y++, 
              Buffer += Remain)
     {
+        __m256d Ziy4 = _mm256_set1_pd(GetMapY(Map, y));
 
         for (int x = 0; 
                  x < AlignedWidth; 
                  x += BitsPerIteration)
         {
+            __m256d Zix4 = GetMapX4_AVX(Map, x);
             /* the compiler will optimize a _mm256_set1_pd(0) to a dedicated vxorpd reg, reg, reg 
              * so we're good */
             __m256d Zx4 = _mm256_set1_pd(0);
@@ -957,10 +984,12 @@ LoopHead:
             );
 
             /* mask out black color */
-            __m256i A = _mm256_shuffle_epi32(UnderIterCount4, 0x88); /* [0, 2, ....]*/
-            __m256i B = _mm256_shuffle_epi32(UnderIterCount4, 0x80); /* [...., 4, 6] */
+            /* shuffle_epi32 can't cross the 128 bit lanes, so use a permute to gather the low halves */
             __m128i ColorMask4 = _mm256_castsi256_si128(
-                _mm256_blend_epi32(A, B, 0x0C)                       /* [0, 2, 4, 6] */
+                _mm256_permutevar8x32_epi32(
+                    UnderIterCount4, 
+                    _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6) /* [0, 2, 4, 6] */
+                )
             ); 
             Color4 = _mm_and_si128(Color4, ColorMask4);
 
@@ -968,13 +997,528 @@ LoopHead:
             _mm_storeu_si128((void*)Buffer, Color4);
             Buffer += BitsPerIteration;
 
-            Zix4 = _mm256_add_pd(Zix4, DeltaX4);
+            /* the raw counts, inside the set is ITERATION_COUNT_INSIDE */
+            if (Counts)
+            {
+                __m256i Inside4 = _mm256_cmpeq_epi64(UnderIterCount4, _mm256_setzero_si256());
+                __m256i Count4 = _mm256_or_si256(Counter4, Inside4);
+                _mm_storeu_si128((void*)Counts, _mm256_castsi256_si128(
+                    _mm256_permutevar8x32_epi32(Count4, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6))
+                ));
+                Counts += BitsPerIteration;
+            }
         }
 
-        Ziy4 = _mm256_sub_pd(Ziy4, DeltaY4);
-        Zix4 = ZixResetValue4;
+        if (Counts)
+            Counts += Remain;
     }
 }
 
 
 
+
+
+void RecolorCounts_AVX(color_buffer *ColorBuffer, int FirstRow, int RowCount)
+{
+    /* processing 8 pixels at a time, the palette is small enough to gather from */
+    int BitsPerIteration = 8;
+
+    const __m256i ColorPaletteSizeMask8 = _mm256_set1_epi32(STATIC_ARRAY_SIZE(ColorBuffer->Palette) - 1);
+    const __m256i Inside8 = _mm256_set1_epi32((int)ITERATION_COUNT_INSIDE);
+    int AlignedWidth = ColorBuffer->Width - (ColorBuffer->Width % BitsPerIteration);
+    for (int y = FirstRow; y < FirstRow + RowCount; y++)
+    {
+        u32 *Buffer = ColorBuffer->Ptr + y*ColorBuffer->Stride;
+        const u32 *Counts = ColorBuffer->Counts + y*ColorBuffer->Stride;
+        for (int x = 0; x < AlignedWidth; x += BitsPerIteration)
+        {
+            __m256i Count8 = _mm256_loadu_si256((const void*)&Counts[x]);
+            __m256i Color8 = _mm256_i32gather_epi32(
+                (const int*)ColorBuffer->Palette, 
+                _mm256_and_si256(Count8, ColorPaletteSizeMask8), 
+                sizeof(u32)
+            );
+
+            /* the pixels inside the set are black */
+            Color8 = _mm256_andnot_si256(_mm256_cmpeq_epi32(Count8, Inside8), Color8);
+            _mm256_storeu_si256((void*)&Buffer[x], Color8);
+        }
+    }
+
+    /* the last few columns */
+    if (AlignedWidth < ColorBuffer->Width)
+    {
+        color_buffer Tail = *ColorBuffer;
+        Tail.Ptr += AlignedWidth;
+        Tail.Counts += AlignedWidth;
+        Tail.Width -= AlignedWidth;
+        RecolorCounts_Unopt(&Tail, FirstRow, RowCount);
+    }
+}
+
+
+
+/* 16 pixels, 32 bit each, down to 16 bit each in order, packus packs within the 128 bit lanes */
+static inline __m256i PackTo16_AVX(__m256i Lo8, __m256i Hi8)
+{
+    return _mm256_permute4x64_epi64(_mm256_packus_epi32(Lo8, Hi8), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+void PackPixels_AVX(pixel_format Format, void *Dst, const u32 *Colors, const u32 *Counts, int Count)
+{
+    /* processing 16 pixels at a time */
+    int BitsPerIteration = 16;
+    int AlignedCount = Count - (Count % BitsPerIteration);
+
+    const __m256i Inside8 = _mm256_set1_epi32((int)ITERATION_COUNT_INSIDE);
+    switch (Format)
+    {
+    case PIXEL_FORMAT_INDEX8:
+    {
+        const __m256i IndexMask8 = _mm256_set1_epi32(15);
+        const __m256i IndexInside8 = _mm256_set1_epi32(PIXEL_INDEX_INSIDE);
+        u8 *Indices = Dst;
+        for (int i = 0; i < AlignedCount; i += BitsPerIteration)
+        {
+            __m256i Count8[2];
+            for (int k = 0; k < 2; k++)
+            {
+                Count8[k] = _mm256_loadu_si256((const void*)&Counts[i + 8*k]);
+                Count8[k] = _mm256_blendv_epi8(
+                    _mm256_and_si256(Count8[k], IndexMask8), 
+                    IndexInside8, 
+                    _mm256_cmpeq_epi32(Count8[k], Inside8)
+                );
+            }
+            __m256i Index16 = PackTo16_AVX(Count8[0], Count8[1]);
+            __m128i Index = _mm_packus_epi16(_mm256_castsi256_si128(Index16), _mm256_extracti128_si256(Index16, 1));
+            _mm_storeu_si128((void*)&Indices[i], Index);
+        }
+    } break;
+
+    case PIXEL_FORMAT_COUNT16:
+    {
+        const __m256i CountMax8 = _mm256_set1_epi32(PIXEL_COUNT16_MAX);
+        const __m256i CountInside8 = _mm256_set1_epi32(PIXEL_COUNT16_INSIDE);
+        u16 *Counts16 = Dst;
+        for (int i = 0; i < AlignedCount; i += BitsPerIteration)
+        {
+            __m256i Count8[2];
+            for (int k = 0; k < 2; k++)
+            {
+                Count8[k] = _mm256_loadu_si256((const void*)&Counts[i + 8*k]);
+                Count8[k] = _mm256_blendv_epi8(
+                    _mm256_min_epu32(Count8[k], CountMax8), 
+                    CountInside8, 
+                    _mm256_cmpeq_epi32(Count8[k], Inside8)
+                );
+            }
+            _mm256_storeu_si256((void*)&Counts16[i], PackTo16_AVX(Count8[0], Count8[1]));
+        }
+    } break;
+
+    case PIXEL_FORMAT_RGB565:
+    {
+        const __m256i RedMask8 = _mm256_set1_epi32(0xF800);
+        const __m256i GreenMask8 = _mm256_set1_epi32(0x07E0);
+        const __m256i BlueMask8 = _mm256_set1_epi32(0x001F);
+        u16 *Pixels = Dst;
+        for (int i = 0; i < AlignedCount; i += BitsPerIteration)
+        {
+            __m256i Color8[2];
+            for (int k = 0; k < 2; k++)
+            {
+                __m256i Rgb8 = _mm256_loadu_si256((const void*)&Colors[i + 8*k]);
+                Color8[k] = _mm256_or_si256(
+                    _mm256_or_si256(
+                        _mm256_and_si256(_mm256_srli_epi32(Rgb8, 8), RedMask8), 
+                        _mm256_and_si256(_mm256_srli_epi32(Rgb8, 5), GreenMask8)
+                    ), 
+                    _mm256_and_si256(_mm256_srli_epi32(Rgb8, 3), BlueMask8)
+                );
+            }
+            _mm256_storeu_si256((void*)&Pixels[i], PackTo16_AVX(Color8[0], Color8[1]));
+        }
+    } break;
+
+    case PIXEL_FORMAT_RGB24:
+    {
+        /* the 3 color bytes of each pixel to the front of its lane, then the lanes next to each other */
+        const __m256i Shuffle8 = _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+        );
+        const __m256i Compact8 = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+        u8 *Bytes = Dst;
+        for (int i = 0; i < AlignedCount; i += 8)
+        {
+            __m256i Rgb8 = _mm256_loadu_si256((const void*)&Colors[i]);
+            Rgb8 = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(Rgb8, Shuffle8), Compact8);
+            _mm_storeu_si128((void*)&Bytes[3*i], _mm256_castsi256_si128(Rgb8));
+            _mm_storel_epi64((void*)&Bytes[3*i + 16], _mm256_extracti128_si256(Rgb8, 1));
+        }
+    } break;
+
+    default:
+    {
+        /* nothing to pack */
+        AlignedCount = 0;
+    } break;
+    }
+
+    /* the last few pixels */
+    int Size = GetPixelFormatSize(Format);
+    PackPixels_Unopt(
+        Format, 
+        (u8*)Dst + (size_t)AlignedCount*Size, 
+        Colors? Colors + AlignedCount : NULL, 
+        Counts? Counts + AlignedCount : NULL, 
+        Count - AlignedCount
+    );
+}
+
+
+
+/* the sum of the bytes as signed residuals, |b| for each, over the 4 lanes of 64 bit */
+static inline __m256i SumResiduals_AVX(__m256i Sum4, __m256i Residual32)
+{
+    return _mm256_add_epi64(Sum4, _mm256_sad_epu8(_mm256_abs_epi8(Residual32), _mm256_setzero_si256()));
+}
+
+static inline u64 SumLanes_AVX(__m256i Sum4)
+{
+    __m128i Sum2 = _mm_add_epi64(_mm256_castsi256_si128(Sum4), _mm256_extracti128_si256(Sum4, 1));
+    return (u64)_mm_cvtsi128_si64(Sum2) + (u64)_mm_extract_epi64(Sum2, 1);
+}
+
+void FilterPngRow_AVX(u8 *Dst, const u8 *Row, const u8 *Prior, int Size, int PixelSize)
+{
+    /* 32 bytes at a time, the first pixel has nothing to its left, that's what the unopt version is for */
+    int BytesPerIteration = 32;
+    if (Size < PixelSize + BytesPerIteration)
+    {
+        FilterPngRow_Unopt(Dst, Row, Prior, Size, PixelSize);
+        return;
+    }
+    int AlignedSize = PixelSize + (Size - PixelSize) / BytesPerIteration * BytesPerIteration;
+
+    u64 SubSum = 0, UpSum = 0;
+    for (int i = 0; i < PixelSize; i++)
+    {
+        SubSum += Row[i] < 128? Row[i] : 256 - Row[i];
+        UpSum += (u8)(Row[i] - Prior[i]) < 128? (u8)(Row[i] - Prior[i]) : 256 - (u8)(Row[i] - Prior[i]);
+    }
+    __m256i SubSum4 = _mm256_setzero_si256();
+    __m256i UpSum4 = _mm256_setzero_si256();
+    for (int i = PixelSize; i < AlignedSize; i += BytesPerIteration)
+    {
+        __m256i Row32 = _mm256_loadu_si256((const void*)&Row[i]);
+        __m256i Left32 = _mm256_loadu_si256((const void*)&Row[i - PixelSize]);
+        __m256i Prior32 = _mm256_loadu_si256((const void*)&Prior[i]);
+        SubSum4 = SumResiduals_AVX(SubSum4, _mm256_sub_epi8(Row32, Left32));
+        UpSum4 = SumResiduals_AVX(UpSum4, _mm256_sub_epi8(Row32, Prior32));
+    }
+    for (int i = AlignedSize; i < Size; i++)
+    {
+        u8 Sub = (u8)(Row[i] - Row[i - PixelSize]);
+        u8 Up = (u8)(Row[i] - Prior[i]);
+        SubSum += Sub < 128? Sub : 256 - Sub;
+        UpSum += Up < 128? Up : 256 - Up;
+    }
+    SubSum += SumLanes_AVX(SubSum4);
+    UpSum += SumLanes_AVX(UpSum4);
+
+    Bool8 Up = UpSum <= SubSum;
+    Dst[0] = Up? 2 : 1;
+    u8 *Filtered = Dst + 1;
+    for (int i = 0; i < PixelSize; i++)
+        Filtered[i] = Up? (u8)(Row[i] - Prior[i]) : Row[i];
+    for (int i = PixelSize; i < AlignedSize; i += BytesPerIteration)
+    {
+        __m256i Row32 = _mm256_loadu_si256((const void*)&Row[i]);
+        __m256i Base32 = _mm256_loadu_si256(Up? (const void*)&Prior[i] : (const void*)&Row[i - PixelSize]);
+        _mm256_storeu_si256((void*)&Filtered[i], _mm256_sub_epi8(Row32, Base32));
+    }
+    for (int i = AlignedSize; i < Size; i++)
+        Filtered[i] = (u8)(Row[i] - (Up? Prior[i] : Row[i - PixelSize]));
+}
+
+int GetMatchLength_AVX(const u8 *A, const u8 *B, int Max)
+{
+    /* 32 bytes at a time, the first one that differs is the first 0 in the mask */
+    int Length = 0;
+    for (; Length + 32 <= Max; Length += 32)
+    {
+        __m256i A32 = _mm256_loadu_si256((const void*)&A[Length]);
+        __m256i B32 = _mm256_loadu_si256((const void*)&B[Length]);
+        u32 Same = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(A32, B32));
+        if (0xFFFFFFFF != Same)
+            return Length + (int)_tzcnt_u32(~Same);
+    }
+    return Length + GetMatchLength_Unopt(A + Length, B + Length, Max - Length);
+}
+
+int CountEqualPixels_AVX(const u32 *Pixels, int Count, u32 Value)
+{
+    /* 8 pixels at a time */
+    const __m256i Value8 = _mm256_set1_epi32((int)Value);
+    int Length = 0;
+    for (; Length + 8 <= Count; Length += 8)
+    {
+        __m256i Pixels8 = _mm256_loadu_si256((const void*)&Pixels[Length]);
+        u32 Same = (u32)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(Pixels8, Value8)));
+        if (0xFF != Same)
+            return Length + (int)_tzcnt_u32(~Same);
+    }
+    return Length + CountEqualPixels_Unopt(Pixels + Length, Count - Length, Value);
+}
+
+
+
+/* 
+ * one iteration of 4 lanes with the same operations, in the same order and precision, as the kernel of Mode (6 to 9), 
+ * the f32 modes go through f32 registers, returns |Z|^2 of the new Z 
+ */
+static inline __m256d IterateLikeMode_AVX(
+    int Mode, 
+    __m256d Zx4, __m256d Zy4, 
+    __m256d Zix4, __m256d Ziy4, 
+    __m256d *NewZx4, __m256d *NewZy4
+)
+{
+    if (IsSingleMode(Mode))
+    {
+        __m128 x4 = _mm256_cvtpd_ps(Zx4);
+        __m128 y4 = _mm256_cvtpd_ps(Zy4);
+        __m128 ix4 = _mm256_cvtpd_ps(Zix4);
+        __m128 iy4 = _mm256_cvtpd_ps(Ziy4);
+        __m128 Two4 = _mm_set1_ps(2.0);
+        __m128 NewX4, NewY4, TestValue4;
+        if (8 == Mode)
+        {
+            NewX4 = _mm_sub_ps(_mm_fmadd_ps(x4, x4, ix4), _mm_mul_ps(y4, y4));
+            NewY4 = _mm_fmadd_ps(_mm_mul_ps(Two4, x4), y4, iy4);
+            TestValue4 = _mm_fmadd_ps(NewY4, NewY4, _mm_mul_ps(NewX4, NewX4));
+        }
+        else
+        {
+            NewX4 = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(x4, x4), ix4), _mm_mul_ps(y4, y4));
+            NewY4 = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(Two4, y4), x4), iy4);
+            TestValue4 = _mm_add_ps(_mm_mul_ps(NewX4, NewX4), _mm_mul_ps(NewY4, NewY4));
+        }
+        *NewZx4 = _mm256_cvtps_pd(NewX4);
+        *NewZy4 = _mm256_cvtps_pd(NewY4);
+        return _mm256_cvtps_pd(TestValue4);
+    }
+
+    const __m256d Two4 = _mm256_set1_pd(2.0);
+    if (9 == Mode)
+    {
+        *NewZx4 = _mm256_sub_pd(_mm256_fmadd_pd(Zx4, Zx4, Zix4), _mm256_mul_pd(Zy4, Zy4));
+        *NewZy4 = _mm256_fmadd_pd(_mm256_mul_pd(Two4, Zx4), Zy4, Ziy4);
+        return _mm256_fmadd_pd(*NewZy4, *NewZy4, _mm256_mul_pd(*NewZx4, *NewZx4));
+    }
+    *NewZx4 = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(Zx4, Zx4), Zix4), _mm256_mul_pd(Zy4, Zy4));
+    *NewZy4 = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(Two4, Zy4), Zx4), Ziy4);
+    return _mm256_add_pd(_mm256_mul_pd(*NewZx4, *NewZx4), _mm256_mul_pd(*NewZy4, *NewZy4));
+}
+
+/* the points the way the kernel of Mode has them, rounded to f32 for the f32 modes */
+static inline __m256d RoundLikeMode_AVX(int Mode, __m256d Value4)
+{
+    return IsSingleMode(Mode)? _mm256_cvtps_pd(_mm256_cvtpd_ps(Value4)) : Value4;
+}
+
+void ResumeMandelbrotSet64_AVX(
+    color_buffer *ColorBuffer,
+    iteration_state *State,
+    const double *PointsX, 
+    const double *PointsY,
+    int Mode,
+    int IterationCount,
+    double MaxValue
+)
+{
+    /* processing 4 pixels at a time */
+    int BitsPerIteration = 4;
+
+    const __m256i IterationCount4 = _mm256_set1_epi64x(IterationCount);
+    const __m256i ColorPaletteSizeMask4 = _mm256_set1_epi64x(STATIC_ARRAY_SIZE(ColorBuffer->Palette) - 1);
+    const __m256d MaxValueSquared4 = RoundLikeMode_AVX(Mode, _mm256_set1_pd(MaxValue*MaxValue));
+    const __m256i PackLow4 = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    int AlignedWidth = ColorBuffer->Width - (ColorBuffer->Width % BitsPerIteration);
+
+    for (int y = 0; y < ColorBuffer->Height; y++)
+    {
+        u32 *Buffer = ColorBuffer->Ptr + y*ColorBuffer->Stride;
+        double *Zxs = State->Zx + y*State->Stride;
+        double *Zys = State->Zy + y*State->Stride;
+        u32 *Counts = State->Count + y*State->Stride;
+        u8 *Escapes = State->Escaped + y*State->Stride;
+
+        __m256d Ziy4 = _mm256_set1_pd(PointsY[y]);
+        for (int x = 0; 
+                 x < AlignedWidth; 
+                 x += BitsPerIteration)
+        {
+            __m256d Zix4 = _mm256_loadu_pd(&PointsX[x]);
+            __m256d Zx4 = _mm256_loadu_pd(&Zxs[x]);
+            __m256d Zy4 = _mm256_loadu_pd(&Zys[x]);
+            __m256i Counter4 = _mm256_cvtepu32_epi64(_mm_loadu_si128((void *)&Counts[x]));
+
+            /* 4 escaped bytes -> 4 masks of 64 bits */
+            u32 EscapedBytes;
+            memcpy(&EscapedBytes, &Escapes[x], sizeof EscapedBytes);
+            __m256i Escaped4 = _mm256_cmpgt_epi64(
+                _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(EscapedBytes)), 
+                _mm256_setzero_si256()
+            );
+
+            /* Active = !Escaped & (Counter < IterationCount) */
+            __m256i Active4 = _mm256_andnot_si256(Escaped4, 
+                _mm256_cmpgt_epi64(IterationCount4, Counter4)
+            );
+            while (_mm256_movemask_epi8(Active4))
+            {
+                /* calculate the next Zx and Zy for every lane, 
+                 * but only commit them for the lanes that are still active and bounded */
+                __m256d NewZx4, NewZy4;
+                __m256d TestValue4 = IterateLikeMode_AVX(Mode, Zx4, Zy4, Zix4, Ziy4, &NewZx4, &NewZy4);
+                __m256i Bounded4 = _mm256_castpd_si256(
+                    _mm256_cmp_pd(TestValue4, MaxValueSquared4, 1) /* compare less than */
+                );
+
+                /* active lanes that went out of bound have escaped */
+                Escaped4 = _mm256_or_si256(Escaped4, _mm256_andnot_si256(Bounded4, Active4));
+
+                /* the rest moves on, masks are -1 so subtracting them increments the counter */
+                __m256i Advance4 = _mm256_and_si256(Active4, Bounded4);
+                Zx4 = _mm256_blendv_pd(Zx4, NewZx4, _mm256_castsi256_pd(Advance4));
+                Zy4 = _mm256_blendv_pd(Zy4, NewZy4, _mm256_castsi256_pd(Advance4));
+                Counter4 = _mm256_sub_epi64(Counter4, Advance4);
+
+                Active4 = _mm256_and_si256(Advance4, 
+                    _mm256_cmpgt_epi64(IterationCount4, Counter4)
+                );
+            }
+
+            /* save the state */
+            _mm256_storeu_pd(&Zxs[x], Zx4);
+            _mm256_storeu_pd(&Zys[x], Zy4);
+            _mm_storeu_si128((void *)&Counts[x], 
+                _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(Counter4, PackLow4))
+            );
+            int EscapedBits = _mm256_movemask_pd(_mm256_castsi256_pd(Escaped4));
+            Escapes[x + 0] = (EscapedBits >> 0) & 1;
+            Escapes[x + 1] = (EscapedBits >> 1) & 1;
+            Escapes[x + 2] = (EscapedBits >> 2) & 1;
+            Escapes[x + 3] = (EscapedBits >> 3) & 1;
+
+            /* only the pixels that escaped within the iteration count get a color, the others are black */
+            __m256i ColorIndex4 = _mm256_and_si256(Counter4, ColorPaletteSizeMask4);
+            __m128i Color4 = _mm_set_epi32(
+                ColorBuffer->Palette[_mm256_extract_epi64(ColorIndex4, 3)],
+                ColorBuffer->Palette[_mm256_extract_epi64(ColorIndex4, 2)],
+                ColorBuffer->Palette[_mm256_extract_epi64(ColorIndex4, 1)],
+                ColorBuffer->Palette[_mm256_extract_epi64(ColorIndex4, 0)]
+            );
+            __m256i Colored4 = _mm256_and_si256(Escaped4, _mm256_cmpgt_epi64(IterationCount4, Counter4));
+            __m128i ColorMask4 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(Colored4, PackLow4));
+            _mm_storeu_si128((void*)&Buffer[x], _mm_and_si128(Color4, ColorMask4));
+        }
+    }
+
+    /* the last few columns */
+    if (AlignedWidth < ColorBuffer->Width)
+    {
+        color_buffer Tail = *ColorBuffer;
+        Tail.Ptr += AlignedWidth;
+        Tail.Width -= AlignedWidth;
+
+        iteration_state TailState = *State;
+        TailState.Zx += AlignedWidth;
+        TailState.Zy += AlignedWidth;
+        TailState.Count += AlignedWidth;
+        TailState.Escaped += AlignedWidth;
+
+        ResumeMandelbrotSet64_Unopt(&Tail, &TailState, PointsX + AlignedWidth, PointsY, Mode, IterationCount, MaxValue);
+    }
+}
+
+
+
+void RenderPolarMandelbrotSet64_AVX(
+    color_buffer *ColorBuffer,
+    const polarmap *Map,
+    int Mode,
+    int IterationCount,
+    double MaxValue
+)
+{
+    /* processing 4 pixels at a time */
+    int BitsPerIteration = 4;
+
+    const __m256i One4 = _mm256_set1_epi64x(1);
+    const __m256i IterationCount4 = _mm256_set1_epi64x(IterationCount);
+    const __m256i ColorPaletteSizeMask4 = _mm256_set1_epi64x(STATIC_ARRAY_SIZE(ColorBuffer->Palette) - 1);
+    const __m256d MaxValueSquared4 = RoundLikeMode_AVX(Mode, _mm256_set1_pd(MaxValue*MaxValue));
+    const __m256i PackLow4 = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    const __m256d CenterX4 = _mm256_set1_pd(Map->CenterX);
+    const __m256d CenterY4 = _mm256_set1_pd(Map->CenterY);
+    int AlignedWidth = ColorBuffer->Width - (ColorBuffer->Width % BitsPerIteration);
+
+    for (int y = 0; y < ColorBuffer->Height; y++)
+    {
+        u32 *Buffer = ColorBuffer->Ptr + y*ColorBuffer->Stride;
+        const __m256d Radius4 = _mm256_set1_pd(exp(Map->LogRadius - y*Map->LogDelta));
+        for (int x = 0; 
+                 x < AlignedWidth; 
+                 x += BitsPerIteration)
+        {
+            /* the points of a row lie on a circle, so they come from the tables instead of a step */
+            __m256d Zix4 = RoundLikeMode_AVX(Mode, _mm256_add_pd(CenterX4, _mm256_mul_pd(Radius4, _mm256_loadu_pd(&Map->Cos[x]))));
+            __m256d Ziy4 = RoundLikeMode_AVX(Mode, _mm256_add_pd(CenterY4, _mm256_mul_pd(Radius4, _mm256_loadu_pd(&Map->Sin[x]))));
+            __m256d Zx4 = _mm256_setzero_pd();
+            __m256d Zy4 = _mm256_setzero_pd();
+            __m256i Counter4 = _mm256_setzero_si256();
+            __m256i UnderIterCount4;
+            __m256i FirstAndSecond4;
+            do
+            {
+                __m256d TestValue4 = IterateLikeMode_AVX(Mode, Zx4, Zy4, Zix4, Ziy4, &Zx4, &Zy4);
+                __m256i BoundedValue4 = _mm256_castpd_si256(
+                    _mm256_cmp_pd(TestValue4, MaxValueSquared4, 1) /* compare less than */
+                );
+                UnderIterCount4 = _mm256_cmpgt_epi64(IterationCount4, Counter4);
+                FirstAndSecond4 = _mm256_and_si256(BoundedValue4, UnderIterCount4);
+                Counter4 = _mm256_add_epi64(Counter4, _mm256_and_si256(FirstAndSecond4, One4));
+            } while (_mm256_movemask_epi8(FirstAndSecond4));
+
+            /* only the pixels that escaped get a color, the others are black */
+            UnderIterCount4 = _mm256_cmpgt_epi64(IterationCount4, Counter4);
+            __m256i ColorIndex4 = _mm256_and_si256(Counter4, ColorPaletteSizeMask4);
+            __m128i Color4 = _mm_set_epi32(
+                ColorBuffer->Palette[_mm256_extract_epi64(ColorIndex4, 3)],
+                ColorBuffer->Palette[_mm256_extract_epi64(ColorIndex4, 2)],
+                ColorBuffer->Palette[_mm256_extract_epi64(ColorIndex4, 1)],
+                ColorBuffer->Palette[_mm256_extract_epi64(ColorIndex4, 0)]
+            );
+            __m128i ColorMask4 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(UnderIterCount4, PackLow4));
+            _mm_storeu_si128((void*)&Buffer[x], _mm_and_si128(Color4, ColorMask4));
+        }
+    }
+
+    /* the last few columns */
+    if (AlignedWidth < ColorBuffer->Width)
+    {
+        color_buffer Tail = *ColorBuffer;
+        Tail.Ptr += AlignedWidth;
+        Tail.Width -= AlignedWidth;
+
+        polarmap TailMap = *Map;
+        TailMap.Cos += AlignedWidth;
+        TailMap.Sin += AlignedWidth;
+        RenderPolarMandelbrotSet64_Unopt(&Tail, &TailMap, Mode, IterationCount, MaxValue);
+    }
+}
+
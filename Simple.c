@@ -1,6 +1,8 @@
 
 #include "Common.h"
+#include <math.h>
 #include <stdint.h>
+#include <string.h>
 
 void RenderMandelbrotSet32_Unopt(
     color_buffer *ColorBuffer,
@@ -25,21 +27,21 @@ void RenderMandelbrotSet32_Unopt(
       */
 
      u32 *Buffer = ColorBuffer->Ptr;
+     u32 *Counts = ColorBuffer->Counts;
      float MaxValueSquared = MaxValue * MaxValue;
-     float Left = -Map->Left;
-     float Zix = Left;
-     float Ziy = Map->Top;
+     int Remain = ColorBuffer->Stride - ColorBuffer->Width;
      for (int y = 0; 
               y < ColorBuffer->Height; 
               y++, 
-              Ziy -= Map->Delta,
-              Zix = Left) 
+              Buffer += Remain) 
      {
+         /* every point straight from the map, summing up Delta would drift with where the row starts */
+         float Ziy = (float)GetMapY(Map, y);
          for (int x = 0; 
                   x < ColorBuffer->Width; 
-                  x++,
-                  Zix += Map->Delta)
+                  x++)
          {
+             float Zix = (float)GetMapX(Map, x);
              float Zx = 0;
              float Zy = 0;
 
@@ -65,7 +67,11 @@ void RenderMandelbrotSet32_Unopt(
 
              /* the final step, writing the color */
              *Buffer++ = Color;
+             if (Counts)
+                 *Counts++ = i < IterationCount? (u32)i : ITERATION_COUNT_INSIDE;
          }
+         if (Counts)
+             Counts += Remain;
      }
 }
 
@@ -77,21 +83,21 @@ void RenderMandelbrotSet64_Unopt(
 )
 {
      u32 *Buffer = ColorBuffer->Ptr;
+     u32 *Counts = ColorBuffer->Counts;
      double MaxValueSquared = MaxValue * MaxValue;
-     double Left = -Map->Left;
-     double Zix = Left;
-     double Ziy = Map->Top;
+     int Remain = ColorBuffer->Stride - ColorBuffer->Width;
      for (int y = 0; 
               y < ColorBuffer->Height; 
               y++, 
-              Ziy -= Map->Delta,
-              Zix = Left) 
+              Buffer += Remain) 
      {
+         /* every point straight from the map, summing up Delta would drift with where the row starts */
+         double Ziy = GetMapY(Map, y);
          for (int x = 0; 
                   x < ColorBuffer->Width; 
-                  x++,
-                  Zix += Map->Delta)
+                  x++)
          {
+             double Zix = GetMapX(Map, x);
              double Zx = 0;
              double Zy = 0;
              int i;
@@ -112,8 +118,297 @@ void RenderMandelbrotSet64_Unopt(
                  Color = ColorBuffer->Palette[ColorIndex];
              }
              *Buffer++ = Color;
+             if (Counts)
+                 *Counts++ = i < IterationCount? (u32)i : ITERATION_COUNT_INSIDE;
          }
+         if (Counts)
+             Counts += Remain;
      }
 }
 
 
+
+void RecolorCounts_Unopt(color_buffer *ColorBuffer, int FirstRow, int RowCount)
+{
+     for (int y = FirstRow; y < FirstRow + RowCount; y++)
+     {
+         u32 *Buffer = ColorBuffer->Ptr + y*ColorBuffer->Stride;
+         const u32 *Counts = ColorBuffer->Counts + y*ColorBuffer->Stride;
+         for (int x = 0; x < ColorBuffer->Width; x++)
+         {
+             u32 Count = Counts[x];
+             Buffer[x] = ITERATION_COUNT_INSIDE == Count
+                 ? 0
+                 : ColorBuffer->Palette[Count % STATIC_ARRAY_SIZE(ColorBuffer->Palette)];
+         }
+     }
+}
+
+void PackPixels_Unopt(pixel_format Format, void *Dst, const u32 *Colors, const u32 *Counts, int Count)
+{
+    switch (Format)
+    {
+    case PIXEL_FORMAT_RGB32:
+    {
+        memcpy(Dst, Colors, Count * sizeof *Colors);
+    } break;
+
+    case PIXEL_FORMAT_INDEX8:
+    {
+        u8 *Indices = Dst;
+        for (int i = 0; i < Count; i++)
+        {
+            Indices[i] = ITERATION_COUNT_INSIDE == Counts[i]
+                ? PIXEL_INDEX_INSIDE
+                : (u8)(Counts[i] % 16);
+        }
+    } break;
+
+    case PIXEL_FORMAT_COUNT16:
+    {
+        u16 *Counts16 = Dst;
+        for (int i = 0; i < Count; i++)
+        {
+            Counts16[i] = ITERATION_COUNT_INSIDE == Counts[i]
+                ? PIXEL_COUNT16_INSIDE
+                : (u16)MIN(Counts[i], PIXEL_COUNT16_MAX);
+        }
+    } break;
+
+    case PIXEL_FORMAT_RGB565:
+    {
+        u16 *Pixels = Dst;
+        for (int i = 0; i < Count; i++)
+        {
+            u32 Color = Colors[i];
+            Pixels[i] = (u16)(((Color >> 8) & 0xF800) | ((Color >> 5) & 0x07E0) | ((Color >> 3) & 0x001F));
+        }
+    } break;
+
+    case PIXEL_FORMAT_RGB24:
+    {
+        u8 *Bytes = Dst;
+        for (int i = 0; i < Count; i++)
+        {
+            Bytes[3*i + 0] = (u8)(Colors[i] >> 16);
+            Bytes[3*i + 1] = (u8)(Colors[i] >> 8);
+            Bytes[3*i + 2] = (u8)Colors[i];
+        }
+    } break;
+
+    default: break;
+    }
+}
+
+void FilterPngRow_Unopt(u8 *Dst, const u8 *Row, const u8 *Prior, int Size, int PixelSize)
+{
+    /* the residuals as signed bytes, the smaller they add up to the better they compress */
+    u32 SubSum = 0, UpSum = 0;
+    for (int i = 0; i < Size; i++)
+    {
+        i8 Sub = (i8)(Row[i] - (i >= PixelSize? Row[i - PixelSize] : 0));
+        i8 Up = (i8)(Row[i] - Prior[i]);
+        SubSum += Sub < 0? -Sub : Sub;
+        UpSum += Up < 0? -Up : Up;
+    }
+
+    if (UpSum <= SubSum)
+    {
+        Dst[0] = 2;
+        for (int i = 0; i < Size; i++)
+            Dst[1 + i] = (u8)(Row[i] - Prior[i]);
+    }
+    else
+    {
+        Dst[0] = 1;
+        for (int i = 0; i < Size; i++)
+            Dst[1 + i] = (u8)(Row[i] - (i >= PixelSize? Row[i - PixelSize] : 0));
+    }
+}
+
+int GetMatchLength_Unopt(const u8 *A, const u8 *B, int Max)
+{
+    int Length = 0;
+    while (Length < Max && A[Length] == B[Length])
+        Length++;
+    return Length;
+}
+
+int CountEqualPixels_Unopt(const u32 *Pixels, int Count, u32 Value)
+{
+    int Length = 0;
+    while (Length < Count && Pixels[Length] == Value)
+        Length++;
+    return Length;
+}
+
+
+
+/* 
+ * one iteration from (Zx, Zy) with the same operations, in the same order and precision, as the kernel of Mode, 
+ * so that the kernels which stand in for it end up on the same Z, returns |Z|^2 of the new one 
+ */
+static double IterateLikeMode_Unopt(int Mode, double Zx, double Zy, double Zix, double Ziy, double *NewZx, double *NewZy)
+{
+    float x = (float)Zx, y = (float)Zy, ix = (float)Zix, iy = (float)Ziy;
+    switch (Mode)
+    {
+    case 0:
+    {
+        float Tmp = x*x - y*y + ix;
+        y = 2.0*y*x + iy;
+        x = Tmp;
+        *NewZx = x;
+        *NewZy = y;
+        return x*x + y*y;
+    }
+    case 1:
+        *NewZx = Zx*Zx - Zy*Zy + Zix;
+        *NewZy = 2.0*Zy*Zx + Ziy;
+        break;
+    case 2:
+    case 6:
+    {
+        float Tmp = (x*x + ix) - y*y;
+        y = 2*y*x + iy;
+        x = Tmp;
+        *NewZx = x;
+        *NewZy = y;
+        return x*x + y*y;
+    }
+    case 4:
+    case 8:
+    {
+        float Tmp = fmaf(x, x, ix) - y*y;
+        y = 4 == Mode
+            ? fmaf(2, x*y, iy)
+            : fmaf(2*x, y, iy);
+        x = Tmp;
+        *NewZx = x;
+        *NewZy = y;
+        return fmaf(y, y, x*x);
+    }
+    case 5:
+    case 9:
+        *NewZx = fma(Zx, Zx, Zix) - Zy*Zy;
+        *NewZy = 5 == Mode
+            ? fma(2, Zy*Zx, Ziy)
+            : fma(2*Zx, Zy, Ziy);
+        return fma(*NewZy, *NewZy, *NewZx * *NewZx);
+    default:
+        *NewZx = (Zx*Zx + Zix) - Zy*Zy;
+        *NewZy = 2*Zy*Zx + Ziy;
+        break;
+    }
+    return *NewZx * *NewZx + *NewZy * *NewZy;
+}
+
+/* a point of the plane the way the kernel of Mode has it, rounded to f32 for the f32 modes */
+static double RoundLikeMode(int Mode, double Value)
+{
+    return IsSingleMode(Mode)? (float)Value : Value;
+}
+
+void ResumeMandelbrotSet64_Unopt(
+    color_buffer *ColorBuffer,
+    iteration_state *State,
+    const double *PointsX, 
+    const double *PointsY,
+    int Mode,
+    int IterationCount, 
+    double MaxValue
+)
+{
+     double MaxValueSquared = RoundLikeMode(Mode, MaxValue * MaxValue);
+     u32 MaxCount = IterationCount;
+     u32 CountBias = GetModeCountBias(Mode);
+     for (int y = 0; y < ColorBuffer->Height; y++)
+     {
+         double Ziy = PointsY[y];
+         u32 *Buffer = ColorBuffer->Ptr + y*ColorBuffer->Stride;
+         double *Zxs = State->Zx + y*State->Stride;
+         double *Zys = State->Zy + y*State->Stride;
+         u32 *Counts = State->Count + y*State->Stride;
+         u8 *Escapes = State->Escaped + y*State->Stride;
+         for (int x = 0; x < ColorBuffer->Width; x++)
+         {
+             double Zix = PointsX[x];
+             double Zx = Zxs[x];
+             double Zy = Zys[x];
+             u32 i = Counts[x];
+             u8 Escaped = Escapes[x];
+
+             /* only commit Z when it's still bounded, so the next call can pick up from here */
+             while (!Escaped && i < MaxCount)
+             {
+                 double NewZx, NewZy;
+                 if (IterateLikeMode_Unopt(Mode, Zx, Zy, Zix, Ziy, &NewZx, &NewZy) >= MaxValueSquared)
+                 {
+                     Escaped = true;
+                 }
+                 else
+                 {
+                     Zx = NewZx;
+                     Zy = NewZy;
+                     i++;
+                 }
+             }
+
+             Zxs[x] = Zx;
+             Zys[x] = Zy;
+             Counts[x] = i;
+             Escapes[x] = Escaped;
+
+             u32 Color = 0;
+             if (Escaped && i + CountBias < MaxCount)
+             {
+                 int ColorIndex = (i + CountBias) % STATIC_ARRAY_SIZE(ColorBuffer->Palette);
+                 Color = ColorBuffer->Palette[ColorIndex];
+             }
+             Buffer[x] = Color;
+         }
+     }
+}
+
+
+
+void RenderPolarMandelbrotSet64_Unopt(
+    color_buffer *ColorBuffer,
+    const polarmap *Map,
+    int Mode,
+    int IterationCount,
+    double MaxValue
+)
+{
+     /* counts the iterations that stayed bounded, like the simd kernels, 
+      * so the avx kernel can hand it its last columns, the bias turns that into the count of the mode */
+     double MaxValueSquared = RoundLikeMode(Mode, MaxValue * MaxValue);
+     int CountBias = GetModeCountBias(Mode);
+     for (int y = 0; y < ColorBuffer->Height; y++)
+     {
+         double Radius = exp(Map->LogRadius - y*Map->LogDelta);
+         u32 *Buffer = ColorBuffer->Ptr + y*ColorBuffer->Stride;
+         for (int x = 0; x < ColorBuffer->Width; x++)
+         {
+             double Zix = RoundLikeMode(Mode, Map->CenterX + Radius*Map->Cos[x]);
+             double Ziy = RoundLikeMode(Mode, Map->CenterY + Radius*Map->Sin[x]);
+             double Zx = 0;
+             double Zy = 0;
+             int i = 0;
+             while (i < IterationCount)
+             {
+                 if (IterateLikeMode_Unopt(Mode, Zx, Zy, Zix, Ziy, &Zx, &Zy) >= MaxValueSquared)
+                     break;
+                 i++;
+             }
+
+             u32 Color = 0;
+             if (i + CountBias < IterationCount)
+             {
+                 int ColorIndex = (i + CountBias) % STATIC_ARRAY_SIZE(ColorBuffer->Palette);
+                 Color = ColorBuffer->Palette[ColorIndex];
+             }
+             Buffer[x] = Color;
+         }
+     }
+}
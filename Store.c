@@ -0,0 +1,363 @@
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Common.h"
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/file.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif /* _WIN32 */
+
+/*
+ * Tile store:
+ * an append-only file of rendered tiles that is memory mapped,
+ *
+ *     [tile_store_header][record 0][record 1]...[record RecordCount - 1][preallocated space]
+ *
+ * a record is its tile_key followed by the TILE_SIZE*TILE_SIZE pixels,
+ * Committed is written after the pixels, and RecordCount after that,
+ * so a record that was cut off halfway is never picked up.
+ * The index (key -> record) is an open addressing hash table that only lives in memory,
+ * it's rebuilt from the records whenever the store is opened.
+ * The file is locked while it's open, so only one process uses it at a time.
+ */
+
+#define TILE_STORE_MAGIC 0x53544253 /* "SBTS" */
+#define TILE_STORE_VERSION 2
+#define TILE_STORE_COMMITTED 0x434F4D54 /* "COMT" */
+#define TILE_STORE_EMPTY_SLOT (-1)
+
+typedef struct tile_store_header
+{
+    u32 Magic;
+    u32 Version;
+    u32 TileSize;
+    u32 RecordSize;
+    u64 RecordCount;
+    u8 Reserved[40];
+    u32 Palette[16];
+} tile_store_header;
+
+typedef struct tile_store_record
+{
+    /* the key, spelled out with fixed size fields so the layout doesn't depend on the compiler */
+    i32 Level;
+    i32 IterationCount;
+    i64 TileX, TileY;
+    i32 Mode;
+    i32 Method;
+    i32 Formula;
+    u32 Committed;
+    u8 Reserved[24];
+    u32 Pixels[TILE_SIZE * TILE_SIZE];
+} tile_store_record;
+
+static u64 TileStoreFileSize(u64 RecordCapacity)
+{
+    return sizeof(tile_store_header) + RecordCapacity * sizeof(tile_store_record);
+}
+
+static tile_store_header *TileStoreHeader(tile_store *Store)
+{
+    return (tile_store_header *)Store->Base;
+}
+
+static tile_store_record *TileStoreRecord(tile_store *Store, u64 Index)
+{
+    return (tile_store_record *)(Store->Base + sizeof(tile_store_header)) + Index;
+}
+
+static tile_key TileStoreRecordKey(const tile_store_record *Record)
+{
+    tile_key Key = {
+        .Level = Record->Level,
+        .TileX = Record->TileX,
+        .TileY = Record->TileY,
+        .IterationCount = Record->IterationCount,
+        .Mode = Record->Mode,
+        .Method = (render_method)Record->Method,
+        .Formula = Record->Formula,
+    };
+    return Key;
+}
+
+
+#ifdef _WIN32
+
+static Bool8 TileStoreOpenFile(tile_store *Store, const char *Path, u64 *FileSize)
+{
+    /* no sharing, the store belongs to this process until it's closed */
+    Store->File = CreateFileA(Path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == Store->File)
+        return false;
+
+    LARGE_INTEGER Size;
+    if (!GetFileSizeEx(Store->File, &Size))
+        return false;
+    *FileSize = Size.QuadPart;
+    return true;
+}
+
+static void TileStoreUnmap(tile_store *Store)
+{
+    if (Store->Base)
+        UnmapViewOfFile(Store->Base);
+    if (Store->Mapping)
+        CloseHandle(Store->Mapping);
+    Store->Base = NULL;
+    Store->Mapping = NULL;
+}
+
+/* grows the file to Size if it's smaller, then maps all of it */
+static Bool8 TileStoreMap(tile_store *Store, u64 Size)
+{
+    TileStoreUnmap(Store);
+    Store->Mapping = CreateFileMappingA(Store->File, NULL, PAGE_READWRITE, (DWORD)(Size >> 32), (DWORD)Size, NULL);
+    if (NULL == Store->Mapping)
+        return false;
+
+    Store->Base = MapViewOfFile(Store->Mapping, FILE_MAP_ALL_ACCESS, 0, 0, Size);
+    Store->MappedSize = Size;
+    return NULL != Store->Base;
+}
+
+static void TileStoreCloseFile(tile_store *Store)
+{
+    if (Store->File && INVALID_HANDLE_VALUE != Store->File)
+        CloseHandle(Store->File);
+    Store->File = NULL;
+}
+
+#else
+
+static Bool8 TileStoreOpenFile(tile_store *Store, const char *Path, u64 *FileSize)
+{
+    Store->File = open(Path, O_RDWR | O_CREAT, 0644);
+    if (Store->File < 0)
+        return false;
+
+    /* the store belongs to this process until it's closed */
+    if (flock(Store->File, LOCK_EX | LOCK_NB) < 0)
+        return false;
+
+    struct stat Stat;
+    if (fstat(Store->File, &Stat) < 0)
+        return false;
+    *FileSize = Stat.st_size;
+    return true;
+}
+
+static void TileStoreUnmap(tile_store *Store)
+{
+    if (Store->Base)
+        munmap(Store->Base, Store->MappedSize);
+    Store->Base = NULL;
+}
+
+/* grows the file to Size if it's smaller, then maps all of it */
+static Bool8 TileStoreMap(tile_store *Store, u64 Size)
+{
+    TileStoreUnmap(Store);
+
+    struct stat Stat;
+    if (fstat(Store->File, &Stat) < 0)
+        return false;
+    if ((u64)Stat.st_size < Size && ftruncate(Store->File, Size) < 0)
+        return false;
+
+    void *Base = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_SHARED, Store->File, 0);
+    if (MAP_FAILED == Base)
+        return false;
+
+    Store->Base = Base;
+    Store->MappedSize = Size;
+    return true;
+}
+
+static void TileStoreCloseFile(tile_store *Store)
+{
+    if (Store->File >= 0)
+        close(Store->File);
+    Store->File = -1;
+}
+
+#endif /* _WIN32 */
+
+
+static Bool8 TileStoreIndexInsert(tile_store *Store, u64 RecordIndex);
+
+/* (re)builds the index with room for at least RecordCapacity records at a load factor of 1/2 */
+static Bool8 TileStoreRebuildIndex(tile_store *Store, u64 RecordCapacity)
+{
+    u64 SlotCount = 64;
+    while (SlotCount < 2*RecordCapacity)
+        SlotCount *= 2;
+
+    i64 *Slots = malloc(SlotCount * sizeof *Slots);
+    if (NULL == Slots)
+        return false;
+
+    free(Store->Slots);
+    Store->Slots = Slots;
+    Store->SlotCount = SlotCount;
+    for (u64 i = 0; i < SlotCount; i++)
+        Store->Slots[i] = TILE_STORE_EMPTY_SLOT;
+
+    u64 RecordCount = TileStoreHeader(Store)->RecordCount;
+    for (u64 i = 0; i < RecordCount; i++)
+    {
+        if (TILE_STORE_COMMITTED == TileStoreRecord(Store, i)->Committed)
+            TileStoreIndexInsert(Store, i);
+    }
+    return true;
+}
+
+static Bool8 TileStoreIndexInsert(tile_store *Store, u64 RecordIndex)
+{
+    tile_key Key = TileStoreRecordKey(TileStoreRecord(Store, RecordIndex));
+    u64 Mask = Store->SlotCount - 1;
+    for (u64 Slot = HashTileKey(&Key) & Mask; ; Slot = (Slot + 1) & Mask)
+    {
+        if (TILE_STORE_EMPTY_SLOT == Store->Slots[Slot])
+        {
+            Store->Slots[Slot] = RecordIndex;
+            return true;
+        }
+
+        /* a newer record of the same tile replaces the old one */
+        tile_key Other = TileStoreRecordKey(TileStoreRecord(Store, Store->Slots[Slot]));
+        if (TileKeyEqual(&Key, &Other))
+        {
+            Store->Slots[Slot] = RecordIndex;
+            return true;
+        }
+    }
+}
+
+Bool8 TileStoreOpen(tile_store *Store, const char *Path, const u32 Palette[16])
+{
+    memset(Store, 0, sizeof *Store);
+#ifndef _WIN32
+    Store->File = -1;
+#endif /* _WIN32 */
+
+    u64 FileSize;
+    if (!TileStoreOpenFile(Store, Path, &FileSize))
+        goto Failed;
+
+    Bool8 IsNew = FileSize < sizeof(tile_store_header);
+    /* at least 64 records, a file cut short (by a full disk, or a copy that stopped) can hold less than one */
+    u64 Capacity = IsNew
+        ? 64
+        : MAX(64, (FileSize - sizeof(tile_store_header)) / sizeof(tile_store_record));
+    if (!TileStoreMap(Store, TileStoreFileSize(Capacity)))
+        goto Failed;
+    Store->RecordCapacity = Capacity;
+
+    /* the colors are baked into the tiles, a store made with another palette (or another layout) is no good */
+    tile_store_header *Header = TileStoreHeader(Store);
+    if (IsNew
+    || TILE_STORE_MAGIC != Header->Magic
+    || TILE_STORE_VERSION != Header->Version
+    || TILE_SIZE != Header->TileSize
+    || sizeof(tile_store_record) != Header->RecordSize
+    || Header->RecordCount > Capacity
+    || 0 != memcmp(Header->Palette, Palette, sizeof Header->Palette))
+    {
+        memset(Header, 0, sizeof *Header);
+        Header->Magic = TILE_STORE_MAGIC;
+        Header->Version = TILE_STORE_VERSION;
+        Header->TileSize = TILE_SIZE;
+        Header->RecordSize = sizeof(tile_store_record);
+        memcpy(Header->Palette, Palette, sizeof Header->Palette);
+    }
+
+    if (!TileStoreRebuildIndex(Store, Capacity))
+        goto Failed;
+    return true;
+
+Failed:
+    TileStoreClose(Store);
+    return false;
+}
+
+void TileStoreClose(tile_store *Store)
+{
+    TileStoreUnmap(Store);
+    TileStoreCloseFile(Store);
+    free(Store->Slots);
+    Store->Slots = NULL;
+    Store->SlotCount = 0;
+}
+
+const u32 *TileStoreLookup(tile_store *Store, const tile_key *Key)
+{
+    if (NULL == Store->Base)
+        return NULL;
+
+    u64 Mask = Store->SlotCount - 1;
+    for (u64 Slot = HashTileKey(Key) & Mask; ; Slot = (Slot + 1) & Mask)
+    {
+        i64 RecordIndex = Store->Slots[Slot];
+        if (TILE_STORE_EMPTY_SLOT == RecordIndex)
+            return NULL;
+
+        tile_store_record *Record = TileStoreRecord(Store, RecordIndex);
+        tile_key Other = TileStoreRecordKey(Record);
+        if (TileKeyEqual(Key, &Other))
+            return Record->Pixels;
+    }
+}
+
+Bool8 TileStorePut(tile_store *Store, const tile_key *Key, const u32 *Pixels)
+{
+    if (NULL == Store->Base)
+        return false;
+
+    u64 Index = TileStoreHeader(Store)->RecordCount;
+    if (Index == Store->RecordCapacity)
+    {
+        /* double the file, the mapping moves so every pointer from TileStoreLookup goes stale */
+        u64 Capacity = MAX(64, 2*Store->RecordCapacity);
+        if (!TileStoreMap(Store, TileStoreFileSize(Capacity)))
+        {
+            TileStoreClose(Store);
+            return false;
+        }
+        Store->RecordCapacity = Capacity;
+        if (!TileStoreRebuildIndex(Store, Capacity))
+        {
+            TileStoreClose(Store);
+            return false;
+        }
+    }
+
+    tile_store_record *Record = TileStoreRecord(Store, Index);
+    memset(Record, 0, offsetof(tile_store_record, Pixels));
+    Record->Level = Key->Level;
+    Record->IterationCount = Key->IterationCount;
+    Record->TileX = Key->TileX;
+    Record->TileY = Key->TileY;
+    Record->Mode = Key->Mode;
+    Record->Method = Key->Method;
+    Record->Formula = Key->Formula;
+    memcpy(Record->Pixels, Pixels, sizeof Record->Pixels);
+
+    /* commit: the record first, then the count */
+    Record->Committed = TILE_STORE_COMMITTED;
+    TileStoreHeader(Store)->RecordCount = Index + 1;
+    TileStoreIndexInsert(Store, Index);
+    return true;
+}
+
+u64 TileStoreCount(tile_store *Store)
+{
+    return Store->Base? TileStoreHeader(Store)->RecordCount : 0;
+}
+
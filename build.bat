@@ -33,10 +33,17 @@ if "clean"=="%1" (
         pushd bin
             cl /Zi /O2 "/Fe%NAME%.exe" "%SRC_DIR%\build.c" ^
                 /link user32.lib kernel32.lib gdi32.lib
+            cl /O2 /LD /DSIMDBROT_SHARED /DSIMDBROT_BUILD "/Fe%NAME%.dll" "%SRC_DIR%\build_lib.c"
+            REM the dll's import library is already simdbrot.lib, the static one is libsimdbrot.lib
+            cl /O2 /c /DSIMDBROT_BUILD "/Folib%NAME%.obj" "%SRC_DIR%\build_lib.c"
+            lib /nologo "/OUT:lib%NAME%.lib" "lib%NAME%.obj"
         popd 
     ) else (
         %CC% %CC_FLAGS% -Wall -Wextra -Wpedantic -o "bin\%NAME%" "%SRC_DIR%\build.c" %LD_FLAGS%^
             -luser32 -lkernel32 -lgdi32
+        %CC% %CC_FLAGS% -shared -DSIMDBROT_SHARED -DSIMDBROT_BUILD -o "bin\%NAME%.dll" "%SRC_DIR%\build_lib.c"
+        %CC% %CC_FLAGS% -DSIMDBROT_BUILD -c -o "bin\lib%NAME%.o" "%SRC_DIR%\build_lib.c"
+        ar rcs "bin\lib%NAME%.a" "bin\lib%NAME%.o"
     )
 
 
@@ -2,6 +2,10 @@
 #include "Common.h"
 
 #include "main.c"
+#include "Engine.c"
+#include "Render.c"
+#include "Cache.c"
+#include "Store.c"
 #include "Simple.c"
 #include "Simd.c"
 
@@ -0,0 +1,63 @@
+#!/bin/sh
+
+# builds the headless front-end, the library (static and shared), and the X11 one when the X11 headers are there,
+# the win32 one only builds on windows (build.bat)
+
+CC="${CC:-gcc}"
+CC_FLAGS="-march=x86-64-v3 -O3 -mavx2 -mfma -D_DEFAULT_SOURCE -std=c11 -Wall -Wextra -Wpedantic"
+LD_FLAGS="-lpthread -lm"
+NAME="simdbrot"
+SRC_DIR="$(cd "$(dirname "$0")" && pwd)"
+
+if [ "clean" = "$1" ]; then
+
+    # remove the build directory (if exist)
+    if [ -d bin ]; then
+        rm -rf bin
+        echo
+        echo "        Removed build directory and binary"
+        echo
+    else
+        echo
+        echo "        No build directory was created in the first place"
+        echo
+    fi
+else
+    mkdir -p bin
+
+    if ! $CC $CC_FLAGS -o "bin/$NAME" "$SRC_DIR/build_cli.c" $LD_FLAGS; then
+        echo
+        echo "        Build failed"
+        echo
+        exit 1
+    fi
+
+    # only the Simdbrot functions of simdbrot.h are visible, in the static library too
+    if ! $CC $CC_FLAGS -fPIC -fvisibility=hidden -DSIMDBROT_BUILD -c -o "bin/lib$NAME.o" "$SRC_DIR/build_lib.c" \
+    || ! objcopy --localize-hidden "bin/lib$NAME.o" \
+    || ! ar rcs "bin/lib$NAME.a" "bin/lib$NAME.o" \
+    || ! $CC -shared -o "bin/lib$NAME.so" "bin/lib$NAME.o" $LD_FLAGS; then
+        echo
+        echo "        Build failed"
+        echo
+        exit 1
+    fi
+    rm -f "bin/lib$NAME.o"
+
+    # a render node doesn't need (or have) X11
+    if echo "#include <X11/extensions/XShm.h>" | $CC -E - > /dev/null 2>&1; then
+        if ! $CC $CC_FLAGS -o "bin/$NAME-x11" "$SRC_DIR/build_x11.c" $LD_FLAGS -lX11 -lXext; then
+            echo
+            echo "        Build failed"
+            echo
+            exit 1
+        fi
+    else
+        echo
+        echo "        No X11 headers, skipped $NAME-x11"
+    fi
+
+    echo
+    echo "        Build finished"
+    echo
+fi
@@ -0,0 +1,15 @@
+
+#include "Common.h"
+
+#include "cli.c"
+#include "Engine.c"
+#include "ExpMap.c"
+#include "Encoder.c"
+#include "Server.c"
+#include "Cluster.c"
+#include "Image.c"
+#include "Render.c"
+#include "Cache.c"
+#include "Store.c"
+#include "Simple.c"
+#include "Simd.c"
@@ -0,0 +1,10 @@
+
+#include "Common.h"
+
+#include "lib.c"
+#include "Engine.c"
+#include "Render.c"
+#include "Cache.c"
+#include "Store.c"
+#include "Simple.c"
+#include "Simd.c"
@@ -0,0 +1,12 @@
+
+#include "Common.h"
+
+#include "x11_main.c"
+#include "Engine.c"
+#include "ExpMap.c"
+#include "Image.c"
+#include "Render.c"
+#include "Cache.c"
+#include "Store.c"
+#include "Simple.c"
+#include "Simd.c"
@@ -0,0 +1,74 @@
+#!/bin/sh
+
+# renders the same images in ways that have to give the same bytes and compares them,
+# run ./build.sh first, every check prints ok, FAILED or skipped and the script fails when one failed
+
+NAME="simdbrot"
+SRC_DIR="$(cd "$(dirname "$0")" && pwd)"
+BIN="$SRC_DIR/bin/$NAME"
+TMP_DIR="$(mktemp -d)"
+FAILED=0
+WORKER_PIDS=""
+
+cleanup()
+{
+    for PID in $WORKER_PIDS; do
+        kill "$PID" 2> /dev/null
+    done
+    rm -rf "$TMP_DIR"
+}
+trap cleanup EXIT
+
+if [ ! -x "$BIN" ]; then
+    echo
+    echo "        No $BIN, run ./build.sh first"
+    echo
+    exit 1
+fi
+
+# compare NAME A.ppm B.ppm
+compare()
+{
+    if cmp -s "$2" "$3"; then
+        echo "        ok      $1"
+    else
+        echo "        FAILED  $1"
+        FAILED=1
+    fi
+}
+
+# a render on workers is the same as the one here, a tile at a time on other processes
+"$BIN" --worker "unix:$TMP_DIR/worker.sock" > /dev/null 2>&1 &
+WORKER_PIDS="$WORKER_PIDS $!"
+"$BIN" --worker 127.0.0.1:7711 > /dev/null 2>&1 &
+WORKER_PIDS="$WORKER_PIDS $!"
+sleep 1
+
+VIEW="-s 2000x1500 -c -0.745 0.11 -v 0.05 -i 800"
+for OPTIONS in "" "-f index8" "-f rgb24" "-f count16" "--supersample" "-m 0" "--band-height 100"; do
+    rm -f "$TMP_DIR/local.ppm" "$TMP_DIR/workers.ppm"
+    "$BIN" $VIEW $OPTIONS -o "$TMP_DIR/local.ppm" > /dev/null 2>&1
+    "$BIN" $VIEW $OPTIONS --workers "unix:$TMP_DIR/worker.sock,127.0.0.1:7711" -o "$TMP_DIR/workers.ppm" > /dev/null 2>&1
+    compare "local vs workers $OPTIONS" "$TMP_DIR/local.ppm" "$TMP_DIR/workers.ppm"
+done
+
+# the X11 front-end shows the same image as the headless one, on a virtual display
+if [ ! -x "$BIN-x11" ]; then
+    echo "        skipped X11 vs headless, no $NAME-x11"
+elif ! command -v xvfb-run > /dev/null 2>&1; then
+    echo "        skipped X11 vs headless, no xvfb-run (Xvfb)"
+else
+    rm -f "$TMP_DIR/x11.ppm" "$TMP_DIR/headless.ppm"
+    xvfb-run -a -s "-screen 0 640x480x24" "$BIN-x11" -s 320x240 --frames 30 -o "$TMP_DIR/x11.ppm" > /dev/null 2>&1
+    "$BIN" -s 320x240 -c -0.6666666666666667 0 -v 2 -o "$TMP_DIR/headless.ppm" > /dev/null 2>&1
+    compare "X11 vs headless" "$TMP_DIR/x11.ppm" "$TMP_DIR/headless.ppm"
+fi
+
+echo
+if [ 0 != $FAILED ]; then
+    echo "        Check failed"
+    echo
+    exit 1
+fi
+echo "        Check finished"
+echo
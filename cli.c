@@ -0,0 +1,785 @@
+
+#include <ctype.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#  include <fcntl.h>
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif /* _WIN32 */
+
+#include "Common.h"
+
+/*
+ * Headless front-end:
+ * renders one view with the render engine and writes it to an image file,
+ * everything it needs comes from the command line.
+ * The image is rendered in bands that are written out as soon as they're done,
+ * so a poster far bigger than memory only ever needs one band of it.
+ *
+ * The rows that are in the file are also a checkpoint:
+ * every so often the file is flushed to disk and a manifest next to it (FILE.resume) records
+ * the options of the render and how many rows are done,
+ * a render that was killed (or stopped with ctrl-c/SIGTERM) then carries on from there with --resume.
+ * A .png or .qoi file is encoded a band at a time instead (see Encoder.c), those can't be resumed.
+ *
+ * With --zoom-to it renders a zoom from the view to another one instead, and writes the frames as y4m video,
+ * each frame starts from the one before it and only renders what it couldn't take from there,
+ * or with --exp-map every frame is resampled from an exponential map (see ExpMap.c) that is rendered once.
+ *
+ * With --serve it writes no file, it serves png tiles of the set over http on localhost instead (see Server.c).
+ * With --workers the bands are rendered by worker processes (simdbrot --worker) instead of this one (see Cluster.c),
+ * everything else stays the same, checkpoints and all.
+ */
+
+/* how many pixels a band has when the band height isn't given, 64 MB of them */
+#define CLI_BAND_PIXEL_COUNT (16 << 20)
+
+/* at most this long between checkpoints, in milliseconds */
+#define CLI_CHECKPOINT_INTERVAL 10000
+#define CLI_MANIFEST_SIZE 512
+
+#define CLI_MAX_WORKERS 256
+
+/* a zoom renders every frame from scratch this often, so what was reused doesn't drift */
+#define CLI_KEYFRAME_INTERVAL 60
+
+typedef struct cli_options
+{
+    double CenterX, CenterY;
+    double ViewHeight;
+    int Width, Height;
+    int BandHeight;
+    pixel_format Format;
+    image_file_format FileFormat;
+    Bool8 Stored;
+    Bool8 Supersample;
+    Bool8 Resume;
+    Bool8 Zoom;
+    Bool8 ExpMap;
+    double ZoomX, ZoomY;
+    double ZoomViewHeight;
+    int FrameCount;
+    int FrameRate;
+    const char *OutputPath;
+    Bool8 Serve;
+    int Port;
+    const char *WorkerAddress;
+    const char *Workers[CLI_MAX_WORKERS];
+    int WorkerCount;
+    render_engine Engine;
+} cli_options;
+
+static void Cli_Fatal(const char *Fmt, const char *Arg)
+{
+    fprintf(stderr, "simdbrot: ");
+    fprintf(stderr, Fmt, Arg);
+    fprintf(stderr, "\n(run with --help for usage)\n");
+    exit(1);
+}
+
+static void Cli_PrintUsage(void)
+{
+    printf(
+        "usage: simdbrot [options] -o FILE.ppm|FILE.png|FILE.qoi\n"
+        "       simdbrot [options] --zoom-to X Y H -o FILE.y4m\n"
+        "       simdbrot [options] --serve PORT\n"
+        "       simdbrot [options] --worker ADDRESS\n"
+        "  -o, --output FILE         where the image goes (binary ppm, see --format), or the video (y4m, - for stdout)\n"
+        "  -c, --center X Y          center of the view                 (default -0.5 0)\n"
+        "  -v, --view-height H       height of the view in the plane    (default 2)\n"
+        "  -s, --size WxH            size of the image in pixels        (default 1920x1080)\n"
+        "  -i, --iterations N        iteration count                    (default 400)\n"
+        "  -m, --mode N              kernel, 0 to %d                     (default: the best one the cpu has)\n"
+        "      --method NAME         full, subdivide or boundary-trace  (default full)\n"
+        "  -t, --threads N           render threads                     (default: one per processor)\n"
+        "      --supersample         anti-alias the edges\n"
+        "  -f, --format NAME         rgb32 (ppm), index8 (palette index, pgm), count16 (iteration count, 16 bit pgm)\n"
+        "                            rgb24 (ppm) or rgb565 (raw, little endian) (default rgb32),\n"
+        "                            a png takes all but rgb565, a qoi only rgb32\n"
+        "      --stored              don't compress the png, only filter it\n"
+        "      --band-height N       rows rendered and written at a time (default: about 64 MB worth)\n"
+        "      --resume              carry on with a render of the same image that was stopped\n"
+        "      --zoom-to X Y H       zoom from the view to this one (center and view height)\n"
+        "      --frames N            frames in the zoom                 (default 300)\n"
+        "      --fps N               frame rate of the video            (default 30)\n"
+        "      --exp-map             resample the frames from an exponential map, the zoom stays on X Y\n"
+        "      --serve PORT          serve tiles at http://127.0.0.1:PORT/{z}/{x}/{y}.png (0 for any free port),\n"
+        "                            for any xyz map viewer, -i is for zoom 0 and deeper tiles get more\n"
+        "      --worker ADDRESS      render tiles for coordinators, at HOST:PORT (no HOST for every address) or unix:PATH\n"
+        "      --workers A,B,...     render the image on these workers instead of here\n"
+        "  -h, --help\n",
+        MODE_MAX
+    );
+    printf("modes:\n");
+    for (int i = 0; i <= MODE_MAX; i++)
+        printf("  %d: %s\n", i, GetModeName(i));
+}
+
+static double Cli_ParseDouble(const char *Str)
+{
+    char *End;
+    double Value = strtod(Str, &End);
+    if (End == Str || *End)
+        Cli_Fatal("'%s' is not a number", Str);
+    return Value;
+}
+
+static int Cli_ParseInt(const char *Str, int Min, int Max)
+{
+    char *End;
+    long Value = strtol(Str, &End, 10);
+    if (End == Str || *End)
+        Cli_Fatal("'%s' is not a whole number", Str);
+    if (Value < Min || Value > Max)
+        Cli_Fatal("'%s' is out of range", Str);
+    return (int)Value;
+}
+
+static pixel_format Cli_ParseFormat(const char *Str)
+{
+    for (int i = 0; i < PIXEL_FORMAT_COUNT; i++)
+    {
+        if (0 == strcmp(Str, GetPixelFormatName(i)))
+            return i;
+    }
+    Cli_Fatal("unknown format '%s'", Str);
+    return PIXEL_FORMAT_RGB32;
+}
+
+static Bool8 Cli_HasExtension(const char *Path, const char *Extension)
+{
+    size_t PathLength = strlen(Path), Length = strlen(Extension);
+    if (PathLength < Length)
+        return false;
+    for (size_t i = 0; i < Length; i++)
+    {
+        if (tolower((unsigned char)Path[PathLength - Length + i]) != Extension[i])
+            return false;
+    }
+    return true;
+}
+
+static render_method Cli_ParseMethod(const char *Str)
+{
+    /* "boundary-trace" is easier to type than "boundary trace" */
+    for (int i = 0; i < RENDER_METHOD_COUNT; i++)
+    {
+        const char *Name = GetRenderMethodName(i);
+        int c = 0;
+        while (Str[c] && (Str[c] == Name[c] || ('-' == Str[c] && ' ' == Name[c])))
+            c++;
+        if (0 == Str[c] && 0 == Name[c])
+            return i;
+    }
+    Cli_Fatal("unknown method '%s'", Str);
+    return RENDER_METHOD_FULL;
+}
+
+static Bool8 Cli_IsOption(const char *Arg, const char *Short, const char *Long)
+{
+    return (Short && 0 == strcmp(Arg, Short)) || 0 == strcmp(Arg, Long);
+}
+
+/* the ValueCount arguments after the option at *i, skips *i past them */
+static char **Cli_GetValues(int ArgCount, char **Args, int *i, int ValueCount)
+{
+    if (*i + ValueCount >= ArgCount)
+        Cli_Fatal("%s needs more values", Args[*i]);
+    char **Values = Args + *i + 1;
+    *i += ValueCount;
+    return Values;
+}
+
+static cli_options Cli_ParseArgs(int ArgCount, char **Args)
+{
+    cli_options Options = {
+        .CenterX = -0.5,
+        .CenterY = 0,
+        .ViewHeight = 2,
+        .Width = 1920,
+        .Height = 1080,
+        .FrameCount = 300,
+        .FrameRate = 30,
+        .Engine = MakeRenderEngine(),
+    };
+
+    for (int i = 1; i < ArgCount; i++)
+    {
+        const char *Arg = Args[i];
+        if (Cli_IsOption(Arg, "-h", "--help"))
+        {
+            Cli_PrintUsage();
+            exit(0);
+        }
+        else if (Cli_IsOption(Arg, "-o", "--output"))
+        {
+            Options.OutputPath = Cli_GetValues(ArgCount, Args, &i, 1)[0];
+        }
+        else if (Cli_IsOption(Arg, "-c", "--center"))
+        {
+            char **Values = Cli_GetValues(ArgCount, Args, &i, 2);
+            Options.CenterX = Cli_ParseDouble(Values[0]);
+            Options.CenterY = Cli_ParseDouble(Values[1]);
+        }
+        else if (Cli_IsOption(Arg, "-v", "--view-height"))
+        {
+            const char *Value = Cli_GetValues(ArgCount, Args, &i, 1)[0];
+            Options.ViewHeight = Cli_ParseDouble(Value);
+            if (!(Options.ViewHeight > 0))
+                Cli_Fatal("the view height has to be positive, not '%s'", Value);
+        }
+        else if (Cli_IsOption(Arg, "-s", "--size"))
+        {
+            const char *Value = Cli_GetValues(ArgCount, Args, &i, 1)[0];
+            if (2 != sscanf(Value, "%dx%d", &Options.Width, &Options.Height)
+            || Options.Width <= 0 || Options.Height <= 0)
+            {
+                Cli_Fatal("'%s' is not a size like 1920x1080", Value);
+            }
+        }
+        else if (Cli_IsOption(Arg, "-i", "--iterations"))
+        {
+            const char *Value = Cli_GetValues(ArgCount, Args, &i, 1)[0];
+            Options.Engine.IterationCount = Cli_ParseInt(Value, 1, ITERATION_COUNT_MAX);
+        }
+        else if (Cli_IsOption(Arg, "-m", "--mode"))
+        {
+            const char *Value = Cli_GetValues(ArgCount, Args, &i, 1)[0];
+            Options.Engine.Mode = Cli_ParseInt(Value, 0, MODE_MAX);
+        }
+        else if (Cli_IsOption(Arg, NULL, "--method"))
+        {
+            Options.Engine.Method = Cli_ParseMethod(Cli_GetValues(ArgCount, Args, &i, 1)[0]);
+        }
+        else if (Cli_IsOption(Arg, "-t", "--threads"))
+        {
+            const char *Value = Cli_GetValues(ArgCount, Args, &i, 1)[0];
+            Options.Engine.ThreadCount = Cli_ParseInt(Value, 1, ENGINE_MAX_THREAD_COUNT);
+        }
+        else if (Cli_IsOption(Arg, NULL, "--supersample"))
+        {
+            Options.Supersample = true;
+        }
+        else if (Cli_IsOption(Arg, "-f", "--format"))
+        {
+            Options.Format = Cli_ParseFormat(Cli_GetValues(ArgCount, Args, &i, 1)[0]);
+        }
+        else if (Cli_IsOption(Arg, NULL, "--stored"))
+        {
+            Options.Stored = true;
+        }
+        else if (Cli_IsOption(Arg, NULL, "--band-height"))
+        {
+            const char *Value = Cli_GetValues(ArgCount, Args, &i, 1)[0];
+            Options.BandHeight = Cli_ParseInt(Value, 1, INT32_MAX);
+        }
+        else if (Cli_IsOption(Arg, NULL, "--resume"))
+        {
+            Options.Resume = true;
+        }
+        else if (Cli_IsOption(Arg, NULL, "--zoom-to"))
+        {
+            char **Values = Cli_GetValues(ArgCount, Args, &i, 3);
+            Options.Zoom = true;
+            Options.ZoomX = Cli_ParseDouble(Values[0]);
+            Options.ZoomY = Cli_ParseDouble(Values[1]);
+            Options.ZoomViewHeight = Cli_ParseDouble(Values[2]);
+            if (!(Options.ZoomViewHeight > 0))
+                Cli_Fatal("the view height has to be positive, not '%s'", Values[2]);
+        }
+        else if (Cli_IsOption(Arg, NULL, "--frames"))
+        {
+            Options.FrameCount = Cli_ParseInt(Cli_GetValues(ArgCount, Args, &i, 1)[0], 1, INT32_MAX);
+        }
+        else if (Cli_IsOption(Arg, NULL, "--exp-map"))
+        {
+            Options.ExpMap = true;
+        }
+        else if (Cli_IsOption(Arg, NULL, "--serve"))
+        {
+            Options.Serve = true;
+            Options.Port = Cli_ParseInt(Cli_GetValues(ArgCount, Args, &i, 1)[0], 0, 65535);
+        }
+        else if (Cli_IsOption(Arg, NULL, "--worker"))
+        {
+            Options.WorkerAddress = Cli_GetValues(ArgCount, Args, &i, 1)[0];
+        }
+        else if (Cli_IsOption(Arg, NULL, "--workers"))
+        {
+            char *Value = Cli_GetValues(ArgCount, Args, &i, 1)[0];
+            for (char *Worker = strtok(Value, ","); Worker; Worker = strtok(NULL, ","))
+            {
+                if (CLI_MAX_WORKERS == Options.WorkerCount)
+                    Cli_Fatal("%s", "too many workers");
+                Options.Workers[Options.WorkerCount++] = Worker;
+            }
+            if (0 == Options.WorkerCount)
+                Cli_Fatal("%s", "--workers needs at least one address");
+        }
+        else if (Cli_IsOption(Arg, NULL, "--fps"))
+        {
+            Options.FrameRate = Cli_ParseInt(Cli_GetValues(ArgCount, Args, &i, 1)[0], 1, 1000);
+        }
+        else
+        {
+            Cli_Fatal("unknown option '%s'", Arg);
+        }
+    }
+
+    if (Options.WorkerAddress)
+    {
+        if (Options.OutputPath || Options.Serve || Options.WorkerCount > 0)
+            Cli_Fatal("%s", "--worker only renders what it's sent, it can't have -o, --serve or --workers");
+        return Options;
+    }
+    if (Options.Serve)
+    {
+        if (Options.OutputPath || Options.Zoom || Options.Resume)
+            Cli_Fatal("%s", "--serve writes no file, it can't have -o, --zoom-to or --resume");
+        if (PIXEL_FORMAT_RGB32 != Options.Format)
+            Cli_Fatal("%s", "the tiles are always rgb32 png");
+        return Options;
+    }
+    if (NULL == Options.OutputPath)
+        Cli_Fatal("%s", "no output file, use -o FILE");
+    if (Options.Zoom && Options.WorkerCount > 0)
+        Cli_Fatal("%s", "--workers is for images, the frames of a zoom depend on each other");
+    if (Options.Zoom && Options.Resume)
+        Cli_Fatal("%s", "--resume is for images, a zoom can't be resumed");
+    if (Options.ExpMap && !Options.Zoom)
+        Cli_Fatal("%s", "--exp-map needs a zoom, use --zoom-to X Y H");
+    if (Options.ExpMap && !(Options.ZoomViewHeight < Options.ViewHeight))
+        Cli_Fatal("%s", "--exp-map only zooms in, the view height of --zoom-to has to be smaller");
+    if (Options.ExpMap && Options.Supersample)
+        Cli_Fatal("%s", "--exp-map frames are resampled, they can't be supersampled");
+    if (!Options.Zoom)
+    {
+        Options.FileFormat = Cli_HasExtension(Options.OutputPath, ".png")? IMAGE_FILE_PNG
+            : Cli_HasExtension(Options.OutputPath, ".qoi")? IMAGE_FILE_QOI
+            : IMAGE_FILE_NETPBM;
+    }
+    if (IMAGE_FILE_NETPBM != Options.FileFormat)
+    {
+        if (Options.Resume)
+            Cli_Fatal("%s", "a png or qoi is compressed, it can't be resumed, write a ppm for that");
+        if (!ImageEncoderSupports(Options.FileFormat, Options.Format))
+            Cli_Fatal("there's no %s in that kind of file", GetPixelFormatName(Options.Format));
+    }
+    if (PIXEL_FORMAT_RGB32 != Options.Format)
+    {
+        if (Options.Zoom)
+            Cli_Fatal("%s", "a zoom is always y4m, --format is for images");
+        if (Options.Supersample)
+            Cli_Fatal("%s", "only rgb32 can be supersampled, the other formats aren't colors to blend");
+        if (RENDER_METHOD_FULL != Options.Engine.Method)
+            Cli_Fatal("%s", "the formats other than rgb32 are always rendered with the full method");
+    }
+    if (0 == Options.BandHeight)
+    {
+        /* whole tiles, so subdividing doesn't get cut up at every band */
+        Options.BandHeight = CLI_BAND_PIXEL_COUNT / Options.Width;
+        Options.BandHeight = MAX(TILE_SIZE, Options.BandHeight / TILE_SIZE * TILE_SIZE);
+    }
+    Options.BandHeight = MIN(Options.BandHeight, Options.Height);
+    return Options;
+}
+
+static volatile sig_atomic_t Cli_StopRequested;
+
+static void Cli_OnSignal(int Signal)
+{
+    /* stop at the end of the band, a second one stops right away */
+    Cli_StopRequested = 1;
+    signal(Signal, SIG_DFL);
+}
+
+static Bool8 Cli_Seek(FILE *File, i64 Offset, int Origin)
+{
+#ifdef _WIN32
+    return 0 == _fseeki64(File, Offset, Origin);
+#else
+    return 0 == fseeko(File, Offset, Origin);
+#endif /* _WIN32 */
+}
+
+static i64 Cli_Tell(FILE *File)
+{
+#ifdef _WIN32
+    return _ftelli64(File);
+#else
+    return ftello(File);
+#endif /* _WIN32 */
+}
+
+/* makes sure what was written so far is on disk, not just in some buffer */
+static Bool8 Cli_SyncFile(FILE *File)
+{
+    if (0 != fflush(File))
+        return false;
+#ifdef _WIN32
+    return 0 == _commit(_fileno(File));
+#else
+    return 0 == fsync(fileno(File));
+#endif /* _WIN32 */
+}
+
+/* rgb32 is 3 bytes a pixel in the ppm, the others are written as they are */
+static int Cli_GetFileBytesPerPixel(pixel_format Format)
+{
+    return PIXEL_FORMAT_RGB32 == Format? 3 : GetPixelFormatSize(Format);
+}
+
+/* everything that decides what the pixels are, a checkpoint is only good for the same job,
+ * the thread count isn't one of them since every pixel is at the same point however the image is split up,
+ * but subdivide and boundary-trace guess from the rectangles they split it into, and the workers' tiles split it differently */
+static void Cli_FormatJob(const cli_options *Options, char *Job, size_t Size)
+{
+    snprintf(Job, Size,
+        "simdbrot checkpoint 1\n"
+        "size %d %d\n"
+        "center %a %a\n"
+        "view-height %a\n"
+        "iterations %d\n"
+        "mode %d\n"
+        "method %d\n"
+        "supersample %d\n"
+        "band-height %d\n"
+        "format %d\n"
+        "on-workers %d\n",
+        Options->Width, Options->Height,
+        Options->CenterX, Options->CenterY,
+        Options->ViewHeight,
+        Options->Engine.IterationCount,
+        Options->Engine.Mode,
+        Options->Engine.Method,
+        Options->Supersample,
+        Options->BandHeight,
+        Options->Format,
+        Options->WorkerCount > 0
+    );
+}
+
+/* how many rows the checkpoint at Path has, 0 when there's none */
+static int Cli_ReadCheckpoint(const char *Path, const char *Job)
+{
+    FILE *File = fopen(Path, "rb");
+    if (NULL == File)
+        return 0;
+
+    char Manifest[CLI_MANIFEST_SIZE] = {0};
+    fread(Manifest, 1, sizeof Manifest - 1, File);
+    fclose(File);
+
+    size_t JobLength = strlen(Job);
+    int RowsDone;
+    if (0 != strncmp(Manifest, Job, JobLength))
+        Cli_Fatal("the checkpoint '%s' is from a render with other options", Path);
+    if (1 != sscanf(Manifest + JobLength, "rows-done %d", &RowsDone) || RowsDone < 0)
+        Cli_Fatal("the checkpoint '%s' is broken", Path);
+    return RowsDone;
+}
+
+/* written next to the manifest and then renamed over it, so there's always a whole one */
+static Bool8 Cli_WriteCheckpoint(const char *Path, const char *Job, int RowsDone)
+{
+    char TempPath[4096];
+    snprintf(TempPath, sizeof TempPath, "%s.tmp", Path);
+    FILE *File = fopen(TempPath, "wb");
+    if (NULL == File)
+        return false;
+
+    Bool8 Written = fprintf(File, "%srows-done %d\n", Job, RowsDone) > 0
+        && Cli_SyncFile(File);
+    if (0 != fclose(File) || !Written)
+        return false;
+#ifdef _WIN32
+    remove(Path);
+#endif /* _WIN32 */
+    return 0 == rename(TempPath, Path);
+}
+
+typedef struct cli_band_writer
+{
+    FILE *File;
+    int Height;
+    int BandCount;
+    int RowsDone;
+    Bool8 Stopped;
+    Bool8 WriteFailed;
+    double LastCheckpoint;
+    const char *ManifestPath;
+    image_encoder *Encoder;
+    double EncodeTime;
+    const char *Job;
+} cli_band_writer;
+
+static Bool8 Cli_WriteBand(void *UserData, const pixel_buffer *Band, int FirstRow)
+{
+    cli_band_writer *Writer = UserData;
+    double StartTime = GetTimeMillisec();
+    if (Writer->Encoder? !ImageEncoderWriteBand(Writer->Encoder, Band) : !WriteImageRows(Writer->File, Band))
+    {
+        Writer->WriteFailed = true;
+        return false;
+    }
+    Writer->EncodeTime += GetTimeMillisec() - StartTime;
+
+    Writer->RowsDone = FirstRow + Band->Height;
+    if (Writer->BandCount > 1)
+    {
+        fprintf(stderr, "\r%d of %d rows", Writer->RowsDone, Writer->Height);
+        if (Writer->RowsDone == Writer->Height || Cli_StopRequested)
+            fprintf(stderr, "\n");
+    }
+
+    /* the last band needs no checkpoint, the manifest goes away once the file is done, 
+     * an encoded file has none */
+    if (Writer->RowsDone == Writer->Height || Writer->Encoder)
+        return true;
+    if (Cli_StopRequested || GetTimeMillisec() - Writer->LastCheckpoint >= CLI_CHECKPOINT_INTERVAL)
+    {
+        if (!Cli_SyncFile(Writer->File) || !Cli_WriteCheckpoint(Writer->ManifestPath, Writer->Job, Writer->RowsDone))
+        {
+            Writer->WriteFailed = true;
+            return false;
+        }
+        Writer->LastCheckpoint = GetTimeMillisec();
+    }
+    Writer->Stopped = Cli_StopRequested;
+    return !Writer->Stopped;
+}
+
+/* the view at T (0 to 1) of the zoom, 
+ * the height changes by the same factor every frame, so the zoom looks like it goes at the same speed, 
+ * and the center moves with the height, so the view it ends on doesn't slide across the screen */
+static coordmap Cli_GetZoomMap(const cli_options *Options, double T)
+{
+    double ViewHeight = Options->ViewHeight * pow(Options->ZoomViewHeight / Options->ViewHeight, T);
+    double Progress = Options->ZoomViewHeight != Options->ViewHeight
+        ? (Options->ViewHeight - ViewHeight) / (Options->ViewHeight - Options->ZoomViewHeight)
+        : T;
+    double CenterX = Options->CenterX + Progress * (Options->ZoomX - Options->CenterX);
+    double CenterY = Options->CenterY + Progress * (Options->ZoomY - Options->CenterY);
+    return MakeCenteredMap(CenterX, CenterY, ViewHeight, Options->Width, Options->Height);
+}
+
+static void Cli_RenderZoom(cli_options *Options, FILE *File, const char *Path)
+{
+    render_engine *Engine = &Options->Engine;
+    size_t PixelCount = (size_t)Options->Width * Options->Height;
+    u32 *Pixels[2] = {
+        malloc(PixelCount * sizeof(u32)),
+        malloc(PixelCount * sizeof(u32)),
+    };
+    u8 *Marks = malloc(PixelCount);
+    if (NULL == Pixels[0] || NULL == Pixels[1] || NULL == Marks)
+        Cli_Fatal("%s", "out of memory");
+    if (!WriteY4MHeader(File, Options->Width, Options->Height, Options->FrameRate))
+        Cli_Fatal("unable to write '%s'", Path);
+
+    exp_map ExpMap = {0};
+    if (Options->ExpMap && !ExpMapInit(
+        &ExpMap, Options->ZoomX, Options->ZoomY,
+        Options->ViewHeight, Options->ZoomViewHeight,
+        Options->Width, Options->Height))
+    {
+        Cli_Fatal("%s", "out of memory");
+    }
+
+    double StartTime = GetTimeMillisec();
+    color_buffer Previous = {0};
+    coordmap PreviousMap = {0};
+    double RenderedCount = 0;
+    for (int Frame = 0; Frame < Options->FrameCount; Frame++)
+    {
+        double T = Options->FrameCount > 1? (double)Frame / (Options->FrameCount - 1) : 0;
+        coordmap Map = Cli_GetZoomMap(Options, T);
+        color_buffer Buffer = MakeColorBuffer(Engine, Pixels[Frame & 1], Options->Width, Options->Height, Options->Width);
+
+        if (Options->ExpMap)
+        {
+            /* centered on the point of the zoom the whole way */
+            ExpMapRenderFrame(Engine, &ExpMap, &Buffer, Map.Height);
+        }
+        else if (0 == Frame % CLI_KEYFRAME_INTERVAL)
+        {
+            EngineRenderBuffer(Engine, &Buffer, &Map);
+            RenderedCount += PixelCount;
+        }
+        else
+        {
+            RenderedCount += EngineRenderZoomFrame(Engine, &Buffer, &Map, &Previous, &PreviousMap, Marks);
+        }
+        if (Options->Supersample)
+            EngineSupersampleEdges(Engine, &Buffer, &Map, Marks);
+
+        if (!WriteY4MFrame(File, &Buffer))
+            Cli_Fatal("unable to write '%s'", Path);
+        fprintf(stderr, "\r%d of %d frames", Frame + 1, Options->FrameCount);
+        Previous = Buffer;
+        PreviousMap = Map;
+    }
+    double RenderTime = GetTimeMillisec() - StartTime;
+    if (Options->ExpMap)
+        RenderedCount = (double)ExpMap.RenderedRowCount * ExpMap.Width;
+
+    fprintf(stderr, "\n%d frames of %dx%d, %.1f%% as many samples rendered as pixels shown, %d iterations, %s, %d thread%s%s: %.1f ms\n",
+        Options->FrameCount, Options->Width, Options->Height,
+        100.0 * RenderedCount / ((double)PixelCount * Options->FrameCount),
+        Engine->IterationCount,
+        GetModeName(Engine->Mode),
+        Engine->ThreadCount, Engine->ThreadCount != 1? "s" : "",
+        Options->Supersample? ", supersampled" : "",
+        RenderTime
+    );
+    ExpMapFree(&ExpMap);
+    free(Marks);
+    free(Pixels[1]);
+    free(Pixels[0]);
+}
+
+int main(int ArgCount, char **Args)
+{
+    cli_options Options = Cli_ParseArgs(ArgCount, Args);
+    render_engine *Engine = &Options.Engine;
+    coordmap Map = MakeCenteredMap(Options.CenterX, Options.CenterY, Options.ViewHeight, Options.Width, Options.Height);
+
+    if (Options.WorkerAddress)
+    {
+        ClusterServeWorker(Engine, Options.WorkerAddress);
+        Cli_Fatal("unable to listen on '%s'", Options.WorkerAddress);
+    }
+    if (Options.Serve)
+    {
+        tile_server_options ServerOptions = {
+            .Port = Options.Port,
+            .Supersample = Options.Supersample,
+            .Stored = Options.Stored,
+        };
+        ServeTiles(Engine, &ServerOptions);
+        Cli_Fatal("%s", "unable to start the tile server (is the port taken?)");
+    }
+
+    if (Options.Zoom)
+    {
+        Bool8 IsStdout = 0 == strcmp(Options.OutputPath, "-");
+        FILE *File = IsStdout? stdout : fopen(Options.OutputPath, "wb");
+        if (NULL == File)
+            Cli_Fatal("unable to open '%s'", Options.OutputPath);
+#ifdef _WIN32
+        if (IsStdout)
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif /* _WIN32 */
+        Cli_RenderZoom(&Options, File, Options.OutputPath);
+        if (0 != fclose(File))
+            Cli_Fatal("unable to write '%s'", Options.OutputPath);
+        return 0;
+    }
+
+    char ManifestPath[4096];
+    char Job[CLI_MANIFEST_SIZE];
+    snprintf(ManifestPath, sizeof ManifestPath, "%s.resume", Options.OutputPath);
+    Cli_FormatJob(&Options, Job, sizeof Job);
+
+    int StartRow = Options.Resume? Cli_ReadCheckpoint(ManifestPath, Job) : 0;
+    FILE *File = fopen(Options.OutputPath, StartRow > 0? "r+b" : "wb");
+    if (NULL == File)
+        Cli_Fatal("unable to open '%s'", Options.OutputPath);
+    image_encoder Encoder;
+    Bool8 Encoded = IMAGE_FILE_NETPBM != Options.FileFormat;
+    Bool8 HeaderWritten = Encoded
+        ? ImageEncoderInit(&Encoder, Engine, File, Options.FileFormat, Options.Format, Options.Width, Options.Height, Options.Stored)
+        : WriteImageHeader(File, Options.Format, Options.Width, Options.Height);
+    if (!HeaderWritten)
+        Cli_Fatal("unable to write '%s'", Options.OutputPath);
+    if (StartRow > 0)
+    {
+        /* the rows after the checkpoint may or may not have made it, they're rendered again anyway */
+        i64 RowsOffset = Cli_Tell(File) + (i64)StartRow * Options.Width * Cli_GetFileBytesPerPixel(Options.Format);
+        if (!Cli_Seek(File, 0, SEEK_END) || Cli_Tell(File) < RowsOffset)
+            Cli_Fatal("'%s' is shorter than its checkpoint says", Options.OutputPath);
+        if (!Cli_Seek(File, RowsOffset, SEEK_SET))
+            Cli_Fatal("unable to write '%s'", Options.OutputPath);
+        fprintf(stderr, "resuming at row %d\n", StartRow);
+    }
+
+    cli_band_writer Writer = {
+        .File = File,
+        .Height = Options.Height,
+        .BandCount = (Options.Height + Options.BandHeight - 1) / Options.BandHeight,
+        .RowsDone = StartRow,
+        .LastCheckpoint = GetTimeMillisec(),
+        .ManifestPath = ManifestPath,
+        .Job = Job,
+        .Encoder = Encoded? &Encoder : NULL,
+    };
+    if (!Encoded)
+    {
+        signal(SIGINT, Cli_OnSignal);
+        signal(SIGTERM, Cli_OnSignal);
+    }
+
+    double StartTime = GetTimeMillisec();
+    Bool8 Rendered = Options.WorkerCount > 0
+        ? ClusterRenderBands(
+            Engine, &Map,
+            Options.Width, Options.Height,
+            StartRow,
+            Options.BandHeight,
+            Options.Format,
+            Options.Supersample,
+            Cli_WriteBand, &Writer,
+            Options.Workers, Options.WorkerCount
+        )
+        : EngineRenderBands(
+            Engine, &Map,
+            Options.Width, Options.Height,
+            StartRow,
+            Options.BandHeight,
+            Options.Format,
+            Options.Supersample,
+            Cli_WriteBand, &Writer
+        );
+    /* the band writer knows when it was the file, everything else is the render's own failure */
+    Bool8 Written = !Writer.WriteFailed;
+    if (Encoded)
+    {
+        Written = Written && (!Rendered || ImageEncoderFinish(&Encoder));
+        ImageEncoderFree(&Encoder);
+    }
+    if (0 != fclose(File) || !Written)
+        Cli_Fatal("unable to write '%s'", Options.OutputPath);
+    if (!Rendered && !Writer.Stopped)
+        Cli_Fatal(Options.WorkerCount > 0? "the workers couldn't render '%s'" : "out of memory rendering '%s'", Options.OutputPath);
+    double RenderTime = GetTimeMillisec() - StartTime;
+
+    if (Writer.Stopped)
+    {
+        fprintf(stderr, "stopped after %d of %d rows, run it again with --resume to finish it\n", Writer.RowsDone, Options.Height);
+        return 1;
+    }
+    remove(ManifestPath);
+
+    char Renderers[64];
+    if (Options.WorkerCount > 0)
+        snprintf(Renderers, sizeof Renderers, "%d worker%s", Options.WorkerCount, Options.WorkerCount != 1? "s" : "");
+    else snprintf(Renderers, sizeof Renderers, "%d thread%s", Engine->ThreadCount, Engine->ThreadCount != 1? "s" : "");
+    fprintf(stderr, "%dx%d %s in %d band%s, %d iterations, %s, %s, %s%s: %.1f ms (%.1f ms of it writing)\n",
+        Options.Width, Options.Height,
+        GetPixelFormatName(Options.Format),
+        Writer.BandCount, Writer.BandCount != 1? "s" : "",
+        Engine->IterationCount,
+        GetModeName(Engine->Mode),
+        GetRenderMethodName(Engine->Method),
+        Renderers,
+        Options.Supersample? ", supersampled" : "",
+        RenderTime, Writer.EncodeTime
+    );
+    return 0;
+}
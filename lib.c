@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+#include "Common.h"
+#include "simdbrot.h"
+
+/*
+ * Library front-end:
+ * a simdbrot is little more than a render_engine without the per-render settings,
+ * every call makes its own engine on the stack from it and the options, so calls share nothing they write to.
+ */
+
+struct simdbrot_pool
+{
+    engine_pool *Pool;
+};
+
+struct simdbrot
+{
+    engine_pool *Pool;
+    int ThreadCount;
+    u32 Palette[16];
+};
+
+simdbrot_pool *SimdbrotCreatePool(int ThreadCount)
+{
+    simdbrot_pool *Pool = calloc(1, sizeof *Pool);
+    if (NULL == Pool)
+        return NULL;
+    Pool->Pool = EngineCreatePool(ThreadCount > 0? ThreadCount : GetProcessorCount());
+    if (NULL == Pool->Pool)
+    {
+        free(Pool);
+        return NULL;
+    }
+    return Pool;
+}
+
+void SimdbrotDestroyPool(simdbrot_pool *Pool)
+{
+    if (NULL == Pool)
+        return;
+    EngineDestroyPool(Pool->Pool);
+    free(Pool);
+}
+
+simdbrot *SimdbrotCreate(simdbrot_pool *Pool, const uint32_t *Palette)
+{
+    simdbrot *Simdbrot = calloc(1, sizeof *Simdbrot);
+    if (NULL == Simdbrot)
+        return NULL;
+    if (Pool)
+    {
+        Simdbrot->Pool = Pool->Pool;
+        Simdbrot->ThreadCount = EngineGetPoolThreadCount(Pool->Pool);
+    }
+    else Simdbrot->ThreadCount = GetProcessorCount();
+
+    if (Palette)
+        memcpy(Simdbrot->Palette, Palette, sizeof Simdbrot->Palette);
+    else GetDefaultPalette(Simdbrot->Palette);
+    return Simdbrot;
+}
+
+void SimdbrotDestroy(simdbrot *Simdbrot)
+{
+    free(Simdbrot);
+}
+
+simdbrot_options SimdbrotGetDefaultOptions(void)
+{
+    simdbrot_options Options = {
+        .IterationCount = 400,
+        .Mode = SIMDBROT_MODE_BEST,
+        .Method = SIMDBROT_METHOD_FULL,
+        .MaxValue = 4.0,
+    };
+    return Options;
+}
+
+static Bool8 Lib_IsValidView(const simdbrot_view *View, const simdbrot_options *Options)
+{
+    return View->Pixels
+        && View->Width > 0 && View->Height > 0 && View->Stride >= View->Width
+        && View->ViewHeight > 0
+        && View->IterationCount >= 0
+        && (NULL == View->Counts || SIMDBROT_METHOD_FULL == Options->Method);
+}
+
+static simdbrot_result Lib_MakeEngine(const simdbrot *Simdbrot, const simdbrot_options *Options, render_engine *Engine)
+{
+    if (NULL == Simdbrot
+    || Options->IterationCount <= 0 || !(Options->MaxValue > 0)
+    || Options->Method < SIMDBROT_METHOD_FULL || Options->Method > SIMDBROT_METHOD_ANYTIME)
+    {
+        return SIMDBROT_INVALID_ARGUMENT;
+    }
+
+    int Mode = SIMDBROT_MODE_BEST == Options->Mode? GetBestMode() : Options->Mode;
+    if (!CanRunMode(Mode))
+        return SIMDBROT_UNSUPPORTED_MODE;
+
+    *Engine = (render_engine) {
+        .ThreadCount = Simdbrot->ThreadCount,
+        .Pool = Simdbrot->Pool,
+        .Mode = Mode,
+        .Method = (render_method)Options->Method,
+        .IterationCount = Options->IterationCount,
+        .MaxValue = Options->MaxValue,
+    };
+    memcpy(Engine->Palette, Simdbrot->Palette, sizeof Engine->Palette);
+    return SIMDBROT_OK;
+}
+
+static engine_view Lib_MakeEngineView(const render_engine *Engine, const simdbrot_view *View)
+{
+    engine_view EngineView = {
+        .Buffer = MakeColorBuffer(Engine, View->Pixels, View->Width, View->Height, View->Stride),
+        .Map = MakeCenteredMap(View->CenterX, View->CenterY, View->ViewHeight, View->Width, View->Height),
+        .IterationCount = View->IterationCount? View->IterationCount : Engine->IterationCount,
+    };
+    EngineView.Buffer.Counts = View->Counts;
+    return EngineView;
+}
+
+simdbrot_result SimdbrotRender(const simdbrot *Simdbrot, const simdbrot_view *View, const simdbrot_options *Options)
+{
+    simdbrot_options Defaults = SimdbrotGetDefaultOptions();
+    if (NULL == Options)
+        Options = &Defaults;
+    if (NULL == View || !Lib_IsValidView(View, Options))
+        return SIMDBROT_INVALID_ARGUMENT;
+
+    render_engine Engine;
+    simdbrot_result Result = Lib_MakeEngine(Simdbrot, Options, &Engine);
+    if (SIMDBROT_OK != Result)
+        return Result;
+
+    u8 *Edges = NULL;
+    if (Options->Supersample)
+    {
+        Edges = malloc((size_t)View->Stride * View->Height);
+        if (NULL == Edges)
+            return SIMDBROT_OUT_OF_MEMORY;
+    }
+
+    engine_view EngineView = Lib_MakeEngineView(&Engine, View);
+    Engine.IterationCount = EngineView.IterationCount;
+    EngineRenderBuffer(&Engine, &EngineView.Buffer, &EngineView.Map);
+    if (Edges)
+    {
+        EngineSupersampleEdges(&Engine, &EngineView.Buffer, &EngineView.Map, Edges);
+        free(Edges);
+    }
+    return SIMDBROT_OK;
+}
+
+simdbrot_result SimdbrotRenderViews(
+    const simdbrot *Simdbrot, 
+    const simdbrot_view *Views, 
+    int ViewCount, 
+    const simdbrot_options *Options
+)
+{
+    simdbrot_options Defaults = SimdbrotGetDefaultOptions();
+    if (NULL == Options)
+        Options = &Defaults;
+    if (ViewCount < 0 || (ViewCount > 0 && NULL == Views))
+        return SIMDBROT_INVALID_ARGUMENT;
+    if (0 == ViewCount)
+        return SIMDBROT_OK;
+    for (int i = 0; i < ViewCount; i++)
+    {
+        if (!Lib_IsValidView(&Views[i], Options))
+            return SIMDBROT_INVALID_ARGUMENT;
+    }
+
+    render_engine Engine;
+    simdbrot_result Result = Lib_MakeEngine(Simdbrot, Options, &Engine);
+    if (SIMDBROT_OK != Result)
+        return Result;
+
+    /* one block for the views, and for the edges of all of them */
+    size_t EdgesSize = 0;
+    if (Options->Supersample)
+    {
+        for (int i = 0; i < ViewCount; i++)
+            EdgesSize += (size_t)Views[i].Stride * Views[i].Height;
+    }
+    engine_view *EngineViews = malloc(ViewCount * sizeof *EngineViews + EdgesSize);
+    if (NULL == EngineViews)
+        return SIMDBROT_OUT_OF_MEMORY;
+
+    u8 *Edges = (u8 *)(EngineViews + ViewCount);
+    for (int i = 0; i < ViewCount; i++)
+    {
+        EngineViews[i] = Lib_MakeEngineView(&Engine, &Views[i]);
+        if (Options->Supersample)
+        {
+            EngineViews[i].Edges = Edges;
+            Edges += (size_t)Views[i].Stride * Views[i].Height;
+        }
+    }
+    Bool8 Rendered = EngineRenderViews(&Engine, EngineViews, ViewCount);
+    free(EngineViews);
+    return Rendered? SIMDBROT_OK : SIMDBROT_OUT_OF_MEMORY;
+}
+
+int SimdbrotGetBestMode(void)
+{
+    return GetBestMode();
+}
+
+const char *SimdbrotGetModeName(int Mode)
+{
+    return GetModeName(Mode);
+}
+
+const char *SimdbrotGetResultName(simdbrot_result Result)
+{
+    switch (Result)
+    {
+    case SIMDBROT_OK: return "ok";
+    case SIMDBROT_INVALID_ARGUMENT: return "invalid argument";
+    case SIMDBROT_UNSUPPORTED_MODE: return "mode not supported by this cpu";
+    case SIMDBROT_OUT_OF_MEMORY: return "out of memory";
+    }
+    return "unknown";
+}
@@ -1,13 +1,23 @@
 
 #include <windows.h>
 #include <stdio.h>
+#include <math.h>
 
 #include "Common.h"
 #define MAINTHREAD_CREATE_WINDOW (WM_USER + 0)
 #define MAINTHREAD_DESTROY_WINDOW (WM_USER + 1)
 
-#define MODE_MAX 9
-#define MAX_THREAD_COUNT 128
+#define FIXED_BUFFER_MAX_WIDTH 1080
+#define FIXED_BUFFER_MAX_HEIGHT 720
+#define FIXED_BUFFER_MIN_WIDTH 160
+#define FIXED_BUFFER_MIN_HEIGHT 80
+#define FIXED_BUFFER_MIN_SIZE (160*80)
+#define FIXED_BUFFER_DEFAULT_WIDTH 240
+#define FIXED_BUFFER_DEFAULT_HEIGHT 180
+
+/* held keys and the wheel move the view in steps, 
+ * so it has to stay put for this long before it counts as stopped */
+#define DYNAMIC_RESOLUTION_HOLD_OFF 200 /* milliseconds */
 
 
 /* Casey case because it's funny */
@@ -29,15 +39,6 @@ typedef struct win32_window_creation_args
     HMENU Menu;
 } win32_window_creation_args;
 
-typedef struct win32_render_thread_context 
-{
-    double MaxValue;
-    int IterationCount, RenderMode;
-
-    coordmap Map;
-    color_buffer ColorBuffer;
-} win32_render_thread_context;
-
 typedef struct win32_main_thread_state 
 {
 
@@ -49,8 +50,49 @@ typedef struct win32_main_thread_state
     Bool8 MouseIsDragging;
     int MouseX, MouseY;
     int Mode, ThreadCount;
+    render_method Method;
     int FixedBufferWidth, FixedBufferHeight;
 
+    /* spacing of the next progressive pass, 0 when the image is complete */
+    Bool8 Progressive;
+    int ProgressiveSpacing;
+
+    /* what the fixed buffer currently holds */
+    render_view LastView;
+    Bool8 LastViewComplete;
+
+    /* how far the iteration state of the fixed buffer has been iterated, 
+     * and how many more iterations the anytime method gets to do each frame */
+    int ResumedCount;
+    int IterationSlice;
+
+    /* the fixed buffer is FIXED_BUFFER_DEFAULT_* scaled by ResolutionScale,
+     * InteractiveScale is what the frame time allows while the view is moving, 
+     * LastRequest is the view that the inputs asked for last frame, LastMoveTime when it last changed, 
+     * MoveRenderTime how long the last moving frame took, 0 once it has been taken into account */
+    Bool8 DynamicResolution;
+    double ResolutionScale;
+    double InteractiveScale;
+    render_view LastRequest;
+    double LastMoveTime;
+    Bool8 LastFrameMoved;
+    double MoveRenderTime;
+
+    /* the iteration count follows the zoom and the escape counts of a probe of the view, 
+     * LastProbe is the view that was probed last */
+    Bool8 AutoIterations;
+    render_view LastProbe;
+
+    /* LastSupersampled is the view whose edges have been supersampled already */
+    Bool8 Supersample;
+    render_view LastSupersampled;
+    int EdgeCount;
+
+    Bool8 UseTileCache;
+    tile_cache TileCache;
+    tile_store TileStore;
+    Bool8 TileStoreTried;
+
     Bool8 KeyWasDown[0x100];
     Bool8 KeyIsDown[0x100];
     double KeyDownInit[0x100];
@@ -362,54 +404,149 @@ static Bool8 Win32_IsKeyDown(win32_main_thread_state *State, char Key, double De
     return IsDown;
 }
 
-static const char *GetSimdMode(int Mode)
+/* shows the tiles of a render as the render threads finish them, 
+ * each one stretched onto its part of the window like the whole buffer is once the render is done */
+typedef struct win32_tile_presenter
+{
+    SRWLOCK Lock;
+    HWND Window;
+    const u32 *Buffer;
+    int BufferWidth, BufferHeight, BufferStride;
+    int WindowWidth, WindowHeight;
+} win32_tile_presenter;
+
+static void Win32_PresentTile(void *UserData, const color_buffer *Tile)
 {
-    switch (Mode)
+    win32_tile_presenter *Presenter = UserData;
+    size_t Offset = (size_t)(Tile->Ptr - Presenter->Buffer);
+    int x = (int)(Offset % Presenter->BufferStride);
+    int y = (int)(Offset / Presenter->BufferStride);
+
+    /* the rows of the tile as a bitmap of their own, the edges are rounded the same way for every tile so they meet */
+    BITMAPINFO Info = {
+        .bmiHeader = {
+            .biSize = sizeof Info.bmiHeader,
+            .biWidth = Tile->Stride,
+            .biHeight = -Tile->Height,
+            .biPlanes = 1,
+            .biBitCount = 32,
+            .biCompression = BI_RGB,
+        },
+    };
+    int Left = x * Presenter->WindowWidth / Presenter->BufferWidth;
+    int Right = (x + Tile->Width) * Presenter->WindowWidth / Presenter->BufferWidth;
+    int Top = y * Presenter->WindowHeight / Presenter->BufferHeight;
+    int Bottom = (y + Tile->Height) * Presenter->WindowHeight / Presenter->BufferHeight;
+
+    /* the window class is CS_OWNDC, so GetDC hands every render thread the one device context of the window, 
+     * and a device context is only for one thread at a time */
+    AcquireSRWLockExclusive(&Presenter->Lock);
+    HDC DC = GetDC(Presenter->Window);
+    if (DC)
     {
-    default:
-    case 0: return "regular f32x1";
-    case 1: return "regular f64x1";
-    case 2: return "sse f32x4";
-    case 3: return "sse f64x2";
-    case 4: return "sse f32x4 (with fma)";
-    case 5: return "sse f64x2 (with fma)";
-    case 6: return "avx f32x8";
-    case 7: return "avx f64x4";
-    case 8: return "avx f32x8 (with fma)";
-    case 9: return "avx f64x4 (with fma)";
+        StretchDIBits(DC, 
+            Left, Top, Right - Left, Bottom - Top, 
+            x, 0, Tile->Width, Tile->Height, 
+            Tile->Ptr - x, &Info, 
+            DIB_RGB_COLORS, SRCCOPY
+        );
+        ReleaseDC(Presenter->Window, DC);
     }
+    ReleaseSRWLockExclusive(&Presenter->Lock);
+}
+
+/* the engine renders with whatever the ui has set up */
+static render_engine Win32_GetRenderEngine(const win32_main_thread_state *State, double MaxValue)
+{
+    render_engine Engine = MakeRenderEngine();
+    Engine.ThreadCount = State->ThreadCount;
+    Engine.Mode = State->Mode;
+    Engine.Method = State->Method;
+    Engine.IterationCount = State->IterationCount;
+    Engine.MaxValue = MaxValue;
+    return Engine;
 }
 
-static DWORD Win32_RenderThread(LPVOID UserData)
+static Bool8 Win32_RequestEqual(const render_view *A, const render_view *B)
 {
-    win32_render_thread_context *ThreadContext = UserData;
-    typedef void (*MandelbrotRenderFn)(
-        color_buffer *ColorBuffer,
-        const coordmap *Map,
-        int IterationCount, 
-        double MaxValue
+    /* Delta and the size come from the resolution, not from the inputs */
+    return A->Map.Left == B->Map.Left
+        && A->Map.Top == B->Map.Top
+        && A->Map.Width == B->Map.Width
+        && A->Map.Height == B->Map.Height
+        && A->IterationCount == B->IterationCount
+        && A->Mode == B->Mode
+        && A->Method == B->Method;
+}
+
+/* picks the size of the fixed buffer for this frame:
+ * while the view moves, the resolution follows the time the last moving frame took to render, 
+ * once it has stopped for DYNAMIC_RESOLUTION_HOLD_OFF, go back to full resolution 
+ * (the window's height, within the fixed buffer's bounds) */
+static void Win32_UpdateDynamicResolution(
+    win32_main_thread_state *State, 
+    int WindowHeight, 
+    double Now,
+    double LastRenderTime, 
+    double MillisecPerFrame
+)
+{
+    double MinScale = MAX(
+        (double)FIXED_BUFFER_MIN_WIDTH / FIXED_BUFFER_DEFAULT_WIDTH, 
+        (double)FIXED_BUFFER_MIN_HEIGHT / FIXED_BUFFER_DEFAULT_HEIGHT
+    );
+    double MaxScale = MIN(
+        (double)FIXED_BUFFER_MAX_WIDTH / FIXED_BUFFER_DEFAULT_WIDTH, 
+        (double)FIXED_BUFFER_MAX_HEIGHT / FIXED_BUFFER_DEFAULT_HEIGHT
     );
-    static const MandelbrotRenderFn Render[MODE_MAX + 1] = {
-        RenderMandelbrotSet32_Unopt,
-        RenderMandelbrotSet64_Unopt,
-        RenderMandelbrotSet32_SSE,
-        RenderMandelbrotSet64_SSE,
-        RenderMandelbrotSet32_SSEFMA,
-        RenderMandelbrotSet64_SSEFMA,
-        RenderMandelbrotSet32_AVX,
-        RenderMandelbrotSet64_AVX,
-        RenderMandelbrotSet32_AVXFMA,
-        RenderMandelbrotSet64_AVXFMA
+    double FullScale = (double)WindowHeight / FIXED_BUFFER_DEFAULT_HEIGHT;
+    FullScale = MIN(MAX(FullScale, MinScale), MaxScale);
+
+    render_view Request = {
+        .Map = State->Map,
+        .IterationCount = State->IterationCount,
+        .Mode = State->Mode,
+        .Method = State->Method,
     };
+    Bool8 Moved = !Win32_RequestEqual(&State->LastRequest, &Request);
+    State->LastRequest = Request;
+    if (Moved)
+        State->LastMoveTime = Now;
 
-    Render[ThreadContext->RenderMode](
-        &ThreadContext->ColorBuffer, 
-        &ThreadContext->Map, 
-        ThreadContext->IterationCount, 
-        ThreadContext->MaxValue
-    );
+    /* LastRenderTime is the frame before this one, only a moving one says what moving costs */
+    if (State->LastFrameMoved)
+        State->MoveRenderTime = LastRenderTime;
+    State->LastFrameMoved = Moved;
 
-    return 0;
+    if (Now - State->LastMoveTime >= DYNAMIC_RESOLUTION_HOLD_OFF)
+    {
+        State->ResolutionScale = FullScale;
+        State->MoveRenderTime = 0;
+    }
+    else if (!Moved)
+    {
+        /* between two steps of the same move, stay where the last moving frame left it */
+        State->ResolutionScale = State->InteractiveScale;
+    }
+    else
+    {
+        /* the render time goes with the pixel count, so the scale goes with its square root.
+         * Drop fast, climb slowly, and leave it alone when it's close enough so the size doesn't jitter */
+        if (State->MoveRenderTime > 0)
+        {
+            double Budget = 0.75 * MillisecPerFrame;
+            double Ratio = sqrt(Budget / State->MoveRenderTime);
+            Ratio = MIN(MAX(Ratio, 0.5), 1.25);
+            if (Ratio < 0.9 || Ratio > 1.1)
+                State->InteractiveScale *= Ratio;
+        }
+        State->MoveRenderTime = 0;
+        State->InteractiveScale = MIN(MAX(State->InteractiveScale, MinScale), FullScale);
+        State->ResolutionScale = State->InteractiveScale;
+    }
+
+    State->FixedBufferWidth = (int)(FIXED_BUFFER_DEFAULT_WIDTH * State->ResolutionScale + 0.5);
+    State->FixedBufferHeight = (int)(FIXED_BUFFER_DEFAULT_HEIGHT * State->ResolutionScale + 0.5);
 }
 
 
@@ -456,10 +593,18 @@ static DWORD Win32_Main(LPVOID UserData)
         .MainWindow = MainWindow,
         .ThreadCount = 4,
         .Mode = 0,
-        .FixedBufferWidth = 240,
-        .FixedBufferHeight = 180
+        .FixedBufferWidth = FIXED_BUFFER_DEFAULT_WIDTH,
+        .FixedBufferHeight = FIXED_BUFFER_DEFAULT_HEIGHT,
+        .DynamicResolution = true,
+        .ResolutionScale = 1,
+        .InteractiveScale = 1,
+        .IterationSlice = 16,
     };
     ResetMap(&State);
+    if (!TileCacheInit(&State.TileCache, TILE_CACHE_CAPACITY))
+    {
+        Win32_Fatal("Unable to allocate the tile cache.");
+    }
 
     {
         POINT Point;
@@ -473,35 +618,65 @@ static DWORD Win32_Main(LPVOID UserData)
     GetDefaultPalette(Buffer.Palette);
     double LastTime = Win32_GetTimeMillisec();
     double ElapsedTime = 0;
+    double LastRenderTime = 0;
     double MillisecPerFrame = 1000.0 / 60.0;
     double MaxValue = 4.0;
     double KeyDelay = 50;
 
-    win32_render_thread_context RenderThreadContext[MAX_THREAD_COUNT] = { 0 };
-    HANDLE RenderThreadHandles[MAX_THREAD_COUNT] = { 0 };
-#define FIXED_BUFFER_MAX_WIDTH 1080
-#define FIXED_BUFFER_MAX_HEIGHT 720
-#define FIXED_BUFFER_MIN_WIDTH 160
-#define FIXED_BUFFER_MIN_HEIGHT 80
-#define FIXED_BUFFER_MIN_SIZE (160*80)
     static u32 FixedBuffer[FIXED_BUFFER_MAX_WIDTH * FIXED_BUFFER_MAX_HEIGHT];
+    static double FixedBufferZx[FIXED_BUFFER_MAX_WIDTH * FIXED_BUFFER_MAX_HEIGHT];
+    static double FixedBufferZy[FIXED_BUFFER_MAX_WIDTH * FIXED_BUFFER_MAX_HEIGHT];
+    static u32 FixedBufferCount[FIXED_BUFFER_MAX_WIDTH * FIXED_BUFFER_MAX_HEIGHT];
+    static u8 FixedBufferEscaped[FIXED_BUFFER_MAX_WIDTH * FIXED_BUFFER_MAX_HEIGHT];
+    static u8 FixedBufferEdges[FIXED_BUFFER_MAX_WIDTH * FIXED_BUFFER_MAX_HEIGHT];
+    /* the finest progressive pass samples every other pixel, so a quarter of the biggest buffer is enough */
+    static u32 ProgressiveSamples[(FIXED_BUFFER_MAX_WIDTH/2 + 1) * (FIXED_BUFFER_MAX_HEIGHT/2 + 1)];
     while (Win32_PollInputs(&State))
     {
         if (Win32_IsKeyPressed(&State, 'C'))
             ChangeMode(&State);
         if (Win32_IsKeyPressed(&State, 'R'))
             ResetMap(&State);
+        if (Win32_IsKeyPressed(&State, 'K'))
+        {
+            State.UseTileCache = !State.UseTileCache;
+            /* only touch the disk once the cache is wanted, keep going without the store if it can't be opened */
+            if (State.UseTileCache && !State.TileStoreTried)
+            {
+                State.TileStoreTried = true;
+                TileStoreOpen(&State.TileStore, TILE_STORE_PATH, Buffer.Palette);
+            }
+        }
+        if (Win32_IsKeyPressed(&State, 'D'))
+        {
+            State.DynamicResolution = !State.DynamicResolution;
+            State.FixedBufferWidth = FIXED_BUFFER_DEFAULT_WIDTH;
+            State.FixedBufferHeight = FIXED_BUFFER_DEFAULT_HEIGHT;
+        }
+        if (Win32_IsKeyPressed(&State, 'A'))
+            State.AutoIterations = !State.AutoIterations;
+        if (Win32_IsKeyPressed(&State, 'S'))
+        {
+            /* the fixed buffer has to be rendered again to get rid of (or get) the supersampled pixels */
+            State.Supersample = !State.Supersample;
+            State.LastViewComplete = false;
+            State.LastSupersampled = (render_view) { 0 };
+        }
+        if (Win32_IsKeyPressed(&State, 'M'))
+            State.Method = (State.Method + 1) % RENDER_METHOD_COUNT;
+        if (Win32_IsKeyPressed(&State, 'P'))
+            State.Progressive = !State.Progressive;
         if (Win32_IsKeyDown(&State, 'Z', KeyDelay))
             ZoomMap(&State, 1);
         if (Win32_IsKeyDown(&State, 'X', KeyDelay))
             ZoomMap(&State, -1);
-        if (Win32_IsKeyDown(&State, VK_UP, KeyDelay) && State.IterationCount <= 1000000)
+        if (Win32_IsKeyDown(&State, VK_UP, KeyDelay) && State.IterationCount <= ITERATION_COUNT_MAX)
             State.IterationCount++;
         if (Win32_IsKeyDown(&State, VK_DOWN, KeyDelay) && State.IterationCount > 1)
             State.IterationCount--;
         if (Win32_IsKeyPressed(&State, VK_LEFT) && State.ThreadCount > 1)
             State.ThreadCount--;
-        if (Win32_IsKeyPressed(&State, VK_RIGHT) && State.ThreadCount <= MAX_THREAD_COUNT)
+        if (Win32_IsKeyPressed(&State, VK_RIGHT) && State.ThreadCount < ENGINE_MAX_THREAD_COUNT)
             State.ThreadCount++;
 
         if (ElapsedTime > MillisecPerFrame)
@@ -510,6 +685,8 @@ static DWORD Win32_Main(LPVOID UserData)
             int WindowWidth = Dimension.w;
             win32_paint_context Context;
             HDC DC;
+            if (State.DynamicResolution)
+                Win32_UpdateDynamicResolution(&State, Dimension.h, Win32_GetTimeMillisec(), LastRenderTime, MillisecPerFrame);
             Bool8 UsingFixedBuffer = State.FixedBufferWidth * State.FixedBufferHeight > FIXED_BUFFER_MIN_SIZE;
             if (UsingFixedBuffer)
             {
@@ -537,54 +714,178 @@ static DWORD Win32_Main(LPVOID UserData)
                 State.Map.Delta = State.Map.Height / Buffer.Height;
             }
 
-                int BufferHeightForSingleThread = Buffer.Height / State.ThreadCount;
-                int RemainingHeight = Buffer.Height % State.ThreadCount;
-                double MapHeightForSingleThread = (double)BufferHeightForSingleThread / Buffer.Height * State.Map.Height;
-                double RemainingMapHeight = (double)RemainingHeight / Buffer.Height * State.Map.Height;
-                for (int i = 0; i < State.ThreadCount; i++)
+                Buffer.Stride = Buffer.Width;
+                if (State.AutoIterations)
                 {
-                    RenderThreadContext[i] = (win32_render_thread_context) {
-                        .RenderMode = State.Mode,
-                        .MaxValue = MaxValue,
+                    /* probing the same view with the same limit again would give the same counts */
+                    static escape_probe Probe;
+                    render_view Probed = {
+                        .Map = State.Map,
+                        .Width = Buffer.Width,
+                        .Height = Buffer.Height,
                         .IterationCount = State.IterationCount,
-                        .Map = (coordmap) {
-                            .Delta = State.Map.Delta,
-                            .Left = State.Map.Left,
-                            .Width = State.Map.Width,
-
-                            .Top = State.Map.Top - i*MapHeightForSingleThread,
-                            .Height = MapHeightForSingleThread,
-                        },
-                        .ColorBuffer = (color_buffer) {
-                            .Ptr = Buffer.Ptr + i * Buffer.Width * BufferHeightForSingleThread,
-                            .Width = Buffer.Width,
-                            .Height = BufferHeightForSingleThread,
-                        },
+                        .Mode = State.Mode,
                     };
-                    if (i == State.ThreadCount - 1)
+                    if (!RenderViewEqual(&State.LastProbe, &Probed))
+                    {
+                        escape_stats Stats = ProbeEscapeCounts(
+                            &Probe, State.Mode, 
+                            &State.Map, Buffer.Width, Buffer.Height, 
+                            State.IterationCount, MaxValue
+                        );
+                        /* ResetMap's view is 2 units high */
+                        State.IterationCount = EstimateIterationCount(&Stats, 2.0 / State.Map.Height);
+                        State.LastProbe = Probed;
+                    }
+                }
+                render_view View = {
+                    .Map = State.Map,
+                    .Width = Buffer.Width,
+                    .Height = Buffer.Height,
+                    .IterationCount = State.IterationCount,
+                    .Mode = State.Mode,
+                    .Method = State.Method,
+                };
+                int ShiftX, ShiftY;
+                Bool8 Resumable = RENDER_METHOD_RESUMABLE == State.Method 
+                    || RENDER_METHOD_ANYTIME == State.Method;
+                Bool8 UseTileCache = UsingFixedBuffer && State.UseTileCache && !Resumable;
+                Bool8 Panned = UsingFixedBuffer 
+                    && !UseTileCache
+                    && State.LastViewComplete 
+                    && GetPanOffset(&State.LastView, &View, &ShiftX, &ShiftY);
+                render_engine Engine = Win32_GetRenderEngine(&State, MaxValue);
+
+                /* a render that takes longer than a frame shows its tiles as they're done, 
+                 * instead of nothing until every render thread is joined */
+                win32_tile_presenter Presenter = {
+                    .Window = MainWindow,
+                    .Buffer = Buffer.Ptr,
+                    .BufferWidth = Buffer.Width,
+                    .BufferHeight = Buffer.Height,
+                    .BufferStride = Buffer.Stride,
+                    .WindowWidth = Dimension.w,
+                    .WindowHeight = Dimension.h,
+                };
+                InitializeSRWLock(&Presenter.Lock);
+                if (UsingFixedBuffer && LastRenderTime > MillisecPerFrame)
+                {
+                    Engine.TileDone = Win32_PresentTile;
+                    Engine.TileDoneUserData = &Presenter;
+                }
+                double FrameRenderStart = Win32_GetTimeMillisec();
+                if (UseTileCache)
+                {
+                    /* the cached tiles only line up with views that sit on their pixel grid */
+                    tile_grid Grid;
+                    SnapViewToTileGrid(&View.Map, Buffer.Width, Buffer.Height, &Grid);
+                    if ((!State.LastViewComplete || !RenderViewEqual(&State.LastView, &View))
+                    && !EngineRenderFromTileCache(&Engine, &State.TileCache, &State.TileStore, &Buffer, &Grid))
+                    {
+                        EngineRenderBuffer(&Engine, &Buffer, &View.Map);
+                    }
+                    State.LastView = View;
+                    State.LastViewComplete = true;
+                }
+                else if (Panned && 0 == ShiftX && 0 == ShiftY)
+                {
+                    /* nothing changed, the fixed buffer still holds the image */
+                }
+                else if (Panned && !Resumable)
+                {
+                    /* the fixed buffer outlives the frame, when the view only got dragged 
+                     * most of its pixels are still good */
+                    Bool8 WasSupersampled = State.Supersample && RenderViewEqual(&State.LastSupersampled, &State.LastView);
+                    EngineRenderPan(&Engine, &Buffer, &View.Map, ShiftX, ShiftY);
+                    State.LastView = View;
+
+                    /* and so are their anti-aliased edges */
+                    if (WasSupersampled)
                     {
-                        RenderThreadContext[i].ColorBuffer.Height += RemainingHeight;
-                        RenderThreadContext[i].Map.Top -= RemainingMapHeight;
-                        RenderThreadContext[i].Map.Height += RemainingMapHeight;
+                        State.EdgeCount = EngineSupersamplePan(&Engine, &Buffer, &View.Map, FixedBufferEdges, ShiftX, ShiftY);
+                        State.LastSupersampled = View;
                     }
-                    memcpy(RenderThreadContext[i].ColorBuffer.Palette, Buffer.Palette, sizeof Buffer.Palette);
-
-                    DWORD ID;
-                    RenderThreadHandles[i] = CreateThread(
-                        NULL, 
-                        1024, 
-                        Win32_RenderThread, 
-                        &RenderThreadContext[i], 
-                        0, 
-                        &ID
+                }
+                else if (UsingFixedBuffer && Resumable)
+                {
+                    /* when only the iteration count went up, continue the pixels that are still bounded */
+                    render_view Resumed = State.LastView;
+                    Resumed.IterationCount = View.IterationCount;
+                    Bool8 CanResume = RenderViewEqual(&Resumed, &View) 
+                        && State.ResumedCount <= View.IterationCount;
+                    if (!CanResume)
+                        State.ResumedCount = 0;
+
+                    /* the anytime method only goes IterationSlice iterations further every frame, 
+                     * the pixels that haven't escaped by then show up black until a later frame gets to them */
+                    int IterationLimit = View.IterationCount;
+                    if (RENDER_METHOD_ANYTIME == State.Method)
+                        IterationLimit = MIN(IterationLimit, State.ResumedCount + State.IterationSlice);
+
+                    tile_job Job = MakeTileJob(
+                        State.Method, State.Mode, 
+                        &Buffer, &View.Map, 
+                        IterationLimit, MaxValue
                     );
-                    /* TODO: err checking */
+                    Job.IterationState = (iteration_state) {
+                        .Zx = FixedBufferZx,
+                        .Zy = FixedBufferZy,
+                        .Count = FixedBufferCount,
+                        .Escaped = FixedBufferEscaped,
+                        .Stride = Buffer.Stride,
+                    };
+                    Job.ResetState = !CanResume;
+
+                    double RenderStart = Win32_GetTimeMillisec();
+                    EngineRenderTiles(&Engine, &Job);
+                    double RenderTime = Win32_GetTimeMillisec() - RenderStart;
+
+                    if (RENDER_METHOD_ANYTIME == State.Method)
+                    {
+                        /* aim for 3/4 of a frame so there's time left to present and poll inputs, 
+                         * the cost of a slice drops as pixels escape, so keep adjusting it */
+                        double Budget = 0.75 * MillisecPerFrame;
+                        double Scale = Budget / MAX(RenderTime, 0.01);
+                        Scale = MIN(MAX(Scale, 0.5), 2.0);
+                        State.IterationSlice = MIN(MAX((int)(State.IterationSlice * Scale), 1), 1 << 20);
+                    }
+
+                    State.ResumedCount = IterationLimit;
+                    State.LastView = View;
+                    State.LastViewComplete = IterationLimit == View.IterationCount;
                 }
-                for (int i = 0; i < State.ThreadCount; i++)
+                else if (UsingFixedBuffer && State.Progressive)
                 {
-                    WaitForSingleObject(RenderThreadHandles[i], INFINITE);
-                    CloseHandle(RenderThreadHandles[i]);
+                    /* refine the fixed buffer by one pass every frame, 
+                     * and start over from the coarsest pass whenever the view changes */
+                    if (!RenderViewEqual(&State.LastView, &View))
+                    {
+                        State.ProgressiveSpacing = PROGRESSIVE_MAX_SPACING;
+                        State.LastView = View;
+                    }
+                    if (State.ProgressiveSpacing)
+                    {
+                        EngineRenderProgressivePass(&Engine, &Buffer, &View.Map, State.ProgressiveSpacing, ProgressiveSamples);
+                        State.ProgressiveSpacing /= 2;
+                    }
+                    State.LastViewComplete = 0 == State.ProgressiveSpacing;
                 }
+                else
+                {
+                    EngineRenderBuffer(&Engine, &Buffer, &View.Map);
+                    State.LastView = View;
+                    State.LastViewComplete = UsingFixedBuffer;
+                }
+                if (UsingFixedBuffer 
+                && State.Supersample 
+                && State.LastViewComplete 
+                && !RenderViewEqual(&State.LastSupersampled, &State.LastView))
+                {
+                    /* only once the image is complete, the progressive and anytime frames before that are temporary anyway */
+                    State.EdgeCount = EngineSupersampleEdges(&Engine, &Buffer, &State.LastView.Map, FixedBufferEdges);
+                    State.LastSupersampled = State.LastView;
+                }
+                LastRenderTime = Win32_GetTimeMillisec() - FrameRenderStart;
 
                 if (UsingFixedBuffer)
                 {
@@ -612,22 +913,61 @@ static DWORD Win32_Main(LPVOID UserData)
                 GetTextMetricsA(DC, &TextStat);
 
                 char TmpTxt[512];
-                int LineCount = 6;
+                char ProgressiveTxt[64] = "off";
+                if (RENDER_METHOD_ANYTIME == State.Method && !State.LastViewComplete)
+                    snprintf(ProgressiveTxt, sizeof ProgressiveTxt, "%d/%d iterations", State.ResumedCount, State.IterationCount);
+                else if (State.Progressive && State.ProgressiveSpacing)
+                    snprintf(ProgressiveTxt, sizeof ProgressiveTxt, "%dpx", State.ProgressiveSpacing*2);
+                else if (State.Progressive || RENDER_METHOD_ANYTIME == State.Method)
+                    snprintf(ProgressiveTxt, sizeof ProgressiveTxt, "done");
+
+                char CacheTxt[64] = "off";
+                if (State.UseTileCache)
+                {
+                    u64 Lookups = State.TileCache.Hits + State.TileCache.Misses;
+                    snprintf(CacheTxt, sizeof CacheTxt, "%d tiles, %.1f%% hits, %llu stored", 
+                        State.TileCache.Count, 
+                        Lookups? 100.0 * State.TileCache.Hits / Lookups : 0.0,
+                        (unsigned long long)TileStoreCount(&State.TileStore)
+                    );
+                }
+
+                char ResolutionTxt[64];
+                snprintf(ResolutionTxt, sizeof ResolutionTxt, "%dx%d%s", 
+                    Buffer.Width, Buffer.Height, 
+                    UsingFixedBuffer && State.DynamicResolution? " (dynamic)" : ""
+                );
+
+                char SupersampleTxt[64] = "off";
+                if (State.Supersample)
+                    snprintf(SupersampleTxt, sizeof SupersampleTxt, "%d edge pixels", State.EdgeCount);
+
+                int LineCount = 11;
                 int Len = snprintf(TmpTxt, sizeof TmpTxt, 
                     "FPS: %3.2f\n"
                     "x: %3.5f .. %3.5f\n"
                     "y: %3.5f .. %3.5f\n"
-                    "iteration%s: %d\n"
+                    "iteration%s: %d%s\n"
                     "thread%s: %d\n"
-                    "rendering: %s", 
+                    "rendering: %s\n"
+                    "method: %s\n"
+                    "progress: %s\n"
+                    "tile cache: %s\n"
+                    "resolution: %s\n"
+                    "supersampling: %s", 
                     (double)1000.0 / ElapsedTime,
                     (double)-State.Map.Left, 
                     (double)-State.Map.Left + State.Map.Width,
                     (double)State.Map.Top - State.Map.Height, 
                     (double)State.Map.Top, 
-                    State.IterationCount != 1? "s":"", State.IterationCount,
+                    State.IterationCount != 1? "s":"", State.IterationCount, State.AutoIterations? " (auto)" : "",
                     State.ThreadCount != 1? "s":"", State.ThreadCount,
-                    GetSimdMode(State.Mode)
+                    GetModeName(State.Mode),
+                    GetRenderMethodName(State.Method),
+                    ProgressiveTxt,
+                    CacheTxt,
+                    ResolutionTxt,
+                    SupersampleTxt
                 );
 
                 RECT TopRight = {
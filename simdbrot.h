@@ -0,0 +1,122 @@
+#ifndef SIMDBROT_H
+#define SIMDBROT_H
+
+/*
+ * libsimdbrot, the render engine for programs that aren't simdbrot:
+ * a simdbrot holds what doesn't change between renders (the palette and the threads to use),
+ * every render gets its own view, pixels and options, so any number of threads can render with the same simdbrot at once.
+ * The pixels always belong to the caller, nothing is kept after a call returns.
+ * Build with build.sh, it makes bin/libsimdbrot.a and bin/libsimdbrot.so,
+ * build.bat makes bin/simdbrot.dll and the static bin/libsimdbrot.a (gcc) or bin/libsimdbrot.lib (cl),
+ * define SIMDBROT_SHARED when using the dll on windows.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32) && defined(SIMDBROT_SHARED)
+#  ifdef SIMDBROT_BUILD
+#    define SIMDBROT_API __declspec(dllexport)
+#  else
+#    define SIMDBROT_API __declspec(dllimport)
+#  endif
+#elif defined(__GNUC__)
+#  define SIMDBROT_API __attribute__((visibility("default")))
+#else
+#  define SIMDBROT_API
+#endif
+
+typedef enum simdbrot_result
+{
+    SIMDBROT_OK = 0,
+    SIMDBROT_INVALID_ARGUMENT,
+    SIMDBROT_UNSUPPORTED_MODE,  /* the cpu can't run the kernels of that mode */
+    SIMDBROT_OUT_OF_MEMORY,
+} simdbrot_result;
+
+/* the methods, the same as simdbrot's --method */
+typedef enum simdbrot_method
+{
+    SIMDBROT_METHOD_FULL = 0,
+    SIMDBROT_METHOD_SUBDIVIDE,
+    SIMDBROT_METHOD_BOUNDARY_TRACE,
+    SIMDBROT_METHOD_RESUMABLE,
+    SIMDBROT_METHOD_ANYTIME,
+} simdbrot_method;
+
+/* the mode that simdbrot_options starts with, the fastest f64 mode of the cpu */
+#define SIMDBROT_MODE_BEST -1
+
+/* what the counts have for the pixels that never escaped */
+#define SIMDBROT_COUNT_INSIDE 0xFFFFFFFFu
+
+/* threads shared by every simdbrot that's made with them */
+typedef struct simdbrot_pool simdbrot_pool;
+
+typedef struct simdbrot simdbrot;
+
+/* the part of the plane to render and where it goes, pixels are 0x00RRGGBB */
+typedef struct simdbrot_view
+{
+    double CenterX, CenterY;
+    double ViewHeight;          /* in plane units, the pixels are square */
+    int IterationCount;         /* 0 for the one in the options */
+
+    uint32_t *Pixels;
+    int Width;
+    int Height;
+    int Stride;                 /* in pixels */
+
+    /* optional, the iteration count of each pixel, laid out like the pixels,
+     * only the full method has them, the others don't take counts */
+    uint32_t *Counts;
+} simdbrot_view;
+
+typedef struct simdbrot_options
+{
+    int IterationCount;
+    int Mode;                   /* 0 to 9 like simdbrot's --mode, or SIMDBROT_MODE_BEST */
+    simdbrot_method Method;
+    int Supersample;            /* anti-alias the edges afterwards, the counts stay the way they were */
+    double MaxValue;            /* escape radius, a point has escaped once |z| gets past it */
+} simdbrot_options;
+
+/* ThreadCount threads, counting the caller's, 0 for one per processor, NULL when out of memory */
+SIMDBROT_API simdbrot_pool *SimdbrotCreatePool(int ThreadCount);
+
+/* no render can be using the pool anymore */
+SIMDBROT_API void SimdbrotDestroyPool(simdbrot_pool *Pool);
+
+/* renders on Pool, or on threads made for every render when it's NULL,
+ * Palette is 16 colors, or NULL for simdbrot's, NULL when out of memory */
+SIMDBROT_API simdbrot *SimdbrotCreate(simdbrot_pool *Pool, const uint32_t *Palette);
+SIMDBROT_API void SimdbrotDestroy(simdbrot *Simdbrot);
+
+/* 400 iterations, the best mode, the full method, not supersampled */
+SIMDBROT_API simdbrot_options SimdbrotGetDefaultOptions(void);
+
+/* renders View with Options (NULL for the default ones), safe to call from any number of threads at once */
+SIMDBROT_API simdbrot_result SimdbrotRender(const simdbrot *Simdbrot, const simdbrot_view *View, const simdbrot_options *Options);
+
+/* renders every view with the same options, the tiles of all of them are handed out to the threads together, 
+ * so hundreds of thumbnails render about as fast as one image with as many pixels, 
+ * the resumable and anytime methods render like the full one here */
+SIMDBROT_API simdbrot_result SimdbrotRenderViews(
+    const simdbrot *Simdbrot, 
+    const simdbrot_view *Views, 
+    int ViewCount, 
+    const simdbrot_options *Options
+);
+
+SIMDBROT_API int SimdbrotGetBestMode(void);
+SIMDBROT_API const char *SimdbrotGetModeName(int Mode);
+SIMDBROT_API const char *SimdbrotGetResultName(simdbrot_result Result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIMDBROT_H */
@@ -0,0 +1,635 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XShm.h>
+
+#include "Common.h"
+
+/*
+ * X11 front-end:
+ * the same explorer as the win32 window, it renders at the window's resolution
+ * straight into an XImage that lives in memory shared with the X server (MIT-SHM),
+ * so presenting a frame doesn't copy it through the socket.
+ * The image only gets recreated when the window is resized,
+ * everything else keeps rendering into the same pixels, which is what lets a pan reuse them.
+ * When the server can't share memory (remote display), it falls back to a plain XImage.
+ */
+
+#define X11_KEY_COUNT 0x100
+
+/* keys that aren't characters get a slot of their own in the key table */
+enum
+{
+    X11_KEY_UP = 0x80,
+    X11_KEY_DOWN,
+    X11_KEY_LEFT,
+    X11_KEY_RIGHT,
+    X11_KEY_ESCAPE,
+};
+
+typedef struct x11_image
+{
+    XImage *Image;
+    XShmSegmentInfo Shm;
+    Bool8 IsShared;
+    u32 *Samples; /* for the progressive passes */
+    u32 *Counts; /* the iteration counts of the pixels, so a new palette doesn't need a render */
+    int Width, Height;
+} x11_image;
+
+typedef struct x11_state
+{
+    Display *Display;
+    Window Window;
+    GC Gc;
+    XFontStruct *Font;
+    Atom DeleteWindow;
+    int ShmCompletionEvent;
+    Bool8 CanShareMemory;
+    Bool8 WaitingForPresent;
+    x11_image Image;
+
+    render_engine Engine;
+    coordmap Map;
+
+    Bool8 MouseIsDragging;
+    int MouseX, MouseY;
+
+    Bool8 Progressive;
+    int ProgressiveSpacing;
+    render_view LastView;
+    Bool8 LastViewComplete;
+
+    Bool8 CountsValid;
+    Bool8 PaletteChanged;
+    int PaletteOffset;
+    double LastRecolorTime;
+
+    Bool8 KeyIsDown[X11_KEY_COUNT];
+    Bool8 KeyWasPressed[X11_KEY_COUNT];
+    double KeyDownInit[X11_KEY_COUNT];
+} x11_state;
+
+static Bool8 X11_ShmAttachFailed;
+
+static void X11_Fatal(const char *Msg)
+{
+    fprintf(stderr, "simdbrot: %s\n", Msg);
+    exit(1);
+}
+
+static int X11_ShmErrorHandler(Display *Display, XErrorEvent *Error)
+{
+    (void)Display;
+    (void)Error;
+    X11_ShmAttachFailed = true;
+    return 0;
+}
+
+
+
+static void X11_DestroyImage(x11_state *State)
+{
+    x11_image *Image = &State->Image;
+    if (NULL == Image->Image)
+        return;
+
+    if (Image->IsShared)
+    {
+        XShmDetach(State->Display, &Image->Shm);
+        XDestroyImage(Image->Image);
+        shmdt(Image->Shm.shmaddr);
+    }
+    else
+    {
+        /* XDestroyImage frees the pixels too */
+        XDestroyImage(Image->Image);
+    }
+    free(Image->Samples);
+    free(Image->Counts);
+    memset(Image, 0, sizeof *Image);
+}
+
+static Bool8 X11_CreateSharedImage(x11_state *State, Visual *ScreenVisual, int Depth, int Width, int Height)
+{
+    x11_image *Image = &State->Image;
+    Image->Image = XShmCreateImage(State->Display, ScreenVisual, Depth, ZPixmap, NULL, &Image->Shm, Width, Height);
+    if (NULL == Image->Image)
+        return false;
+
+    Image->Shm.shmid = shmget(IPC_PRIVATE, (size_t)Image->Image->bytes_per_line * Height, IPC_CREAT | 0600);
+    if (Image->Shm.shmid < 0)
+    {
+        XDestroyImage(Image->Image);
+        return false;
+    }
+    Image->Shm.shmaddr = Image->Image->data = shmat(Image->Shm.shmid, NULL, 0);
+    Image->Shm.readOnly = False;
+
+    /* a server on another machine only finds out that it can't attach when it tries */
+    X11_ShmAttachFailed = false;
+    int (*OldHandler)(Display *, XErrorEvent *) = XSetErrorHandler(X11_ShmErrorHandler);
+    Bool8 Attached = (void *)-1 != Image->Shm.shmaddr && XShmAttach(State->Display, &Image->Shm);
+    XSync(State->Display, False);
+    XSetErrorHandler(OldHandler);
+
+    /* the segment goes away by itself once both sides detach */
+    shmctl(Image->Shm.shmid, IPC_RMID, NULL);
+    if (!Attached || X11_ShmAttachFailed)
+    {
+        if ((void *)-1 != Image->Shm.shmaddr)
+            shmdt(Image->Shm.shmaddr);
+        Image->Image->data = NULL;
+        XDestroyImage(Image->Image);
+        Image->Image = NULL;
+        return false;
+    }
+    Image->IsShared = true;
+    return true;
+}
+
+static void X11_ResizeImage(x11_state *State, int Width, int Height)
+{
+    if (State->Image.Image && State->Image.Width == Width && State->Image.Height == Height)
+        return;
+    X11_DestroyImage(State);
+
+    int Screen = DefaultScreen(State->Display);
+    Visual *ScreenVisual = DefaultVisual(State->Display, Screen);
+    int Depth = DefaultDepth(State->Display, Screen);
+
+    x11_image *Image = &State->Image;
+    if (!State->CanShareMemory || !X11_CreateSharedImage(State, ScreenVisual, Depth, Width, Height))
+    {
+        State->CanShareMemory = false;
+        char *Pixels = malloc((size_t)Width * Height * sizeof(u32));
+        if (NULL == Pixels)
+            X11_Fatal("Unable to allocate the frame.");
+        Image->Image = XCreateImage(State->Display, ScreenVisual, Depth, ZPixmap, 0, Pixels, Width, Height, 32, 0);
+        if (NULL == Image->Image)
+            X11_Fatal("Unable to create the frame.");
+    }
+    if (32 != Image->Image->bits_per_pixel)
+        X11_Fatal("Needs a 24 or 32 bit true color display.");
+
+    Image->Width = Width;
+    Image->Height = Height;
+    Image->Samples = malloc(((size_t)Width/2 + 1) * ((size_t)Height/2 + 1) * sizeof *Image->Samples);
+    Image->Counts = malloc((size_t)Image->Image->bytes_per_line * Height);
+    if (NULL == Image->Samples || NULL == Image->Counts)
+        X11_Fatal("Unable to allocate the frame.");
+
+    /* the old pixels are gone */
+    State->LastViewComplete = false;
+    State->CountsValid = false;
+}
+
+static color_buffer X11_GetColorBuffer(const x11_state *State)
+{
+    const XImage *Image = State->Image.Image;
+    color_buffer Buffer = MakeColorBuffer(
+        &State->Engine,
+        (u32 *)Image->data,
+        Image->width, Image->height,
+        Image->bytes_per_line / (int)sizeof(u32)
+    );
+
+    /* only the full method writes the count of every pixel, the others keep going without counts */
+    if (RENDER_METHOD_FULL == State->Engine.Method && !State->Progressive)
+        Buffer.Counts = State->Image.Counts;
+    return Buffer;
+}
+
+static void X11_RotatePalette(x11_state *State)
+{
+    u32 *Palette = State->Engine.Palette;
+    u32 First = Palette[0];
+    memmove(Palette, Palette + 1, 15 * sizeof *Palette);
+    Palette[15] = First;
+    State->PaletteOffset = (State->PaletteOffset + 1) % 16;
+    State->PaletteChanged = true;
+}
+
+
+
+static double X11_GetWindowDelta(const x11_state *State)
+{
+    return State->Map.Height / MAX(1, State->Image.Height);
+}
+
+static void X11_ResetMap(x11_state *State)
+{
+    State->Map = (coordmap) {
+        .Left = 2,
+        .Width = 3,
+        .Top = 1,
+        .Height = 2,
+    };
+    State->Engine.IterationCount = 400;
+}
+
+static void X11_ZoomMap(x11_state *State, int Zoom)
+{
+    double Scale = Zoom < 0
+        ? 1.1
+        : 0.9;
+
+    /* keep the point under the mouse where it is */
+    double Delta = X11_GetWindowDelta(State);
+    double MouseX = State->MouseX * Delta - State->Map.Left;
+    double MouseY = State->Map.Top - State->MouseY * Delta;
+
+    State->Map.Left = (State->Map.Left + MouseX) * Scale - MouseX;
+    State->Map.Top = (State->Map.Top - MouseY) * Scale + MouseY;
+    State->Map.Width *= Scale;
+    State->Map.Height *= Scale;
+}
+
+static int X11_GetKeyIndex(KeySym Key)
+{
+    switch (Key)
+    {
+    case XK_Up: return X11_KEY_UP;
+    case XK_Down: return X11_KEY_DOWN;
+    case XK_Left: return X11_KEY_LEFT;
+    case XK_Right: return X11_KEY_RIGHT;
+    case XK_Escape: return X11_KEY_ESCAPE;
+    }
+    if (Key >= XK_a && Key <= XK_z)
+        return (int)(Key - XK_a + 'A');
+    if (Key >= XK_A && Key <= XK_Z)
+        return (int)Key;
+    return -1;
+}
+
+static Bool8 X11_IsKeyPressed(x11_state *State, int Key)
+{
+    Bool8 WasPressed = State->KeyWasPressed[Key];
+    State->KeyWasPressed[Key] = false;
+    return WasPressed;
+}
+
+static Bool8 X11_IsKeyDown(x11_state *State, int Key, double Delay)
+{
+    double Time = GetTimeMillisec();
+    Bool8 IsDown = State->KeyIsDown[Key] && Time - State->KeyDownInit[Key] > Delay;
+    if (IsDown)
+        State->KeyDownInit[Key] = Time;
+    return IsDown;
+}
+
+/* false once the window was closed */
+static Bool8 X11_PollInputs(x11_state *State)
+{
+    while (XPending(State->Display))
+    {
+        XEvent Event;
+        XNextEvent(State->Display, &Event);
+        if (State->ShmCompletionEvent && Event.type == State->ShmCompletionEvent)
+        {
+            State->WaitingForPresent = false;
+            continue;
+        }
+
+        switch (Event.type)
+        {
+        case ClientMessage:
+        {
+            if ((Atom)Event.xclient.data.l[0] == State->DeleteWindow)
+                return false;
+        } break;
+
+        case KeyPress:
+        case KeyRelease:
+        {
+            int Key = X11_GetKeyIndex(XLookupKeysym(&Event.xkey, 0));
+            if (Key < 0)
+                break;
+
+            Bool8 IsDown = KeyPress == Event.type;
+            if (IsDown && !State->KeyIsDown[Key])
+            {
+                State->KeyWasPressed[Key] = true;
+                State->KeyDownInit[Key] = 0;
+            }
+            State->KeyIsDown[Key] = IsDown;
+        } break;
+
+        case MotionNotify:
+        {
+            int x = Event.xmotion.x;
+            int y = Event.xmotion.y;
+            if (State->MouseIsDragging)
+            {
+                double Delta = X11_GetWindowDelta(State);
+                State->Map.Left += (x - State->MouseX) * Delta;
+                State->Map.Top += (y - State->MouseY) * Delta;
+            }
+            State->MouseX = x;
+            State->MouseY = y;
+        } break;
+
+        case ButtonPress:
+        case ButtonRelease:
+        {
+            State->MouseX = Event.xbutton.x;
+            State->MouseY = Event.xbutton.y;
+            if (Button1 == Event.xbutton.button)
+                State->MouseIsDragging = ButtonPress == Event.type;
+            else if (ButtonPress == Event.type && Button4 == Event.xbutton.button)
+                X11_ZoomMap(State, 1);
+            else if (ButtonPress == Event.type && Button5 == Event.xbutton.button)
+                X11_ZoomMap(State, -1);
+        } break;
+        }
+    }
+    return true;
+}
+
+
+
+static void X11_RenderFrame(x11_state *State)
+{
+    color_buffer Buffer = X11_GetColorBuffer(State);
+    State->Map.Delta = X11_GetWindowDelta(State);
+    State->Map.Width = Buffer.Width * State->Map.Delta;
+
+    render_view View = {
+        .Map = State->Map,
+        .Width = Buffer.Width,
+        .Height = Buffer.Height,
+        .IterationCount = State->Engine.IterationCount,
+        .Mode = State->Engine.Mode,
+        .Method = State->Engine.Method,
+    };
+    if (State->PaletteChanged)
+    {
+        /* with the counts of the pixels a new palette is only a lookup, otherwise it takes a render */
+        State->PaletteChanged = false;
+        if (State->CountsValid && Buffer.Counts)
+        {
+            double StartTime = GetTimeMillisec();
+            EngineRecolor(&State->Engine, &Buffer);
+            State->LastRecolorTime = GetTimeMillisec() - StartTime;
+        }
+        else
+        {
+            State->LastViewComplete = false;
+        }
+    }
+
+    int ShiftX, ShiftY;
+    Bool8 Panned = State->LastViewComplete
+        && GetPanOffset(&State->LastView, &View, &ShiftX, &ShiftY);
+    if (Panned)
+    {
+        /* the image persists between frames, only render what got uncovered */
+        if (ShiftX || ShiftY)
+            EngineRenderPan(&State->Engine, &Buffer, &View.Map, ShiftX, ShiftY);
+        State->LastView = View;
+        State->CountsValid = State->CountsValid && Buffer.Counts;
+    }
+    else if (State->Progressive)
+    {
+        if (!RenderViewEqual(&State->LastView, &View))
+        {
+            State->ProgressiveSpacing = PROGRESSIVE_MAX_SPACING;
+            State->LastView = View;
+        }
+        if (State->ProgressiveSpacing)
+        {
+            EngineRenderProgressivePass(&State->Engine, &Buffer, &View.Map, State->ProgressiveSpacing, State->Image.Samples);
+            State->ProgressiveSpacing /= 2;
+        }
+        State->LastViewComplete = 0 == State->ProgressiveSpacing;
+        State->CountsValid = false;
+    }
+    else
+    {
+        EngineRenderBuffer(&State->Engine, &Buffer, &View.Map);
+        State->LastView = View;
+        State->LastViewComplete = true;
+        State->CountsValid = NULL != Buffer.Counts;
+    }
+    State->Map = View.Map;
+}
+
+static void X11_Present(x11_state *State, double FrameTime)
+{
+    x11_image *Image = &State->Image;
+    if (Image->IsShared)
+    {
+        /* the server reads the pixels whenever it gets to it,
+         * they can't be touched until it says it's done */
+        XShmPutImage(State->Display, State->Window, State->Gc, Image->Image, 0, 0, 0, 0, Image->Width, Image->Height, True);
+        State->WaitingForPresent = true;
+    }
+    else
+    {
+        XPutImage(State->Display, State->Window, State->Gc, Image->Image, 0, 0, 0, 0, Image->Width, Image->Height);
+    }
+
+    char Lines[9][128];
+    double Delta = X11_GetWindowDelta(State);
+    const render_engine *Engine = &State->Engine;
+    int LineCount = 0;
+    snprintf(Lines[LineCount++], sizeof Lines[0], "FPS: %3.2f", 1000.0 / MAX(FrameTime, 0.001));
+    snprintf(Lines[LineCount++], sizeof Lines[0], "x: %3.5f .. %3.5f", -State->Map.Left, -State->Map.Left + Image->Width*Delta);
+    snprintf(Lines[LineCount++], sizeof Lines[0], "y: %3.5f .. %3.5f", State->Map.Top - State->Map.Height, State->Map.Top);
+    snprintf(Lines[LineCount++], sizeof Lines[0], "iteration%s: %d", Engine->IterationCount != 1? "s":"", Engine->IterationCount);
+    snprintf(Lines[LineCount++], sizeof Lines[0], "thread%s: %d", Engine->ThreadCount != 1? "s":"", Engine->ThreadCount);
+    snprintf(Lines[LineCount++], sizeof Lines[0], "rendering: %s", GetModeName(Engine->Mode));
+    snprintf(Lines[LineCount++], sizeof Lines[0], "method: %s", GetRenderMethodName(Engine->Method));
+    snprintf(Lines[LineCount++], sizeof Lines[0], "present: %s", Image->IsShared? "shared memory" : "copy");
+    snprintf(Lines[LineCount++], sizeof Lines[0], "palette: +%d (recolor %.2f ms)", State->PaletteOffset, State->LastRecolorTime);
+
+    XSetForeground(State->Display, State->Gc, 0x0000FF00);
+    int LineHeight = State->Font->ascent + State->Font->descent;
+    for (int i = 0; i < LineCount; i++)
+    {
+        int Len = (int)strlen(Lines[i]);
+        int TextWidth = XTextWidth(State->Font, Lines[i], Len);
+        XDrawString(State->Display, State->Window, State->Gc,
+            Image->Width - TextWidth - 4, (i + 1)*LineHeight,
+            Lines[i], Len
+        );
+    }
+    XFlush(State->Display);
+}
+
+/* false when the window got closed while waiting */
+static Bool8 X11_WaitForPresent(x11_state *State)
+{
+    while (State->WaitingForPresent)
+    {
+        XEvent Event;
+        XPeekEvent(State->Display, &Event);
+        if (!X11_PollInputs(State))
+            return false;
+    }
+    return true;
+}
+
+static void X11_SleepMillisec(double Millisec)
+{
+    struct timespec Time = {
+        .tv_sec = (time_t)(Millisec / 1000),
+        .tv_nsec = (long)((Millisec - 1000.0*(time_t)(Millisec / 1000)) * 1000000),
+    };
+    nanosleep(&Time, NULL);
+}
+
+static void X11_SaveFrame(const x11_state *State, const char *Path)
+{
+    color_buffer Buffer = X11_GetColorBuffer(State);
+    FILE *File = fopen(Path, "wb");
+    if (NULL == File)
+        X11_Fatal("Unable to open the output file.");
+    Bool8 Written = WritePPMHeader(File, Buffer.Width, Buffer.Height) && WritePPMRows(File, &Buffer);
+    if (0 != fclose(File) || !Written)
+        X11_Fatal("Unable to write the output file.");
+}
+
+
+
+int main(int ArgCount, char **Args)
+{
+    /* --frames N quits after N frames, -o FILE saves the last one, that's all an automated run needs */
+    int FrameLimit = 0;
+    const char *OutputPath = NULL;
+    int Width = 960, Height = 720;
+    for (int i = 1; i < ArgCount; i++)
+    {
+        if (0 == strcmp(Args[i], "--frames") && i + 1 < ArgCount)
+            FrameLimit = atoi(Args[++i]);
+        else if (0 == strcmp(Args[i], "-o") && i + 1 < ArgCount)
+            OutputPath = Args[++i];
+        else if (0 == strcmp(Args[i], "-s") && i + 1 < ArgCount && 2 == sscanf(Args[i + 1], "%dx%d", &Width, &Height))
+            i++;
+        else
+        {
+            fprintf(stderr, "usage: simdbrot-x11 [-s WxH] [--frames N] [-o FILE.ppm]\n");
+            return 1;
+        }
+    }
+
+    x11_state State = {
+        .Engine = MakeRenderEngine(),
+    };
+    X11_ResetMap(&State);
+
+    State.Display = XOpenDisplay(NULL);
+    if (NULL == State.Display)
+        X11_Fatal("Unable to open the display, is DISPLAY set?");
+    int Screen = DefaultScreen(State.Display);
+    Visual *ScreenVisual = DefaultVisual(State.Display, Screen);
+    if (TrueColor != ScreenVisual->class
+    || 0xFF0000 != ScreenVisual->red_mask
+    || 0x00FF00 != ScreenVisual->green_mask
+    || 0x0000FF != ScreenVisual->blue_mask)
+    {
+        X11_Fatal("Needs a 24 or 32 bit true color display.");
+    }
+
+    State.Window = XCreateSimpleWindow(
+        State.Display, RootWindow(State.Display, Screen),
+        0, 0, Width, Height, 0,
+        BlackPixel(State.Display, Screen), BlackPixel(State.Display, Screen)
+    );
+    XStoreName(State.Display, State.Window, "Simdbrot");
+    XSelectInput(State.Display, State.Window,
+        ExposureMask | KeyPressMask | KeyReleaseMask
+        | ButtonPressMask | ButtonReleaseMask | PointerMotionMask
+        | StructureNotifyMask
+    );
+    State.DeleteWindow = XInternAtom(State.Display, "WM_DELETE_WINDOW", False);
+    XSetWMProtocols(State.Display, State.Window, &State.DeleteWindow, 1);
+
+    /* without this, a held key sends release/press pairs and looks like it's tapped */
+    XkbSetDetectableAutoRepeat(State.Display, True, NULL);
+
+    State.Gc = XCreateGC(State.Display, State.Window, 0, NULL);
+    State.Font = XQueryFont(State.Display, XGContextFromGC(State.Gc));
+    if (NULL == State.Font)
+        X11_Fatal("Unable to query the default font.");
+
+    State.CanShareMemory = XShmQueryExtension(State.Display);
+    if (State.CanShareMemory)
+        State.ShmCompletionEvent = XShmGetEventBase(State.Display) + ShmCompletion;
+    XMapWindow(State.Display, State.Window);
+
+    X11_ResizeImage(&State, Width, Height);
+
+    double MillisecPerFrame = 1000.0 / 60.0;
+    double KeyDelay = 50;
+    double LastTime = GetTimeMillisec();
+    int FrameCount = 0;
+    while (X11_PollInputs(&State))
+    {
+        if (X11_IsKeyPressed(&State, X11_KEY_ESCAPE))
+            break;
+        if (X11_IsKeyPressed(&State, 'C'))
+            State.Engine.Mode = (State.Engine.Mode + 1) % (MODE_MAX + 1);
+        if (X11_IsKeyPressed(&State, 'R'))
+            X11_ResetMap(&State);
+        if (X11_IsKeyPressed(&State, 'M'))
+            State.Engine.Method = (State.Engine.Method + 1) % RENDER_METHOD_COUNT;
+        if (X11_IsKeyPressed(&State, 'P'))
+            State.Progressive = !State.Progressive;
+        if (X11_IsKeyPressed(&State, 'O'))
+            X11_RotatePalette(&State);
+        if (X11_IsKeyDown(&State, 'Z', KeyDelay))
+            X11_ZoomMap(&State, 1);
+        if (X11_IsKeyDown(&State, 'X', KeyDelay))
+            X11_ZoomMap(&State, -1);
+        if (X11_IsKeyDown(&State, X11_KEY_UP, KeyDelay) && State.Engine.IterationCount <= ITERATION_COUNT_MAX)
+            State.Engine.IterationCount++;
+        if (X11_IsKeyDown(&State, X11_KEY_DOWN, KeyDelay) && State.Engine.IterationCount > 1)
+            State.Engine.IterationCount--;
+        if (X11_IsKeyPressed(&State, X11_KEY_LEFT) && State.Engine.ThreadCount > 1)
+            State.Engine.ThreadCount--;
+        if (X11_IsKeyPressed(&State, X11_KEY_RIGHT) && State.Engine.ThreadCount < ENGINE_MAX_THREAD_COUNT)
+            State.Engine.ThreadCount++;
+
+        double ElapsedTime = GetTimeMillisec() - LastTime;
+        if (ElapsedTime < MillisecPerFrame)
+        {
+            X11_SleepMillisec(1);
+            continue;
+        }
+        LastTime += ElapsedTime;
+
+        XWindowAttributes Attributes;
+        XGetWindowAttributes(State.Display, State.Window, &Attributes);
+        if (!X11_WaitForPresent(&State))
+            break;
+        X11_ResizeImage(&State, MAX(1, Attributes.width), MAX(1, Attributes.height));
+        X11_RenderFrame(&State);
+        X11_Present(&State, ElapsedTime);
+
+        FrameCount++;
+        if (FrameLimit && FrameCount >= FrameLimit)
+            break;
+    }
+
+    X11_WaitForPresent(&State);
+    if (OutputPath)
+        X11_SaveFrame(&State, OutputPath);
+
+    X11_DestroyImage(&State);
+    XFreeFontInfo(NULL, State.Font, 1);
+    XFreeGC(State.Display, State.Gc);
+    XDestroyWindow(State.Display, State.Window);
+    XCloseDisplay(State.Display);
+    return 0;
+}
+